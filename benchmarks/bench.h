@@ -0,0 +1,221 @@
+#ifndef CLOX_BENCH_H
+#define CLOX_BENCH_H
+
+/// clock_gettime() is POSIX; this header must be included first.
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * @file bench.h
+ * @brief Timing harness shared by the C microbenchmarks.
+ *
+ * Every benchmark runs BENCH_WARMUP untimed calls, then BENCH_REPEAT timed
+ * ones, and reports the median with the spread of the runs. Both counts can
+ * be overridden with the CLOX_BENCH_WARMUP and CLOX_BENCH_REPEAT environment
+ * variables.
+ *
+ * When CLOX_BENCH_JSON names a file, all results of the program are also
+ * written there as JSON at exit (`meson benchmark` sets it to
+ * `<build>/bench-<name>.json`); tools/bench_compare.py diffs two such sets.
+ */
+
+#define BENCH_WARMUP 3  ///< Untimed runs before measuring
+#define BENCH_REPEAT 15 ///< Timed runs, the median is reported
+
+typedef void (*BenchFn)(void *ctx);
+
+/// @brief Monotonic wall clock in seconds
+static inline double benchNow(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static inline int compareSeconds(const void *a, const void *b) {
+  double lhs = *(const double *)a;
+  double rhs = *(const double *)b;
+  return (lhs > rhs) - (lhs < rhs);
+}
+
+/// @brief Positive integer from the environment, or `fallback`
+static inline int benchSetting(const char *name, int fallback) {
+  const char *text = getenv(name);
+  if (text == NULL) {
+    return fallback;
+  }
+  long value = strtol(text, NULL, 10);
+  return value > 0 && value <= 100000 ? (int)value : fallback;
+}
+
+/// @brief Timing of a benchmark, in seconds per call of the function
+typedef struct BenchResult {
+  double median; ///< Median of the timed runs
+  double mean;   ///< Mean of the timed runs
+  double stddev; ///< Sample standard deviation of the timed runs
+  double best;   ///< Fastest timed run
+  double worst;  ///< Slowest timed run
+  int warmup;    ///< Untimed runs
+  int repeat;    ///< Timed runs
+} BenchResult;
+
+/// @brief Run `fn(ctx)` BENCH_WARMUP times, then time BENCH_REPEAT runs
+static inline BenchResult measureBenchmark(BenchFn fn, void *ctx) {
+  int warmup = benchSetting("CLOX_BENCH_WARMUP", BENCH_WARMUP);
+  int repeat = benchSetting("CLOX_BENCH_REPEAT", BENCH_REPEAT);
+  double *samples = malloc((size_t)repeat * sizeof(double));
+  if (samples == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  for (int i = 0; i < warmup; ++i) {
+    fn(ctx);
+  }
+  for (int i = 0; i < repeat; ++i) {
+    double start = benchNow();
+    fn(ctx);
+    samples[i] = benchNow() - start;
+  }
+  qsort(samples, (size_t)repeat, sizeof(double), compareSeconds);
+
+  double sum = 0.0;
+  for (int i = 0; i < repeat; ++i) {
+    sum += samples[i];
+  }
+  double mean = sum / repeat;
+  double squares = 0.0;
+  for (int i = 0; i < repeat; ++i) {
+    squares += (samples[i] - mean) * (samples[i] - mean);
+  }
+
+  BenchResult result = {
+      .median = samples[repeat / 2],
+      .mean = mean,
+      .stddev = repeat > 1 ? sqrt(squares / (repeat - 1)) : 0.0,
+      .best = samples[0],
+      .worst = samples[repeat - 1],
+      .warmup = warmup,
+      .repeat = repeat,
+  };
+  free(samples);
+  return result;
+}
+
+/// @brief One reported benchmark, kept for the JSON output
+typedef struct BenchRecord {
+  char name[64];
+  const char *unit; ///< "op" or "byte"
+  size_t amount;    ///< Operations or bytes per call
+  BenchResult result;
+} BenchRecord;
+
+static BenchRecord *benchRecords = NULL;
+static size_t benchRecordCount = 0;
+
+/// @brief Print `text` as a JSON string, without its leading indentation
+static inline void writeJsonString(FILE *out, const char *text) {
+  while (*text == ' ') {
+    text++;
+  }
+  fputc('"', out);
+  for (; *text != '\0'; ++text) {
+    if (*text == '"' || *text == '\\') {
+      fputc('\\', out);
+    }
+    fputc((unsigned char)*text < ' ' ? ' ' : *text, out);
+  }
+  fputc('"', out);
+}
+
+/// @brief atexit() handler writing every record to $CLOX_BENCH_JSON
+static inline void writeBenchJson(void) {
+  const char *path = getenv("CLOX_BENCH_JSON");
+  FILE *out = fopen(path, "w");
+  if (out == NULL) {
+    fprintf(stderr, "Could not write \"%s\".\n", path);
+    return;
+  }
+
+  fprintf(out, "{\n  \"benchmarks\": [\n");
+  for (size_t i = 0; i < benchRecordCount; ++i) {
+    const BenchRecord *record = &benchRecords[i];
+    const BenchResult *result = &record->result;
+    fprintf(out, "    {\"name\": ");
+    writeJsonString(out, record->name);
+    fprintf(out,
+            ", \"unit\": \"%s\", \"per_call\": %zu, \"warmup\": %d, "
+            "\"repeat\": %d, \"median_s\": %.9g, \"mean_s\": %.9g, "
+            "\"stddev_s\": %.9g, \"min_s\": %.9g, \"max_s\": %.9g}%s\n",
+            record->unit, record->amount, result->warmup, result->repeat,
+            result->median, result->mean, result->stddev, result->best,
+            result->worst, i + 1 < benchRecordCount ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+  fclose(out);
+  free(benchRecords);
+}
+
+static inline void recordBenchmark(const char *name, const char *unit,
+                                   size_t amount, BenchResult result) {
+  if (getenv("CLOX_BENCH_JSON") == NULL) {
+    return;
+  }
+  if (benchRecordCount == 0) {
+    atexit(writeBenchJson);
+  }
+  BenchRecord *records = realloc(benchRecords, (benchRecordCount + 1) *
+                                                   sizeof(BenchRecord));
+  if (records == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    exit(EXIT_FAILURE);
+  }
+  benchRecords = records;
+
+  BenchRecord *record = &benchRecords[benchRecordCount++];
+  snprintf(record->name, sizeof(record->name), "%s", name);
+  record->unit = unit;
+  record->amount = amount;
+  record->result = result;
+}
+
+/// @brief Relative standard deviation, in percent of the mean
+static inline double benchSpread(const BenchResult *result) {
+  return result->mean > 0.0 ? 100.0 * result->stddev / result->mean : 0.0;
+}
+
+/**
+ * @brief Time `fn(ctx)` and print the median, best run and spread.
+ *
+ * @param name Benchmark name printed in the report.
+ * @param ops Number of operations done by one call of `fn`, used to report
+ *            ns/op and Mops/s.
+ */
+static inline void runBenchmark(const char *name, BenchFn fn, void *ctx,
+                                size_t ops) {
+  BenchResult result = measureBenchmark(fn, ctx);
+  printf("%-32s median %9.3f ms  best %9.3f ms  +-%4.1f%%  %7.3f ns/op  "
+         "%8.2f Mops/s\n",
+         name, result.median * 1e3, result.best * 1e3, benchSpread(&result),
+         result.median * 1e9 / (double)ops,
+         (double)ops / result.median * 1e-6);
+  recordBenchmark(name, "op", ops, result);
+}
+
+/**
+ * @brief Like runBenchmark(), but report throughput over `bytes` of input.
+ */
+static inline void runThroughputBenchmark(const char *name, BenchFn fn,
+                                          void *ctx, size_t bytes) {
+  BenchResult result = measureBenchmark(fn, ctx);
+  printf("%-32s median %9.3f ms  best %9.3f ms  +-%4.1f%%  %8.1f MB/s\n",
+         name, result.median * 1e3, result.best * 1e3, benchSpread(&result),
+         (double)bytes / result.median * 1e-6);
+  recordBenchmark(name, "byte", bytes, result);
+}
+
+#endif
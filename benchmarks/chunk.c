@@ -0,0 +1,101 @@
+#include "bench.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "clox/core/chunk.h"
+
+#define CHUNK_BYTES 4000000 ///< Bytes of code per emitted chunk
+#define BYTES_PER_LINE 7    ///< Roughly one short statement per line
+#define LOOKUPS 1000000
+
+/**
+ * @file chunk.c
+ * @brief Bytecode emission and line lookup.
+ *
+ * writeChunk() is measured the way the compiler calls it, a few bytes per
+ * source line. Line lookups go through getLine() in order and at random
+ * offsets (runtime errors) and through a LineIterator in order (the
+ * disassembler, the profiler and the execution trace).
+ */
+
+typedef struct ChunkBench {
+  Chunk chunk;
+  size_t *offsets; ///< Random offsets for the lookups
+  size_t checksum; ///< Sum of the lines found, so lookups are not dropped
+} ChunkBench;
+
+static void emitChunk(Chunk *chunk) {
+  initChunk(chunk);
+  for (size_t i = 0; i < CHUNK_BYTES; ++i) {
+    writeChunk(chunk, (uint8_t)i, i / BYTES_PER_LINE + 1);
+  }
+}
+
+static void emit(void *ctx) {
+  (void)ctx;
+  Chunk chunk;
+  emitChunk(&chunk);
+  freeChunk(&chunk);
+}
+
+static void getLineSequential(void *ctx) {
+  ChunkBench *bench = ctx;
+  size_t checksum = 0;
+  size_t step = CHUNK_BYTES / LOOKUPS;
+  for (size_t offset = 0; offset < CHUNK_BYTES; offset += step) {
+    checksum += getLine(&bench->chunk, offset);
+  }
+  bench->checksum = checksum;
+}
+
+static void getLineRandom(void *ctx) {
+  ChunkBench *bench = ctx;
+  size_t checksum = 0;
+  for (size_t i = 0; i < LOOKUPS; ++i) {
+    checksum += getLine(&bench->chunk, bench->offsets[i]);
+  }
+  bench->checksum = checksum;
+}
+
+static void iterateLines(void *ctx) {
+  ChunkBench *bench = ctx;
+  LineIterator lines;
+  initLineIterator(&lines, &bench->chunk);
+  size_t checksum = 0;
+  for (size_t offset = 0; offset < CHUNK_BYTES; ++offset) {
+    checksum += lineIteratorSeek(&lines, offset);
+  }
+  bench->checksum = checksum;
+}
+
+int main(void) {
+  ChunkBench bench;
+  emitChunk(&bench.chunk);
+  printf("chunk: %d bytes, %zu line records\n", CHUNK_BYTES,
+         bench.chunk.lines.count);
+
+  bench.offsets = malloc(LOOKUPS * sizeof(size_t));
+  if (bench.offsets == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    return EXIT_FAILURE;
+  }
+  uint32_t seed = 0x6d2b79f5;
+  for (size_t i = 0; i < LOOKUPS; ++i) {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    bench.offsets[i] = seed % CHUNK_BYTES;
+  }
+
+  runBenchmark("writeChunk", emit, NULL, CHUNK_BYTES);
+  runBenchmark("getLine (sequential)", getLineSequential, &bench, LOOKUPS);
+  runBenchmark("getLine (random)", getLineRandom, &bench, LOOKUPS);
+  runBenchmark("LineIterator (every byte)", iterateLines, &bench,
+               CHUNK_BYTES);
+
+  free(bench.offsets);
+  freeChunk(&bench.chunk);
+  return EXIT_SUCCESS;
+}
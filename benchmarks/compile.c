@@ -0,0 +1,113 @@
+#include "bench.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "clox/compiler/compiler.h"
+#include "clox/compiler/token_buffer.h"
+#include "clox/core/chunk.h"
+#include "clox/core/globals.h"
+#include "clox/core/memory.h"
+#include "clox/core/object.h"
+
+#define COMPILES 20000 ///< Compilations per timed run
+
+/**
+ * @file compile.c
+ * @brief Compilation of a short script, the startup cost of most runs.
+ *
+ * Compares tokenizing into heap arrays against an arena, and compile() with
+ * a fresh arena per call against one arena reset between calls.
+ */
+
+static const char script[] =
+    "// Configuration checks run at startup\n"
+    "print 1 + 2 * 3;\n"
+    "print (10 - 4) / 2 >= 3 == true;\n"
+    "print !nil == !false;\n"
+    "print nil == false;\n"
+    "print 0.5 * 0.25 + 1.75 - 2 / 8;\n"
+    "print 42 > 7 == 7 > 1;\n"
+    "print -(3.5 + 1) * -(2 - 0.5);\n"
+    "print 100 / 3 < 34;\n"
+    "print 1 + 1 + 1 + 1 + 1 + 1 + 1 + 1;\n"
+    "print 2 * 2 * 2 * 2 * 2 * 2 * 2 * 2;\n";
+
+typedef struct CompileBench {
+  Arena arena;
+  Heap heap;       ///< Strings interned by the compiler
+  Globals globals; ///< Slots of the script's globals
+} CompileBench;
+
+static void scanHeap(void *ctx) {
+  (void)ctx;
+  for (int i = 0; i < COMPILES; ++i) {
+    TokenBuffer tokens;
+    initTokenBuffer(&tokens, NULL);
+    scanAll(script, &tokens);
+    freeTokenBuffer(&tokens);
+  }
+}
+
+static void scanArena(void *ctx) {
+  CompileBench *bench = ctx;
+  for (int i = 0; i < COMPILES; ++i) {
+    TokenBuffer tokens;
+    initTokenBuffer(&tokens, &bench->arena);
+    scanAll(script, &tokens);
+    resetArena(&bench->arena);
+  }
+}
+
+static void compileFresh(void *ctx) {
+  CompileBench *bench = ctx;
+  for (int i = 0; i < COMPILES; ++i) {
+    Chunk chunk;
+    initChunk(&chunk);
+    compile(script, &chunk, &bench->heap, &bench->globals);
+    freeChunk(&chunk);
+  }
+}
+
+static void compileReused(void *ctx) {
+  CompileBench *bench = ctx;
+  for (int i = 0; i < COMPILES; ++i) {
+    Chunk chunk;
+    initChunk(&chunk);
+    compileInArena(script, &chunk, &bench->heap, &bench->globals,
+                   &bench->arena);
+    resetArena(&bench->arena);
+    freeChunk(&chunk);
+  }
+}
+
+int main(void) {
+  CompileBench bench;
+  initArena(&bench.arena, 0, MEM_COMPILER);
+  initHeap(&bench.heap);
+  initGlobals(&bench.globals);
+
+  Chunk chunk;
+  initChunk(&chunk);
+  if (!compileInArena(script, &chunk, &bench.heap, &bench.globals,
+                      &bench.arena)) {
+    fprintf(stderr, "Benchmark script failed to compile.\n");
+    return EXIT_FAILURE;
+  }
+  printf("script: %zu bytes, %zu bytes of bytecode\n", sizeof(script) - 1,
+         chunk.code.count);
+  printArenaStats(stdout, "compiler arena", &bench.arena);
+  freeChunk(&chunk);
+  resetArena(&bench.arena);
+
+  runBenchmark("scanAll, heap arrays", scanHeap, &bench, COMPILES);
+  runBenchmark("scanAll, reset arena", scanArena, &bench, COMPILES);
+  runBenchmark("compile, fresh arena", compileFresh, &bench, COMPILES);
+  runBenchmark("compile, reset arena", compileReused, &bench, COMPILES);
+
+  freeGlobals(&bench.globals);
+  freeHeap(&bench.heap);
+  freeArena(&bench.arena);
+  return EXIT_SUCCESS;
+}
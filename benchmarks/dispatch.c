@@ -0,0 +1,108 @@
+#include "bench.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "clox/compiler/peephole.h"
+#include "clox/core/chunk.h"
+#include "clox/vm/dispatch.h"
+#include "clox/vm/profiler.h"
+#include "clox/vm/vm.h"
+
+#define ARITH_STEPS 1000000
+
+typedef struct DispatchBench {
+  VM vm;
+  Chunk chunk;
+} DispatchBench;
+
+static void emitConstant(Chunk *chunk, uint8_t index) {
+  writeChunk(chunk, OP_CONSTANT, 1);
+  writeChunk(chunk, index, 1);
+}
+
+/// @brief `1 + 1 + 1 + ...`: one OP_CONSTANT and one OP_ADD per step
+static void buildAddChunk(Chunk *chunk) {
+  initChunk(chunk);
+  uint8_t one = (uint8_t)addConstant(chunk, NUMBER_VAL(1.0));
+  emitConstant(chunk, one);
+  for (size_t i = 0; i < ARITH_STEPS; ++i) {
+    emitConstant(chunk, one);
+    writeChunk(chunk, OP_ADD, 1);
+  }
+  writeChunk(chunk, OP_POP, 1);
+  writeChunk(chunk, OP_RETURN, 1);
+}
+
+/// @brief Cycle through all four arithmetic opcodes and OP_NEGATE
+static void buildMixedChunk(Chunk *chunk) {
+  static const uint8_t ops[] = {OP_ADD, OP_MULTIPLY, OP_SUBTRACT, OP_DIVIDE};
+
+  initChunk(chunk);
+  uint8_t one = (uint8_t)addConstant(chunk, NUMBER_VAL(1.0));
+  uint8_t step = (uint8_t)addConstant(chunk, NUMBER_VAL(1.5));
+  emitConstant(chunk, one);
+  for (size_t i = 0; i < ARITH_STEPS; ++i) {
+    emitConstant(chunk, step);
+    writeChunk(chunk, ops[i % 4], 1);
+    if (i % 8 == 0) {
+      writeChunk(chunk, OP_NEGATE, 1);
+    }
+  }
+  writeChunk(chunk, OP_POP, 1);
+  writeChunk(chunk, OP_RETURN, 1);
+}
+
+static void runChunk(void *ctx) {
+  DispatchBench *bench = ctx;
+  if (interpretChunk(&bench->vm, &bench->chunk) != INTERPRET_OK) {
+    fprintf(stderr, "benchmark chunk failed\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/// @brief The loaded chunk again with a profiler attached
+static void benchProfiled(DispatchBench *bench, unsigned mode,
+                          const char *name) {
+  Profiler profiler;
+  initProfiler(&profiler, mode, PROFILE_DEFAULT_INTERVAL);
+  bench->vm.profiler = &profiler;
+  startProfiler(&profiler);
+  runBenchmark(name, runChunk, bench, 2 * ARITH_STEPS + 3);
+  stopProfiler(&profiler);
+  bench->vm.profiler = NULL;
+  freeProfiler(&profiler);
+}
+
+int main(void) {
+#ifdef CLOX_THREADED_DISPATCH
+  printf("dispatch: threaded (computed goto)\n");
+#else
+  printf("dispatch: switch\n");
+#endif
+
+  DispatchBench bench;
+  initVM(&bench.vm);
+
+  /// ns/op counts the unfused instructions, so both variants compare
+  buildAddChunk(&bench.chunk);
+  runBenchmark("OP_CONSTANT/OP_ADD", runChunk, &bench, 2 * ARITH_STEPS + 3);
+  fuseInstructions(&bench.chunk);
+  runBenchmark("OP_ADD_CONSTANT (fused)", runChunk, &bench,
+               2 * ARITH_STEPS + 3);
+  benchProfiled(&bench, PROFILE_SAMPLE, "fused, --profile-sample");
+  benchProfiled(&bench, PROFILE_COUNT, "fused, --profile");
+  freeChunk(&bench.chunk);
+
+  buildMixedChunk(&bench.chunk);
+  runBenchmark("OP_CONSTANT/mixed arithmetic", runChunk, &bench,
+               2 * ARITH_STEPS + ARITH_STEPS / 8 + 3);
+  fuseInstructions(&bench.chunk);
+  runBenchmark("mixed arithmetic (fused)", runChunk, &bench,
+               2 * ARITH_STEPS + ARITH_STEPS / 8 + 3);
+  freeChunk(&bench.chunk);
+
+  freeVM(&bench.vm);
+  return EXIT_SUCCESS;
+}
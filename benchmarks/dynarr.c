@@ -0,0 +1,101 @@
+#include "bench.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "clox/core/chunk.h"
+#include "clox/core/memory.h"
+#include "clox/core/value.h"
+#include "clox/utils/dynarr.h"
+
+#define PUSHES (4u * 1024u * 1024u) ///< Elements appended per timed run
+
+/**
+ * @file dynarr.c
+ * @brief DynArray appends: generic memcpy() push, typed inline push and
+ * bulk append, for bytecode bytes and constant Values.
+ */
+
+typedef struct DynArrayBench {
+  size_t checksum; ///< Keeps the appended data observable
+} DynArrayBench;
+
+static void finish(DynArrayBench *bench, DynArray *array) {
+  bench->checksum += array->count;
+  freeDynArray(array);
+}
+
+static void pushBytesGeneric(void *ctx) {
+  DynArray array;
+  initDynArray(&array, sizeof(uint8_t), MEM_CHUNK_CODE);
+  for (size_t i = 0; i < PUSHES; ++i) {
+    uint8_t byte = (uint8_t)i;
+    pushDynArray(&array, &byte);
+  }
+  finish(ctx, &array);
+}
+
+static void pushBytesTyped(void *ctx) {
+  DynArray array;
+  initDynArray(&array, sizeof(uint8_t), MEM_CHUNK_CODE);
+  for (size_t i = 0; i < PUSHES; ++i) {
+    pushByteDynArray(&array, (uint8_t)i);
+  }
+  finish(ctx, &array);
+}
+
+static void pushBytesBulk(void *ctx) {
+  DynArray array;
+  initDynArray(&array, sizeof(uint8_t), MEM_CHUNK_CODE);
+  uint8_t instruction[4] = {OP_CONSTANT_LONG, 1, 2, 3};
+  for (size_t i = 0; i < PUSHES; i += 4) {
+    pushManyDynArray(&array, instruction, 4);
+  }
+  finish(ctx, &array);
+}
+
+static void pushValuesGeneric(void *ctx) {
+  DynArray array;
+  initDynArray(&array, sizeof(Value), MEM_CHUNK_CONSTANTS);
+  for (size_t i = 0; i < PUSHES; ++i) {
+    Value value = NUMBER_VAL((double)i);
+    pushDynArray(&array, &value);
+  }
+  finish(ctx, &array);
+}
+
+static void pushValuesTyped(void *ctx) {
+  DynArray array;
+  initDynArray(&array, sizeof(Value), MEM_CHUNK_CONSTANTS);
+  for (size_t i = 0; i < PUSHES; ++i) {
+    pushValueDynArray(&array, NUMBER_VAL((double)i));
+  }
+  finish(ctx, &array);
+}
+
+static void pushValuesReserved(void *ctx) {
+  DynArray array;
+  initDynArray(&array, sizeof(Value), MEM_CHUNK_CONSTANTS);
+  reserveDynArray(&array, PUSHES);
+  for (size_t i = 0; i < PUSHES; ++i) {
+    pushValueDynArray(&array, NUMBER_VAL((double)i));
+  }
+  finish(ctx, &array);
+}
+
+int main(void) {
+  DynArrayBench bench = {0};
+
+  runBenchmark("bytes, pushDynArray", pushBytesGeneric, &bench, PUSHES);
+  runBenchmark("bytes, pushByteDynArray", pushBytesTyped, &bench, PUSHES);
+  runBenchmark("bytes, pushManyDynArray (x4)", pushBytesBulk, &bench,
+               PUSHES);
+  runBenchmark("values, pushDynArray", pushValuesGeneric, &bench, PUSHES);
+  runBenchmark("values, pushValueDynArray", pushValuesTyped, &bench, PUSHES);
+  runBenchmark("values, reserved + typed", pushValuesReserved, &bench,
+               PUSHES);
+
+  printf("checksum: %zu\n", bench.checksum);
+  return EXIT_SUCCESS;
+}
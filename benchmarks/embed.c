@@ -0,0 +1,142 @@
+#include "bench.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "clox/clox.h"
+
+#define SCRIPTS 20000 ///< Scripts run per timed run
+#define CALLS 100000  ///< Statements of the native call benchmark
+#define CALL_STATEMENT "sum(1, 2) * 3 < limit();\n"
+
+/**
+ * @file embed.c
+ * @brief Running many short scripts through the public API (libclox).
+ *
+ * Compares what a host pays per script: a new VM each time, a warm VM that
+ * compiles every script, and a warm VM running a precompiled program. The
+ * last line is the cost of one host function call from Lox, followed by the
+ * peak memory use. Only clox.h is used, against the shared library.
+ */
+
+static const char script[] = "sum(1, 2) * 3 < limit() == !nil;\n"
+                             "sum(0.5, 0.25) + 1.75 - limit() / 8;\n"
+                             "-(sum(3.5, 1)) * -(2 - 0.5) > 0;\n";
+
+typedef struct EmbedBench {
+  CloxVM *vm;
+  CloxProgram *program;
+  CloxProgram *calls;
+} EmbedBench;
+
+static bool sumNative(CloxVM *vm, int argCount, const CloxValue *args,
+                      CloxValue *result) {
+  (void)argCount;
+  if (args[0].type != CLOX_NUMBER || args[1].type != CLOX_NUMBER) {
+    cloxNativeError(vm, "Operands must be numbers.");
+    return false;
+  }
+  *result = cloxNumber(args[0].as.number + args[1].as.number);
+  return true;
+}
+
+static bool limitNative(CloxVM *vm, int argCount, const CloxValue *args,
+                        CloxValue *result) {
+  (void)vm;
+  (void)argCount;
+  (void)args;
+  *result = cloxNumber(100.0);
+  return true;
+}
+
+static void defineNatives(CloxVM *vm) {
+  cloxDefineNative(vm, "sum", 2, sumNative);
+  cloxDefineNative(vm, "limit", 0, limitNative);
+}
+
+static void check(CloxResult result) {
+  if (result != CLOX_OK) {
+    fprintf(stderr, "benchmark script failed\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+static void runFreshVM(void *ctx) {
+  (void)ctx;
+  for (int i = 0; i < SCRIPTS; ++i) {
+    CloxVM *vm = cloxNewVM();
+    defineNatives(vm);
+    check(cloxInterpret(vm, script));
+    cloxFreeVM(vm);
+  }
+}
+
+static void runWarmVM(void *ctx) {
+  EmbedBench *bench = ctx;
+  for (int i = 0; i < SCRIPTS; ++i) {
+    check(cloxInterpret(bench->vm, script));
+  }
+}
+
+static void runProgram(void *ctx) {
+  EmbedBench *bench = ctx;
+  for (int i = 0; i < SCRIPTS; ++i) {
+    check(cloxRunProgram(bench->vm, bench->program));
+  }
+}
+
+static void runCalls(void *ctx) {
+  EmbedBench *bench = ctx;
+  check(cloxRunProgram(bench->vm, bench->calls));
+}
+
+/// @brief CALLS statements, each calling both natives once
+static char *buildCallScript(void) {
+  size_t length = strlen(CALL_STATEMENT);
+  char *source = malloc(length * CALLS + 1);
+  if (source == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    exit(EXIT_FAILURE);
+  }
+  for (size_t i = 0; i < CALLS; ++i) {
+    memcpy(source + i * length, CALL_STATEMENT, length);
+  }
+  source[length * CALLS] = '\0';
+  return source;
+}
+
+int main(void) {
+  printf("libclox %s\n", cloxVersion());
+
+  EmbedBench bench;
+  bench.vm = cloxNewVM();
+  if (bench.vm == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    return EXIT_FAILURE;
+  }
+  defineNatives(bench.vm);
+  char *callSource = buildCallScript();
+  bench.program = cloxCompile(bench.vm, script);
+  bench.calls = cloxCompile(bench.vm, callSource);
+  free(callSource);
+  if (bench.program == NULL || bench.calls == NULL) {
+    return EXIT_FAILURE;
+  }
+
+  runBenchmark("new vm per script", runFreshVM, NULL, SCRIPTS);
+  runBenchmark("warm vm, compile each script", runWarmVM, &bench, SCRIPTS);
+  runBenchmark("warm vm, precompiled program", runProgram, &bench, SCRIPTS);
+  runBenchmark("native calls", runCalls, &bench, 2 * CALLS);
+
+  CloxMemoryStats memory;
+  if (cloxGetMemoryStats(bench.vm, 0, &memory)) {
+    printf("  peak memory of the warm vm: %zu bytes\n", memory.peakBytes);
+  }
+
+  cloxFreeProgram(bench.calls);
+  cloxFreeProgram(bench.program);
+  cloxFreeVM(bench.vm);
+  return EXIT_SUCCESS;
+}
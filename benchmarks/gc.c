@@ -0,0 +1,127 @@
+#include "bench.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "clox/compiler/compiler.h"
+#include "clox/core/chunk.h"
+#include "clox/core/memory.h"
+#include "clox/core/object.h"
+#include "clox/vm/vm.h"
+
+#define LIVE_NODES 20000 ///< Instances kept alive in a linked list
+#define ALLOCATIONS 5000 ///< Instances made per run of the churn chunk
+#define RUNS 20          ///< Runs of the churn chunk per timed call
+#define LIVE_STATEMENT "n = Node(); n.next = head; head = n;\n"
+#define CHURN_STATEMENT "t = Node(); t.x = 1; keep.last = t;\n"
+
+/**
+ * @file gc.c
+ * @brief Allocation throughput with the generational collector against a
+ * plain mark-sweep of the same heap.
+ *
+ * Each VM first builds a list of LIVE_NODES instances, which stays alive,
+ * then repeatedly runs a chunk that makes ALLOCATIONS short-lived
+ * instances, storing each into an old instance (so the write barrier is
+ * taken). With the nursery, the garbage dies young and a minor collection
+ * only copies the few survivors; with `nurserySize` 0 every instance is
+ * allocated and freed on its own and every collection marks the whole list.
+ * The collection counts and pauses of each mode are printed after it.
+ */
+
+static const char setup[] = "class Node {}\n"
+                            "var head = nil;\n"
+                            "var n = nil;\n"
+                            "var t = nil;\n"
+                            "var keep = Node();\n";
+
+typedef struct GcBench {
+  VM vm;
+  Chunk churn; ///< ALLOCATIONS copies of CHURN_STATEMENT
+} GcBench;
+
+static void check(InterpretResult result) {
+  if (result != INTERPRET_OK) {
+    fprintf(stderr, "benchmark script failed\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/// @brief `count` copies of `statement`
+static char *repeatStatement(const char *statement, size_t count) {
+  size_t length = strlen(statement);
+  char *source = malloc(length * count + 1);
+  if (source == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    exit(EXIT_FAILURE);
+  }
+  for (size_t i = 0; i < count; ++i) {
+    memcpy(source + i * length, statement, length);
+  }
+  source[length * count] = '\0';
+  return source;
+}
+
+static void runChurn(void *ctx) {
+  GcBench *bench = ctx;
+  for (size_t run = 0; run < RUNS; ++run) {
+    check(interpretChunk(&bench->vm, &bench->churn));
+  }
+}
+
+static void printCollections(const VM *vm) {
+  const MemoryStats *stats = &vm->heap.stats;
+  for (int kind = 0; kind < GC_KIND_COUNT; ++kind) {
+    const GcKindStats *gc = &stats->gc[kind];
+    if (gc->pauses == 0) {
+      continue;
+    }
+    printf("  %s: %zu collections, %zu pauses, %.1f us mean, %.1f us max\n",
+           kind == GC_MINOR ? "minor" : "major", gc->collections, gc->pauses,
+           (double)gc->pauseNs / 1e3 / (double)gc->pauses,
+           (double)gc->maxPauseNs / 1e3);
+  }
+}
+
+/// @brief Benchmark one VM whose heap uses nursery blocks of `nurserySize`
+static void runMode(const char *name, size_t nurserySize) {
+  GcBench *bench = malloc(sizeof(GcBench));
+  if (bench == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    exit(EXIT_FAILURE);
+  }
+  initVM(&bench->vm);
+  bench->vm.heap.nurserySize = nurserySize;
+  check(interpret(&bench->vm, setup));
+  char *source = repeatStatement(LIVE_STATEMENT, LIVE_NODES);
+  check(interpret(&bench->vm, source));
+  free(source);
+
+  source = repeatStatement(CHURN_STATEMENT, ALLOCATIONS);
+  initChunk(&bench->churn);
+  bool compiled =
+      compile(source, &bench->churn, &bench->vm.heap, &bench->vm.globals);
+  free(source);
+  if (!compiled) {
+    exit(EXIT_FAILURE);
+  }
+
+  resetMemoryStats(&bench->vm.heap.stats);
+  runBenchmark(name, runChurn, bench, (size_t)RUNS * ALLOCATIONS);
+  printCollections(&bench->vm);
+
+  freeChunk(&bench->churn);
+  freeVM(&bench->vm);
+  free(bench);
+}
+
+int main(void) {
+  printf("gc: %d live instances, %d short-lived per run\n", LIVE_NODES,
+         ALLOCATIONS);
+  runMode("generational allocation", NURSERY_SIZE);
+  runMode("mark-sweep allocation", 0);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,145 @@
+#include "bench.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "clox/compiler/compiler.h"
+#include "clox/core/chunk.h"
+#include "clox/core/memory.h"
+#include "clox/core/object.h"
+#include "clox/vm/vm.h"
+
+#define LIVE_NODES 100000 ///< Instances kept alive in a linked list
+#define LIVE_STATEMENTS 1000 ///< Statements of the chunk building the list
+#define CHAIN_NODES 5000     ///< Instances chained by one run of the churn
+#define RUNS 20              ///< Runs of the churn chunk per timed call
+#define LIVE_STATEMENT "n = Node(); n.next = head; head = n;\n"
+#define CHURN_START "keep.chain = nil;\n"
+#define CHURN_STATEMENT "t = Node(); t.next = keep.chain; keep.chain = t;\n"
+
+/**
+ * @file gc_pauses.c
+ * @brief Garbage collection pauses with a large live heap, with incremental
+ * major collections and with stop-the-world ones.
+ *
+ * Each VM first builds a list of LIVE_NODES instances, which stays alive,
+ * then repeatedly runs a chunk that drops the chain of the previous run and
+ * builds a new one of CHAIN_NODES instances. The chains live long enough to
+ * be promoted, so the old generation keeps filling with garbage and major
+ * collections keep running, each marking the whole list. With the default
+ * Heap.sliceBudget the marking and the sweep are cut into slices; with an
+ * unlimited budget each major collection is one pause. The pause
+ * percentiles of both kinds are printed after each mode.
+ */
+
+static const char setup[] = "class Node {}\n"
+                            "var head = nil;\n"
+                            "var n = nil;\n"
+                            "var t = nil;\n"
+                            "var keep = Node();\n";
+
+typedef struct PausesBench {
+  VM vm;
+  Chunk churn; ///< CHURN_START, then CHAIN_NODES copies of CHURN_STATEMENT
+} PausesBench;
+
+static void check(InterpretResult result) {
+  if (result != INTERPRET_OK) {
+    fprintf(stderr, "benchmark script failed\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/// @brief `prefix` followed by `count` copies of `statement`
+static char *repeatStatement(const char *prefix, const char *statement,
+                             size_t count) {
+  size_t prefixLength = strlen(prefix);
+  size_t length = strlen(statement);
+  char *source = malloc(prefixLength + length * count + 1);
+  if (source == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    exit(EXIT_FAILURE);
+  }
+  memcpy(source, prefix, prefixLength);
+  for (size_t i = 0; i < count; ++i) {
+    memcpy(source + prefixLength + i * length, statement, length);
+  }
+  source[prefixLength + length * count] = '\0';
+  return source;
+}
+
+static void runChurn(void *ctx) {
+  PausesBench *bench = ctx;
+  for (size_t run = 0; run < RUNS; ++run) {
+    check(interpretChunk(&bench->vm, &bench->churn));
+  }
+}
+
+static void printPauses(const VM *vm) {
+  const MemoryStats *stats = &vm->heap.stats;
+  for (int kind = 0; kind < GC_KIND_COUNT; ++kind) {
+    const GcKindStats *gc = &stats->gc[kind];
+    if (gc->pauses == 0) {
+      continue;
+    }
+    printf("  %s: %zu collections, %zu pauses, p50 %.1f us, p99 %.1f us, "
+           "max %.1f us\n",
+           kind == GC_MINOR ? "minor" : "major", gc->collections, gc->pauses,
+           (double)gcPausePercentile(gc, 50.0) / 1e3,
+           (double)gcPausePercentile(gc, 99.0) / 1e3,
+           (double)gc->maxPauseNs / 1e3);
+  }
+}
+
+/// @brief Benchmark one VM doing `sliceBudget` work per collection slice
+static void runMode(const char *name, size_t sliceBudget) {
+  PausesBench *bench = malloc(sizeof(PausesBench));
+  if (bench == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    exit(EXIT_FAILURE);
+  }
+  initVM(&bench->vm);
+  bench->vm.heap.sliceBudget = sliceBudget;
+  check(interpret(&bench->vm, setup));
+
+  /// One chunk run many times, rather than one huge chunk
+  char *source = repeatStatement("", LIVE_STATEMENT, LIVE_STATEMENTS);
+  Chunk live;
+  initChunk(&live);
+  if (!compile(source, &live, &bench->vm.heap, &bench->vm.globals)) {
+    exit(EXIT_FAILURE);
+  }
+  free(source);
+  for (size_t i = 0; i < LIVE_NODES / LIVE_STATEMENTS; ++i) {
+    check(interpretChunk(&bench->vm, &live));
+  }
+  freeChunk(&live);
+
+  source = repeatStatement(CHURN_START, CHURN_STATEMENT, CHAIN_NODES);
+  initChunk(&bench->churn);
+  bool compiled =
+      compile(source, &bench->churn, &bench->vm.heap, &bench->vm.globals);
+  free(source);
+  if (!compiled) {
+    exit(EXIT_FAILURE);
+  }
+
+  resetMemoryStats(&bench->vm.heap.stats);
+  runBenchmark(name, runChurn, bench, (size_t)RUNS * CHAIN_NODES);
+  printPauses(&bench->vm);
+
+  freeChunk(&bench->churn);
+  freeVM(&bench->vm);
+  free(bench);
+}
+
+int main(void) {
+  printf("gc pauses: %d live instances, chains of %d\n", LIVE_NODES,
+         CHAIN_NODES);
+  runMode("incremental major collections", GC_SLICE_BUDGET);
+  runMode("stop-the-world major collections", SIZE_MAX);
+  return EXIT_SUCCESS;
+}
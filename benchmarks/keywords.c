@@ -0,0 +1,192 @@
+#include "bench.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "clox/compiler/scanner.h"
+
+#define WORD_COUNT 1000000
+
+/**
+ * @file keywords.c
+ * @brief Identifier classification: the previous nested-switch trie against
+ * the character-class table and perfect-hash keyword lookup.
+ *
+ * Both sides walk the same identifier-heavy text, split it into words and
+ * classify each one, so the loop that finds the end of an identifier is
+ * measured together with the keyword lookup.
+ */
+
+/// @brief Keywords, keyword prefixes/extensions and ordinary identifiers
+static const char *const vocabulary[] = {
+    "and",     "class",    "else",      "false",   "for",     "fun",
+    "if",      "nil",      "or",        "print",   "return",  "super",
+    "this",    "true",     "var",       "while",   "an",      "android",
+    "classic", "elsewhere", "fa",       "fork",    "funnel",  "iffy",
+    "nilpotent", "order",  "printer",   "ret",     "superb",  "thistle",
+    "truest",  "variable", "whiles",    "counter", "index",   "result",
+    "node",    "left",     "right",     "total",   "_tmp",    "value2",
+    "x",       "y",        "Point",     "makeList", "acc",    "f",
+};
+
+typedef struct KeywordBench {
+  const char *text;
+  size_t checksum; ///< Sum of the token types, compared between both sides
+} KeywordBench;
+
+/// @brief Old scanner.h range checks
+static inline bool legacyIsLetter(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static inline bool legacyIsDigit(char c) { return c >= '0' && c <= '9'; }
+
+static TokenType legacyCheckKeyword(const char *start, size_t length,
+                                    size_t offset, size_t restLength,
+                                    const char *rest, TokenType type) {
+  if (length == offset + restLength &&
+      memcmp(start + offset, rest, restLength) == 0) {
+    return type;
+  }
+  return TOKEN_IDENTIFIER;
+}
+
+/// @brief The nested-switch trie the scanner used before the perfect hash
+static TokenType legacyIdentifierType(const char *start, size_t length) {
+  switch (start[0]) {
+  case 'a':
+    return legacyCheckKeyword(start, length, 1, 2, "nd", TOKEN_AND);
+  case 'c':
+    /// The scanner had "less" here, so `class` was never a keyword
+    return legacyCheckKeyword(start, length, 1, 4, "lass", TOKEN_CLASS);
+  case 'e':
+    return legacyCheckKeyword(start, length, 1, 3, "lse", TOKEN_ELSE);
+  case 'f':
+    if (length > 1) {
+      switch (start[1]) {
+      case 'a':
+        return legacyCheckKeyword(start, length, 2, 3, "lse", TOKEN_FALSE);
+      case 'o':
+        return legacyCheckKeyword(start, length, 2, 1, "r", TOKEN_FOR);
+      case 'u':
+        return legacyCheckKeyword(start, length, 2, 1, "n", TOKEN_FUN);
+      default:
+        return TOKEN_IDENTIFIER;
+      }
+    }
+    return TOKEN_IDENTIFIER;
+  case 'i':
+    return legacyCheckKeyword(start, length, 1, 1, "f", TOKEN_IF);
+  case 'n':
+    return legacyCheckKeyword(start, length, 1, 2, "il", TOKEN_NIL);
+  case 'o':
+    return legacyCheckKeyword(start, length, 1, 1, "r", TOKEN_OR);
+  case 'p':
+    return legacyCheckKeyword(start, length, 1, 4, "rint", TOKEN_PRINT);
+  case 'r':
+    return legacyCheckKeyword(start, length, 1, 5, "eturn", TOKEN_RETURN);
+  case 's':
+    return legacyCheckKeyword(start, length, 1, 4, "uper", TOKEN_SUPER);
+  case 't':
+    if (length > 1) {
+      switch (start[1]) {
+      case 'h':
+        return legacyCheckKeyword(start, length, 2, 2, "is", TOKEN_THIS);
+      case 'r':
+        return legacyCheckKeyword(start, length, 2, 2, "ue", TOKEN_TRUE);
+      default:
+        return TOKEN_IDENTIFIER;
+      }
+    }
+    return TOKEN_IDENTIFIER;
+  case 'v':
+    return legacyCheckKeyword(start, length, 1, 2, "ar", TOKEN_VAR);
+  case 'w':
+    return legacyCheckKeyword(start, length, 1, 4, "hile", TOKEN_WHILE);
+  default:
+    return TOKEN_IDENTIFIER;
+  }
+}
+
+static void classifyLegacy(void *ctx) {
+  KeywordBench *bench = ctx;
+  size_t checksum = 0;
+
+  for (const char *current = bench->text; *current != '\0';) {
+    const char *start = current;
+    while (legacyIsLetter(*current) || legacyIsDigit(*current)) {
+      current++;
+    }
+    checksum += legacyIdentifierType(start, (size_t)(current - start));
+    current++; /// The separating space
+  }
+  bench->checksum = checksum;
+}
+
+static void classifyTable(void *ctx) {
+  KeywordBench *bench = ctx;
+  size_t checksum = 0;
+
+  for (const char *current = bench->text; *current != '\0';) {
+    const char *start = current;
+    while (hasCharClass(*current, CHAR_ALPHA | CHAR_DIGIT)) {
+      current++;
+    }
+    checksum += identifierType(start, (size_t)(current - start));
+    current++; /// The separating space
+  }
+  bench->checksum = checksum;
+}
+
+/// @brief WORD_COUNT pseudo-random vocabulary words separated by spaces
+static char *buildText(size_t *length) {
+  size_t vocabularySize = sizeof(vocabulary) / sizeof(vocabulary[0]);
+  size_t capacity = WORD_COUNT * 12 + 1;
+  char *text = malloc(capacity);
+  if (text == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  uint32_t seed = 0x9e3779b9;
+  size_t used = 0;
+  for (size_t i = 0; i < WORD_COUNT; ++i) {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    const char *word = vocabulary[seed % vocabularySize];
+    size_t wordLength = strlen(word);
+    memcpy(text + used, word, wordLength);
+    used += wordLength;
+    text[used++] = ' ';
+  }
+  text[used] = '\0';
+  *length = used;
+  return text;
+}
+
+int main(void) {
+  size_t length;
+  KeywordBench legacy = {.text = buildText(&length)};
+  KeywordBench table = {.text = legacy.text};
+
+  classifyLegacy(&legacy);
+  classifyTable(&table);
+  if (legacy.checksum != table.checksum) {
+    fprintf(stderr, "Keyword lookups disagree: %zu != %zu\n", legacy.checksum,
+            table.checksum);
+    return EXIT_FAILURE;
+  }
+
+  printf("identifiers: %d words, %zu bytes\n", WORD_COUNT, length);
+  runBenchmark("switch trie + range checks", classifyLegacy, &legacy,
+               WORD_COUNT);
+  runBenchmark("perfect hash + class table", classifyTable, &table,
+               WORD_COUNT);
+
+  free((void *)(uintptr_t)legacy.text);
+  return EXIT_SUCCESS;
+}
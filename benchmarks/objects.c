@@ -0,0 +1,155 @@
+#include "bench.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "clox/compiler/compiler.h"
+#include "clox/core/chunk.h"
+#include "clox/core/globals.h"
+#include "clox/core/inline_cache.h"
+#include "clox/core/object.h"
+#include "clox/vm/vm.h"
+
+#define SHAPES 8      ///< Receiver shapes, more than IC_WAYS
+#define ACCESSES 2000 ///< Field reads per run of the access chunk
+#define RUNS 8        ///< Runs of the access chunk per timed call
+#define ACCESS_STATEMENT "o.x + o.y;\n"
+
+/**
+ * @file objects.c
+ * @brief Instance field reads through the inline caches.
+ *
+ * One chunk of ACCESSES field reads of the global `o` is compiled once and
+ * run RUNS times per timed call, with `o` set from C before each run. With
+ * one receiver shape every site is monomorphic and hits on its first entry;
+ * with IC_WAYS shapes the sites are polymorphic and still always hit; with
+ * SHAPES shapes they turn megamorphic and half the reads walk the shape
+ * tree. The instances differ only by the fields added before `x` and `y`.
+ */
+
+static const char setup[] = "class Point {}\n"
+                            "var s0 = Point();\n"
+                            "var s1 = Point(); s1.a = 0;\n"
+                            "var s2 = Point(); s2.b = 0;\n"
+                            "var s3 = Point(); s3.a = 0; s3.b = 0;\n"
+                            "var s4 = Point(); s4.b = 0; s4.a = 0;\n"
+                            "var s5 = Point(); s5.c = 0;\n"
+                            "var s6 = Point(); s6.a = 0; s6.c = 0;\n"
+                            "var s7 = Point(); s7.c = 0; s7.b = 0;\n"
+                            "s0.x = 1; s0.y = 2; s1.x = 1; s1.y = 2;\n"
+                            "s2.x = 1; s2.y = 2; s3.x = 1; s3.y = 2;\n"
+                            "s4.x = 1; s4.y = 2; s5.x = 1; s5.y = 2;\n"
+                            "s6.x = 1; s6.y = 2; s7.x = 1; s7.y = 2;\n"
+                            "var o = s0;\n";
+
+typedef struct ObjectsBench {
+  VM vm;
+  Chunk access;          ///< ACCESSES reads of `o.x` and `o.y`
+  size_t shapes[SHAPES]; ///< Global slots of s0 to s7, one shape each
+  size_t receiver;       ///< Global slot of `o`
+} ObjectsBench;
+
+static void check(InterpretResult result) {
+  if (result != INTERPRET_OK) {
+    fprintf(stderr, "benchmark script failed\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/// @brief RUNS runs of the access chunk, cycling `o` through `shapes`
+static void runAccesses(ObjectsBench *bench, size_t shapes) {
+  Value *values = globalValues(&bench->vm.globals);
+  for (size_t run = 0; run < RUNS; ++run) {
+    values[bench->receiver] = values[bench->shapes[run % shapes]];
+    check(interpretChunk(&bench->vm, &bench->access));
+  }
+}
+
+static void monomorphic(void *ctx) { runAccesses(ctx, 1); }
+
+static void polymorphic(void *ctx) { runAccesses(ctx, IC_WAYS); }
+
+static void megamorphic(void *ctx) { runAccesses(ctx, SHAPES); }
+
+/// @brief Hit rate of the access chunk's caches since the last reset
+static double hitRate(const Chunk *chunk) {
+  uint64_t hits = 0;
+  uint64_t lookups = 0;
+  for (size_t i = 0; i < chunk->caches.count; ++i) {
+    InlineCache *cache = chunkCache(chunk, i);
+    hits += cache->hits;
+    lookups += cache->hits + cache->misses;
+  }
+  return lookups > 0 ? 100.0 * (double)hits / (double)lookups : 0.0;
+}
+
+/// @brief Forget the shapes and counters of every site
+static void resetCaches(Chunk *chunk) {
+  for (size_t i = 0; i < chunk->caches.count; ++i) {
+    InlineCache *cache = chunkCache(chunk, i);
+    initInlineCache(cache, cache->name);
+  }
+}
+
+static void runCase(ObjectsBench *bench, const char *name, BenchFn fn) {
+  resetCaches(&bench->access);
+  runBenchmark(name, fn, bench, (size_t)RUNS * ACCESSES);
+  printf("  hit rate %.1f%%\n", hitRate(&bench->access));
+}
+
+/// @brief ACCESSES / 2 copies of ACCESS_STATEMENT
+static char *buildAccessScript(void) {
+  size_t length = strlen(ACCESS_STATEMENT);
+  size_t statements = ACCESSES / 2;
+  char *source = malloc(length * statements + 1);
+  if (source == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    exit(EXIT_FAILURE);
+  }
+  for (size_t i = 0; i < statements; ++i) {
+    memcpy(source + i * length, ACCESS_STATEMENT, length);
+  }
+  source[length * statements] = '\0';
+  return source;
+}
+
+int main(void) {
+  ObjectsBench *bench = malloc(sizeof(ObjectsBench));
+  if (bench == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    return EXIT_FAILURE;
+  }
+  initVM(&bench->vm);
+  check(interpret(&bench->vm, setup));
+
+  char name[3] = "s0";
+  for (size_t i = 0; i < SHAPES; ++i) {
+    name[1] = (char)('0' + i);
+    ObjString *global = copyString(&bench->vm.heap, name, 2);
+    bench->shapes[i] = resolveGlobal(&bench->vm.globals, global);
+  }
+  bench->receiver = resolveGlobal(&bench->vm.globals,
+                                  copyString(&bench->vm.heap, "o", 1));
+
+  char *source = buildAccessScript();
+  initChunk(&bench->access);
+  bool compiled =
+      compile(source, &bench->access, &bench->vm.heap, &bench->vm.globals);
+  free(source);
+  if (!compiled) {
+    return EXIT_FAILURE;
+  }
+  printf("objects: %d shapes, %zu cache sites\n", SHAPES,
+         bench->access.caches.count);
+
+  runCase(bench, "monomorphic field reads", monomorphic);
+  runCase(bench, "polymorphic field reads", polymorphic);
+  runCase(bench, "megamorphic field reads", megamorphic);
+
+  freeChunk(&bench->access);
+  freeVM(&bench->vm);
+  free(bench);
+  return EXIT_SUCCESS;
+}
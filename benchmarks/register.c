@@ -0,0 +1,166 @@
+#include "bench.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "clox/compiler/peephole.h"
+#include "clox/compiler/register_codegen.h"
+#include "clox/core/chunk.h"
+#include "clox/core/register_chunk.h"
+#include "clox/vm/dispatch.h"
+#include "clox/vm/vm.h"
+
+#define STEPS 1000000
+
+/**
+ * @file register.c
+ * @brief Stack VM against the register VM on the same programs.
+ *
+ * Each program runs as plain stack code, as fused stack code and as the
+ * register translation of the fused code. ns/op divides by the unfused
+ * instruction count, so all three lines compare directly; the instruction
+ * counts and code sizes are printed above them.
+ */
+
+typedef struct RegisterBench {
+  VM vm;
+  Chunk chunk;
+  RegChunk registers;
+} RegisterBench;
+
+static void emitConstant(Chunk *chunk, uint8_t index) {
+  writeChunk(chunk, OP_CONSTANT, 1);
+  writeChunk(chunk, index, 1);
+}
+
+/// @brief `1 + 1 + 1 + ...`
+static void buildAddChunk(Chunk *chunk) {
+  uint8_t one = (uint8_t)addConstant(chunk, NUMBER_VAL(1.0));
+  emitConstant(chunk, one);
+  for (size_t i = 0; i < STEPS; ++i) {
+    emitConstant(chunk, one);
+    writeChunk(chunk, OP_ADD, 1);
+  }
+  writeChunk(chunk, OP_POP, 1);
+  writeChunk(chunk, OP_RETURN, 1);
+}
+
+/// @brief The four arithmetic opcodes in turn, with the odd OP_NEGATE
+static void buildMixedChunk(Chunk *chunk) {
+  static const uint8_t ops[] = {OP_ADD, OP_MULTIPLY, OP_SUBTRACT, OP_DIVIDE};
+
+  uint8_t one = (uint8_t)addConstant(chunk, NUMBER_VAL(1.0));
+  uint8_t step = (uint8_t)addConstant(chunk, NUMBER_VAL(1.5));
+  emitConstant(chunk, one);
+  for (size_t i = 0; i < STEPS; ++i) {
+    emitConstant(chunk, step);
+    writeChunk(chunk, ops[i % 4], 1);
+    if (i % 8 == 0) {
+      writeChunk(chunk, OP_NEGATE, 1);
+    }
+  }
+  writeChunk(chunk, OP_POP, 1);
+  writeChunk(chunk, OP_RETURN, 1);
+}
+
+/// @brief `1 >= 2 == 2 > 1;` per step, as the compiler emits it
+static void buildCompareChunk(Chunk *chunk) {
+  uint8_t one = (uint8_t)addConstant(chunk, NUMBER_VAL(1.0));
+  uint8_t two = (uint8_t)addConstant(chunk, NUMBER_VAL(2.0));
+  for (size_t i = 0; i < STEPS / 4; ++i) {
+    emitConstant(chunk, one);
+    emitConstant(chunk, two);
+    writeChunk(chunk, OP_LESS, 1);
+    writeChunk(chunk, OP_NOT, 1);
+    emitConstant(chunk, two);
+    emitConstant(chunk, one);
+    writeChunk(chunk, OP_GREATER, 1);
+    writeChunk(chunk, OP_EQUAL, 1);
+    writeChunk(chunk, OP_POP, 1);
+  }
+  writeChunk(chunk, OP_RETURN, 1);
+}
+
+static size_t countInstructions(const Chunk *chunk) {
+  const uint8_t *code = (const uint8_t *)chunk->code.data;
+  size_t count = 0;
+  for (size_t offset = 0; offset < chunk->code.count;
+       offset += instructionLength(code[offset])) {
+    count++;
+  }
+  return count;
+}
+
+static void runStack(void *ctx) {
+  RegisterBench *bench = ctx;
+  if (interpretChunk(&bench->vm, &bench->chunk) != INTERPRET_OK) {
+    fprintf(stderr, "benchmark chunk failed\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+static void runRegisters(void *ctx) {
+  RegisterBench *bench = ctx;
+  if (interpretRegisterChunk(&bench->vm, &bench->registers) !=
+      INTERPRET_OK) {
+    fprintf(stderr, "benchmark register chunk failed\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+static void benchProgram(RegisterBench *bench, const char *name,
+                         void (*build)(Chunk *chunk)) {
+  initChunk(&bench->chunk);
+  build(&bench->chunk);
+  size_t ops = countInstructions(&bench->chunk);
+  size_t stackBytes = bench->chunk.code.count;
+  char label[64];
+
+  printf("%s\n", name);
+  snprintf(label, sizeof(label), "  stack (%zu ins)", ops);
+  runBenchmark(label, runStack, bench, ops);
+
+  fuseInstructions(&bench->chunk);
+  size_t fused = countInstructions(&bench->chunk);
+  size_t fusedBytes = bench->chunk.code.count;
+  snprintf(label, sizeof(label), "  stack fused (%zu ins)", fused);
+  runBenchmark(label, runStack, bench, ops);
+
+  initRegChunk(&bench->registers);
+  if (!generateRegisterCode(&bench->chunk, &bench->registers)) {
+    fprintf(stderr, "%s: register window too large\n", name);
+    exit(EXIT_FAILURE);
+  }
+  size_t registerCount = bench->registers.code.count;
+  snprintf(label, sizeof(label), "  register (%zu ins)", registerCount);
+  runBenchmark(label, runRegisters, bench, ops);
+
+  printf("  code: stack %zu B, fused %zu B, register %zu B "
+         "(%.2fx instructions, %.2fx bytes of fused)\n",
+         stackBytes, fusedBytes, registerCount * sizeof(RegInstruction),
+         (double)registerCount / (double)fused,
+         (double)(registerCount * sizeof(RegInstruction)) /
+             (double)fusedBytes);
+
+  freeRegChunk(&bench->registers);
+  freeChunk(&bench->chunk);
+}
+
+int main(void) {
+#ifdef CLOX_THREADED_DISPATCH
+  printf("dispatch: threaded (computed goto)\n");
+#else
+  printf("dispatch: switch\n");
+#endif
+
+  RegisterBench bench;
+  initVM(&bench.vm);
+
+  benchProgram(&bench, "add chain", buildAddChunk);
+  benchProgram(&bench, "mixed arithmetic", buildMixedChunk);
+  benchProgram(&bench, "comparisons", buildCompareChunk);
+
+  freeVM(&bench.vm);
+  return EXIT_SUCCESS;
+}
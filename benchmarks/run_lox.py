@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+"""Time clox on the Lox programs in benchmarks/lox.
+
+Each program is repeated --scale times into a temporary file, so the run is
+dominated by clox rather than process startup. Every program is timed cold
+(bytecode cache removed before each run, so scan + compile + run) and warm
+(loaded from the .loxc cache). Runs use the same warm-up, repeat and
+statistics as the C benchmarks (see bench.h), including CLOX_BENCH_WARMUP,
+CLOX_BENCH_REPEAT and the JSON output to CLOX_BENCH_JSON.
+
+Usage: run_lox.py [--scale N] CLOX PROGRAM.lox...
+"""
+
+import argparse
+import json
+import os
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+from typing import List
+
+
+def setting(name: str, fallback: int) -> int:
+    try:
+        value = int(os.environ.get(name, fallback))
+    except ValueError:
+        return fallback
+    return value if 0 < value <= 100000 else fallback
+
+
+def run_once(clox: str, path: str, cold: bool) -> float:
+    if cold:
+        try:
+            os.remove(os.path.splitext(path)[0] + ".loxc")
+        except FileNotFoundError:
+            pass
+    start = time.perf_counter()
+    result = subprocess.run([clox, path], stdout=subprocess.DEVNULL)
+    elapsed = time.perf_counter() - start
+    if result.returncode != 0:
+        sys.exit(f"{path}: clox exited with {result.returncode}")
+    return elapsed
+
+
+def measure(clox: str, path: str, cold: bool, warmup: int,
+            repeat: int) -> dict:
+    for _ in range(warmup):
+        run_once(clox, path, cold)
+    samples = sorted(run_once(clox, path, cold) for _ in range(repeat))
+    return {
+        "warmup": warmup,
+        "repeat": repeat,
+        "median_s": samples[len(samples) // 2],
+        "mean_s": statistics.fmean(samples),
+        "stddev_s": statistics.stdev(samples) if repeat > 1 else 0.0,
+        "min_s": samples[0],
+        "max_s": samples[-1],
+    }
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--scale", type=int, default=2000)
+    parser.add_argument("clox")
+    parser.add_argument("programs", nargs="+")
+    args = parser.parse_args()
+
+    warmup = setting("CLOX_BENCH_WARMUP", 3)
+    repeat = setting("CLOX_BENCH_REPEAT", 15)
+    records: List[dict] = []
+
+    with tempfile.TemporaryDirectory() as scratch:
+        for program in args.programs:
+            with open(program) as source:
+                text = source.read()
+            name = os.path.basename(program)
+            path = os.path.join(scratch, name)
+            with open(path, "w") as scaled:
+                scaled.write(text * args.scale)
+            size = len(text) * args.scale
+            print(f"{name}: {size} bytes")
+
+            for cold in (True, False):
+                label = f"{name} ({'cold' if cold else 'cached'})"
+                result = measure(args.clox, path, cold, warmup, repeat)
+                median = result["median_s"]
+                spread = 100 * result["stddev_s"] / result["mean_s"]
+                print(f"  {label:<30} median {median * 1e3:9.3f} ms"
+                      f"  best {result['min_s'] * 1e3:9.3f} ms"
+                      f"  +-{spread:4.1f}%"
+                      f"  {size / median * 1e-6:8.1f} MB/s")
+                records.append({"name": label, "unit": "byte",
+                                "per_call": size, **result})
+
+    output = os.environ.get("CLOX_BENCH_JSON")
+    if output:
+        with open(output, "w") as out:
+            json.dump({"benchmarks": records}, out, indent=2)
+            out.write("\n")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,211 @@
+#include "bench.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "clox/compiler/scanner.h"
+#include "clox/compiler/scanner_simd.h"
+#include "clox/compiler/token_buffer.h"
+
+#define CORPUS_SIZE (8u * 1024u * 1024u) ///< Bytes of generated source
+
+typedef struct ScannerBench {
+  const char *source;
+  const ScanKernels *kernels;
+  size_t tokens; ///< Tokens seen by the last run
+  size_t lines;  ///< Final line number of the last run
+} ScannerBench;
+
+typedef struct Corpus {
+  char *text;
+  size_t length;
+  size_t capacity;
+} Corpus;
+
+static void append(Corpus *corpus, const char *text) {
+  size_t length = strlen(text);
+  if (corpus->length + length >= corpus->capacity) {
+    return;
+  }
+  memcpy(corpus->text + corpus->length, text, length);
+  corpus->length += length;
+  corpus->text[corpus->length] = '\0';
+}
+
+static bool full(const Corpus *corpus) {
+  return corpus->length + 4096 >= corpus->capacity;
+}
+
+/// @brief Deterministic pseudo-random numbers (xorshift32)
+static uint32_t nextRandom(uint32_t *state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+static void appendIndent(Corpus *corpus, uint32_t *seed) {
+  static const char spaces[] = "                ";
+  append(corpus, spaces + sizeof(spaces) - 1 - 4 * (nextRandom(seed) % 5));
+}
+
+/// @brief Indented statements with the odd short trailing comment
+static void appendCode(Corpus *corpus, uint32_t *seed) {
+  appendIndent(corpus, seed);
+  append(corpus, "print (12.5 + counter) * 3 - total / 4 >= 7;");
+  append(corpus, nextRandom(seed) % 4 == 0 ? "  // tweak\n" : "\n");
+}
+
+/// @brief A block of `//` comment lines, like generated file headers
+static void appendComments(Corpus *corpus, uint32_t *seed) {
+  uint32_t lines = 4 + nextRandom(seed) % 12;
+  for (uint32_t i = 0; i < lines; ++i) {
+    appendIndent(corpus, seed);
+    append(corpus, "// Generated from schema.lox, do not edit. The fields "
+                   "below mirror the table layout.\n");
+  }
+}
+
+/// @brief A long string literal spanning several lines
+static void appendString(Corpus *corpus, uint32_t *seed) {
+  uint32_t lines = 1 + nextRandom(seed) % 8;
+  append(corpus, "print \"");
+  for (uint32_t i = 0; i < lines; ++i) {
+    append(corpus, "Lorem ipsum dolor sit amet, consectetur adipiscing elit, "
+                   "sed do eiusmod tempor incididunt ut labore et dolore.\n");
+  }
+  append(corpus, "\";\n");
+}
+
+typedef void (*AppendFn)(Corpus *corpus, uint32_t *seed);
+
+/// @brief Fill a corpus by picking among `parts` with the given weights
+static Corpus buildCorpus(const AppendFn *parts, const uint32_t *weights,
+                          size_t count) {
+  Corpus corpus = {.text = malloc(CORPUS_SIZE), .capacity = CORPUS_SIZE};
+  if (corpus.text == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    exit(EXIT_FAILURE);
+  }
+  corpus.text[0] = '\0';
+
+  uint32_t total = 0;
+  for (size_t i = 0; i < count; ++i) {
+    total += weights[i];
+  }
+
+  uint32_t seed = 0x2545f491;
+  while (!full(&corpus)) {
+    uint32_t pick = nextRandom(&seed) % total;
+    size_t part = 0;
+    while (pick >= weights[part]) {
+      pick -= weights[part++];
+    }
+    parts[part](&corpus, &seed);
+  }
+  return corpus;
+}
+
+static void scanAllTokens(void *ctx) {
+  ScannerBench *bench = ctx;
+  Scanner scanner;
+  initScanner(&scanner, bench->source);
+  scanner.kernels = bench->kernels;
+
+  size_t tokens = 0;
+  for (;;) {
+    Token token = scanToken(&scanner);
+    tokens++;
+    if (token.type == TOKEN_EOF) {
+      break;
+    }
+  }
+  bench->tokens = tokens;
+  bench->lines = scanner.line;
+}
+
+static void scanIntoBuffer(void *ctx) {
+  ScannerBench *bench = ctx;
+  TokenBuffer buffer;
+  initTokenBuffer(&buffer, NULL);
+  if (!scanAll(bench->source, &buffer)) {
+    fprintf(stderr, "Corpus too large for a token buffer.\n");
+    exit(EXIT_FAILURE);
+  }
+  bench->tokens = buffer.count;
+  bench->lines = buffer.lineCount;
+  freeTokenBuffer(&buffer);
+}
+
+/// @brief scanAll() into a packed TokenBuffer, and its size against Tokens
+static void benchScanAll(const Corpus *corpus) {
+  ScannerBench bench = {.source = corpus->text};
+  scanIntoBuffer(&bench);
+
+  size_t packed = bench.tokens * (sizeof(uint8_t) + 2 * sizeof(uint32_t)) +
+                  bench.lines * sizeof(TokenLine);
+  printf("  scanAll: %zu tokens, %.1f bytes/token (Token: %zu)\n",
+         bench.tokens, (double)packed / (double)bench.tokens, sizeof(Token));
+  runThroughputBenchmark("  scanAll", scanIntoBuffer, &bench, corpus->length);
+}
+
+static void benchCorpus(const char *name, const Corpus *corpus) {
+  printf("%s: %zu bytes\n", name, corpus->length);
+
+  ScannerBench reference = {.source = corpus->text,
+                            .kernels = getScanKernels(SCAN_KERNEL_SCALAR)};
+  scanAllTokens(&reference);
+
+  for (int kernel = 0; kernel < SCAN_KERNEL_COUNT; ++kernel) {
+    if (!scanKernelSupported((ScanKernel)kernel)) {
+      continue;
+    }
+
+    ScannerBench bench = {.source = corpus->text,
+                          .kernels = getScanKernels((ScanKernel)kernel)};
+    scanAllTokens(&bench);
+    if (bench.tokens != reference.tokens || bench.lines != reference.lines) {
+      fprintf(stderr, "%s: %s scanned %zu tokens/%zu lines, expected %zu/%zu\n",
+              name, scanKernelName((ScanKernel)kernel), bench.tokens,
+              bench.lines, reference.tokens, reference.lines);
+      exit(EXIT_FAILURE);
+    }
+
+    char label[64];
+    snprintf(label, sizeof(label), "  %s", scanKernelName((ScanKernel)kernel));
+    runThroughputBenchmark(label, scanAllTokens, &bench, corpus->length);
+  }
+  benchScanAll(corpus);
+}
+
+int main(void) {
+  printf("scanner kernel: %s\n", scanKernelName(bestScanKernel()));
+
+  static const AppendFn mixedParts[] = {appendCode, appendComments,
+                                        appendString};
+  static const uint32_t mixedWeights[] = {12, 2, 1};
+  static const AppendFn codeParts[] = {appendCode};
+  static const uint32_t codeWeights[] = {1};
+  static const AppendFn commentParts[] = {appendComments};
+  static const AppendFn stringParts[] = {appendString};
+
+  struct {
+    const char *name;
+    Corpus corpus;
+  } corpora[] = {
+      {"mixed", buildCorpus(mixedParts, mixedWeights, 3)},
+      {"code", buildCorpus(codeParts, codeWeights, 1)},
+      {"comments", buildCorpus(commentParts, codeWeights, 1)},
+      {"strings", buildCorpus(stringParts, codeWeights, 1)},
+  };
+
+  for (size_t i = 0; i < sizeof(corpora) / sizeof(corpora[0]); ++i) {
+    benchCorpus(corpora[i].name, &corpora[i].corpus);
+    free(corpora[i].corpus.text);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,123 @@
+#include "bench.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "clox/core/object.h"
+#include "clox/core/table.h"
+#include "clox/core/value.h"
+
+#define KEYS 65536  ///< Distinct strings per timed run
+#define KEY_SIZE 16 ///< Bytes reserved per generated key
+
+/**
+ * @file table.c
+ * @brief String interning and hash table operations.
+ *
+ * Interning new strings pays for hashing, allocation and table growth (the
+ * heap is freed inside the timed run); interning strings that already exist
+ * only hashes and compares. The table lookups compare keys by pointer, and
+ * the churn benchmark deletes and reinserts every key, so each insertion
+ * lands on a tombstone.
+ */
+
+typedef struct TableBench {
+  char keys[KEYS][KEY_SIZE];
+  size_t lengths[KEYS];
+  Heap heap;                ///< Holds every key and every missing key
+  Table table;              ///< Maps each key to its index
+  ObjString *present[KEYS]; ///< Keys of `table`
+  ObjString *missing[KEYS]; ///< Interned, but never added to `table`
+  double checksum;          ///< Keeps the lookups observable
+} TableBench;
+
+static void internNew(void *ctx) {
+  TableBench *bench = ctx;
+  Heap heap;
+  initHeap(&heap);
+  for (size_t i = 0; i < KEYS; ++i) {
+    copyString(&heap, bench->keys[i], bench->lengths[i]);
+  }
+  bench->checksum += (double)heap.strings.count;
+  freeHeap(&heap);
+}
+
+static void internExisting(void *ctx) {
+  TableBench *bench = ctx;
+  size_t found = 0;
+  for (size_t i = 0; i < KEYS; ++i) {
+    ObjString *string =
+        copyString(&bench->heap, bench->keys[i], bench->lengths[i]);
+    found += string == bench->present[i];
+  }
+  bench->checksum += (double)found;
+}
+
+static void lookup(TableBench *bench, ObjString *const *keys) {
+  double sum = 0;
+  for (size_t i = 0; i < KEYS; ++i) {
+    Value value;
+    if (tableGet(&bench->table, keys[i], &value)) {
+      sum += AS_NUMBER(value);
+    }
+  }
+  bench->checksum += sum;
+}
+
+static void getHit(void *ctx) {
+  TableBench *bench = ctx;
+  lookup(bench, bench->present);
+}
+
+static void getMiss(void *ctx) {
+  TableBench *bench = ctx;
+  lookup(bench, bench->missing);
+}
+
+static void deleteReinsert(void *ctx) {
+  TableBench *bench = ctx;
+  for (size_t i = 0; i < KEYS; ++i) {
+    tableDelete(&bench->table, bench->present[i]);
+    tableSet(&bench->table, bench->present[i], NUMBER_VAL((double)i));
+  }
+  bench->checksum += (double)bench->table.count;
+}
+
+int main(void) {
+  TableBench *bench = malloc(sizeof(TableBench));
+  if (bench == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    return EXIT_FAILURE;
+  }
+  bench->checksum = 0;
+  initHeap(&bench->heap);
+  initTable(&bench->table);
+
+  char missing[KEY_SIZE];
+  for (size_t i = 0; i < KEYS; ++i) {
+    int length = snprintf(bench->keys[i], KEY_SIZE, "key%zu", i);
+    bench->lengths[i] = (size_t)length;
+    bench->present[i] =
+        copyString(&bench->heap, bench->keys[i], bench->lengths[i]);
+    tableSet(&bench->table, bench->present[i], NUMBER_VAL((double)i));
+
+    length = snprintf(missing, KEY_SIZE, "miss%zu", i);
+    bench->missing[i] = copyString(&bench->heap, missing, (size_t)length);
+  }
+  printf("table: %zu entries in %zu slots\n", bench->table.count,
+         bench->table.capacity);
+
+  runBenchmark("intern new strings", internNew, bench, KEYS);
+  runBenchmark("intern existing strings", internExisting, bench, KEYS);
+  runBenchmark("tableGet, hit", getHit, bench, KEYS);
+  runBenchmark("tableGet, miss", getMiss, bench, KEYS);
+  runBenchmark("tableDelete + tableSet", deleteReinsert, bench, KEYS);
+
+  printf("checksum: %.0f\n", bench->checksum);
+  freeTable(&bench->table);
+  freeHeap(&bench->heap);
+  free(bench);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,261 @@
+#ifndef CLOX_CLOX_H
+#define CLOX_CLOX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @file clox.h
+ * @brief Public API of libclox, for embedding the interpreter.
+ *
+ * This is the only header installed with the library; everything else is
+ * internal. The library keeps no global interpreter state, so any number of
+ * VMs can live side by side, one per thread at a time:
+ * @code
+ * CloxVM *vm = cloxNewVM();
+ * cloxDefineNative(vm, "clock", 0, clockNative);
+ * CloxProgram *program = cloxCompile(vm, "print clock() * 2;");
+ * for (int i = 0; i < 1000; ++i) {
+ *   cloxRunProgram(vm, program); // no compile, no process startup
+ * }
+ * cloxFreeProgram(program);
+ * cloxFreeVM(vm);
+ * @endcode
+ *
+ * Host functions are global variables of their VM: scripts call them as
+ * `name(arguments)`, and a native only has to be defined by the time the
+ * call runs, not when the program is compiled. Strings are interned per VM,
+ * so a program belongs to the VM it was compiled for and must be freed
+ * before it. Compile and runtime errors are reported on stderr and `print`
+ * writes to stdout.
+ *
+ * Memory accounting and garbage collection pauses are kept per thread,
+ * summed over the VMs used on it, and each program counts the hits and
+ * misses of its inline caches; these are what `clox --mem-stats` and
+ * `clox --ic-stats` print. The sampling profiler of the command line tool
+ * is process-wide (it uses SIGPROF) and is not part of this API.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define CLOX_API __attribute__((visibility("default")))
+#else
+#define CLOX_API
+#endif
+
+/// @brief An interpreter instance: operand stack and host functions
+typedef struct CloxVM CloxVM;
+
+/// @brief A compiled script, reusable across runs of its VM
+typedef struct CloxProgram CloxProgram;
+
+typedef enum CloxResult {
+  CLOX_OK,
+  CLOX_COMPILE_ERROR,
+  CLOX_RUNTIME_ERROR,
+} CloxResult;
+
+typedef enum CloxType {
+  CLOX_NIL,
+  CLOX_BOOL,
+  CLOX_NUMBER,
+  CLOX_STRING,
+  CLOX_OBJECT, ///< Any other object (an instance, a class, a native...)
+} CloxType;
+
+/// @brief A Lox value as seen by host functions
+typedef struct CloxValue {
+  CloxType type;
+  union {
+    bool boolean;
+    double number;
+    struct {
+      const char *chars; ///< Not NUL-terminated in results
+      size_t length;
+    } string;     ///< Arguments are valid until the native returns
+    void *object; ///< Opaque; only returned to the VM it came from, and
+                  ///< valid until the native returns (objects move)
+  } as;
+} CloxValue;
+
+/**
+ * @brief A host function callable from scripts.
+ *
+ * @param args `argCount` arguments, valid until the function returns.
+ * @param result Receives the return value, nil unless set. A string result
+ *               is copied (interned) when the native returns.
+ *
+ * @return false to raise a runtime error, with the message passed to
+ * cloxNativeError() if any.
+ */
+typedef bool (*CloxNativeFn)(CloxVM *vm, int argCount, const CloxValue *args,
+                             CloxValue *result);
+
+/// @brief Version of the library, e.g. "0.1.0"
+CLOX_API const char *cloxVersion(void);
+
+/// @return A new VM, or NULL if out of memory.
+CLOX_API CloxVM *cloxNewVM(void);
+CLOX_API void cloxFreeVM(CloxVM *vm);
+
+/**
+ * @brief Compile and run `source`, a NUL-terminated script.
+ *
+ * A VM cannot be re-entered: calling this from a host function of the same
+ * VM fails with CLOX_RUNTIME_ERROR.
+ */
+CLOX_API CloxResult cloxInterpret(CloxVM *vm, const char *source);
+
+/**
+ * @brief Compile `source` for `vm`, without running it.
+ *
+ * @return The compiled script, or NULL after reporting compile errors.
+ */
+CLOX_API CloxProgram *cloxCompile(CloxVM *vm, const char *source);
+/**
+ * @brief Run a program compiled by cloxCompile(), see cloxInterpret().
+ *
+ * Fails with CLOX_RUNTIME_ERROR if `program` was compiled for another VM.
+ */
+CLOX_API CloxResult cloxRunProgram(CloxVM *vm, CloxProgram *program);
+CLOX_API void cloxFreeProgram(CloxProgram *program);
+
+/**
+ * @brief Make `fn` callable as `name(...)` by scripts run on `vm`.
+ *
+ * Defines (or assigns) the global variable `name`, so redefining a name
+ * replaces the previous function.
+ *
+ * @param arity Number of arguments `fn` expects, or -1 for any number.
+ * @return false if `name` is new and the VM has no global slot left.
+ */
+CLOX_API bool cloxDefineNative(CloxVM *vm, const char *name, int arity,
+                               CloxNativeFn fn);
+
+/// @brief Message of the runtime error raised when a native returns false
+CLOX_API void cloxNativeError(CloxVM *vm, const char *message);
+
+/// @brief Pointer kept for the embedder, e.g. for host functions
+CLOX_API void cloxSetUserData(CloxVM *vm, void *userData);
+CLOX_API void *cloxGetUserData(const CloxVM *vm);
+
+/// @brief Allocations of one subsystem, or of all of them
+typedef struct CloxMemoryStats {
+  const char *name;     ///< Subsystem, e.g. "strings", or "total"
+  size_t liveBytes;     ///< Bytes currently allocated
+  size_t peakBytes;     ///< Largest liveBytes seen
+  size_t allocations;   ///< New blocks
+  size_t reallocations; ///< Resizes of existing blocks
+  size_t frees;         ///< Released blocks
+} CloxMemoryStats;
+
+/**
+ * @brief Memory accounting of `vm`, one subsystem at a time.
+ *
+ * Covers what the VM allocates for itself: its objects, strings, nursery
+ * and stack. Compiled chunks, tables and compiler data are only counted in
+ * the totals of the thread that `clox --mem-stats` prints.
+ *
+ * @param index 0 for the total over all subsystems, then 1, 2... for each.
+ * @return false, leaving `stats` alone, once `index` is past the last one.
+ */
+CLOX_API bool cloxGetMemoryStats(const CloxVM *vm, size_t index,
+                                 CloxMemoryStats *stats);
+/// @brief Zero the counters of `vm`, e.g. between phases
+CLOX_API void cloxResetMemoryStats(CloxVM *vm);
+/// @brief `vm`'s counters in the format of `clox --mem-stats`
+CLOX_API void cloxPrintMemoryStats(const CloxVM *vm, FILE *out);
+
+typedef enum CloxGcKind {
+  CLOX_GC_MINOR, ///< Promotes the survivors of the nursery, in one pause
+  CLOX_GC_MAJOR, ///< Marks and sweeps the old generation, in slices
+} CloxGcKind;
+
+/// @brief Garbage collections of one kind, see cloxGetGcStats()
+typedef struct CloxGcStats {
+  size_t collections;  ///< Collections completed
+  size_t bytes;        ///< Bytes promoted (minor) or freed (major)
+  size_t pauses;       ///< Times scripts stopped for this kind
+  uint64_t pauseNs;    ///< Time spent in those pauses
+  uint64_t p50PauseNs; ///< Median pause, within 25%
+  uint64_t p99PauseNs; ///< 99th percentile pause, within 25%
+  uint64_t maxPauseNs; ///< Longest pause
+} CloxGcStats;
+
+/**
+ * @brief Collections of `kind` run by `vm` since it was created, or since
+ * cloxResetMemoryStats().
+ *
+ * @return false, leaving `stats` alone, if `kind` is not a CloxGcKind.
+ */
+CLOX_API bool cloxGetGcStats(const CloxVM *vm, CloxGcKind kind,
+                             CloxGcStats *stats);
+
+/// @brief What one inline cache of a program has seen
+typedef struct CloxCacheStats {
+  const char *name; ///< Field the site accesses
+  unsigned shapes;  ///< Receiver shapes cached, at most 4
+  bool megamorphic; ///< Saw more shapes than it caches, and stopped learning
+  uint64_t hits;    ///< Lookups answered by the cache
+  uint64_t misses;  ///< Lookups that took the slow path
+} CloxCacheStats;
+
+/**
+ * @brief Inline cache statistics of `program`, one cache at a time.
+ *
+ * Each property access, store and method call of the program has a cache,
+ * numbered in source order; the counters add up over every run.
+ *
+ * @return false, leaving `stats` alone, once `index` is past the last one.
+ */
+CLOX_API bool cloxGetCacheStats(const CloxProgram *program, size_t index,
+                                CloxCacheStats *stats);
+
+static inline CloxValue cloxNil(void) {
+  CloxValue value;
+  value.type = CLOX_NIL;
+  value.as.number = 0;
+  return value;
+}
+
+static inline CloxValue cloxBool(bool boolean) {
+  CloxValue value;
+  value.type = CLOX_BOOL;
+  value.as.boolean = boolean;
+  return value;
+}
+
+static inline CloxValue cloxNumber(double number) {
+  CloxValue value;
+  value.type = CLOX_NUMBER;
+  value.as.number = number;
+  return value;
+}
+
+/// @brief A string of `length` bytes at `chars`, e.g. for a native's result
+static inline CloxValue cloxString(const char *chars, size_t length) {
+  CloxValue value;
+  value.type = CLOX_STRING;
+  value.as.string.chars = chars;
+  value.as.string.length = length;
+  return value;
+}
+
+/// @brief An object argument of a native, e.g. to return it unchanged
+static inline CloxValue cloxObject(void *object) {
+  CloxValue value;
+  value.type = CLOX_OBJECT;
+  value.as.object = object;
+  return value;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
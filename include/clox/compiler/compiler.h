@@ -1,6 +1,41 @@
 #ifndef CLOX_COMPILER_H
 #define CLOX_COMPILER_H
 
-void CLOX_Compile(const char *source);
+#include <stdbool.h>
+
+#include "clox/core/chunk.h"
+#include "clox/core/globals.h"
+#include "clox/core/memory.h"
+#include "clox/core/object.h"
+
+/**
+ * @brief Compile Lox source code into bytecode.
+ *
+ * The source is tokenized up front with scanAll(); the parser then makes a
+ * single pass over the token buffer and writes bytecode straight into
+ * `chunk`, without building an AST. Everything else the compiler allocates
+ * comes from an Arena released in one go before returning.
+ *
+ * @param source NUL-terminated source code.
+ * @param chunk An initialized chunk that receives the bytecode.
+ * @param heap Heap of the VM that will run the chunk; string literals and
+ *             names are interned there.
+ * @param globals Global slots of that VM; new global names get a slot even
+ *                if compilation fails.
+ *
+ * @return false if any compile error was reported (on stderr).
+ */
+bool compile(const char *source, Chunk *chunk, Heap *heap, Globals *globals);
+
+/**
+ * @brief compile() with the compiler's own allocations (tokens, constant
+ * table) taken from `arena`.
+ *
+ * Nothing in `chunk` points into the arena, so it can be reset or freed as
+ * soon as this returns; reusing one arena across compilations saves the
+ * block allocations.
+ */
+bool compileInArena(const char *source, Chunk *chunk, Heap *heap,
+                    Globals *globals, Arena *arena);
 
 #endif
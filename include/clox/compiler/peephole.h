@@ -0,0 +1,29 @@
+#ifndef CLOX_COMPILER_PEEPHOLE_H
+#define CLOX_COMPILER_PEEPHOLE_H
+
+#include "clox/core/chunk.h"
+
+/**
+ * @file peephole.h
+ * @brief Fusion of common instruction pairs into superinstructions.
+ *
+ * The pairs were picked by mining execution traces with
+ * tools/mine_traces.py:
+ * - `OP_CONSTANT k; OP_ADD` (and SUBTRACT, MULTIPLY, DIVIDE) becomes
+ *   `OP_ADD_CONSTANT k` when k is a number,
+ * - `OP_CONSTANT a; OP_CONSTANT b` becomes `OP_CONSTANT_CONSTANT a b`,
+ *   unless `b` can fuse with the arithmetic after it.
+ *
+ * Only 8-bit constant operands are fused. A fused arithmetic instruction
+ * takes the line of the operator, so runtime errors still point at it.
+ */
+
+/**
+ * @brief Rewrite a finished chunk with superinstructions.
+ *
+ * Runs in one pass and rebuilds the line table alongside the code. Does
+ * nothing when the `superinstructions` meson option is off.
+ */
+void fuseInstructions(Chunk *chunk);
+
+#endif
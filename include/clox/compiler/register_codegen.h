@@ -0,0 +1,32 @@
+#ifndef CLOX_COMPILER_REGISTER_CODEGEN_H
+#define CLOX_COMPILER_REGISTER_CODEGEN_H
+
+#include <stdbool.h>
+
+#include "clox/core/chunk.h"
+#include "clox/core/register_chunk.h"
+
+/**
+ * @file register_codegen.h
+ * @brief Register VM back end: stack bytecode to 3-address code.
+ *
+ * Without jumps the stack depth at every instruction is known statically,
+ * so each stack slot maps to a fixed temporary register. Constant loads
+ * emit nothing: the operand stack of the translation simply refers to the
+ * constant's slot, and the consuming instruction reads it in place.
+ * `OP_EQUAL/OP_GREATER/OP_LESS` followed by `OP_NOT` become one negated
+ * comparison.
+ */
+
+/**
+ * @brief Translate a compiled (or cached) stack chunk into `out`.
+ *
+ * @param out An initialized RegChunk.
+ *
+ * @return false if the register window would need more than REG_SLOT_MAX
+ * slots, or the chunk uses calls or objects other than strings; it can
+ * still run on the stack VM.
+ */
+bool generateRegisterCode(const Chunk *chunk, RegChunk *out);
+
+#endif
@@ -3,6 +3,9 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+
+#include "clox/compiler/scanner_simd.h"
 
 /**
  * @enum TokenType
@@ -101,9 +104,10 @@ typedef struct Token {
 } Token;
 
 typedef struct Sanner {
-  const char *start;   ///< Pointer to token start char
-  const char *current; ///< The character pointing to the present
-  size_t line;         ///< The line number being scanned now
+  const char *start;          ///< Pointer to token start char
+  const char *current;        ///< The character pointing to the present
+  size_t line;                ///< The line number being scanned now
+  const ScanKernels *kernels; ///< Bulk search routines for this CPU
 } Scanner;
 
 static inline char advance(Scanner *scanner) { return *scanner->current++; }
@@ -120,16 +124,40 @@ static inline char peekNextChar(Scanner *scanner) {
   return scanner->current[1];
 }
 
-static inline bool isNumberChar(Scanner *scanner, char thisChar) {
-  return thisChar >= '0' && thisChar <= '9';
+/**
+ * @brief Character classes of the scanner, one bit each.
+ *
+ * Looked up through scannerCharClass so that every test is a single load
+ * and mask instead of a chain of range comparisons.
+ */
+typedef enum CharClass {
+  CHAR_ALPHA = 1 << 0,    ///< [A-Za-z_], may start an identifier
+  CHAR_DIGIT = 1 << 1,    ///< [0-9]
+  CHAR_BLANK = 1 << 2,    ///< ' ', '\t', '\r', '\n'
+  CHAR_OPERATOR = 1 << 3, ///< Always a one-character token
+  CHAR_EQUALS = 1 << 4,   ///< One-character token, or two with a '=' after
+} CharClass;
+
+extern const uint8_t scannerCharClass[256];
+
+static inline bool hasCharClass(char thisChar, uint8_t charClass) {
+  return (scannerCharClass[(uint8_t)thisChar] & charClass) != 0;
+}
+
+static inline bool isNumberChar(char thisChar) {
+  return hasCharClass(thisChar, CHAR_DIGIT);
+}
+
+static inline bool isLetter(char thisChar) {
+  return hasCharClass(thisChar, CHAR_ALPHA);
 }
 
-static inline bool isLetter(Scanner *scanner, char thisChar) {
-  return (thisChar >= 'a' && thisChar <= 'z') ||
-         (thisChar >= 'A' && thisChar <= 'Z') || thisChar == '_';
+static inline bool isBlank(char thisChar) {
+  return hasCharClass(thisChar, CHAR_BLANK);
 }
 
 void initScanner(Scanner *scanner, const char *source);
 Token scanToken(Scanner *scanner);
+TokenType identifierType(const char *start, size_t length);
 
 #endif
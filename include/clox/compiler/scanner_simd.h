@@ -0,0 +1,47 @@
+#ifndef CLOX_COMPILER_SCANNER_SIMD_H
+#define CLOX_COMPILER_SCANNER_SIMD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @file scanner_simd.h
+ * @brief Bulk character search used by the scanner's hot loops.
+ *
+ * Each kernel scans a NUL-terminated buffer a whole vector at a time. Loads
+ * are aligned, so they never cross into a page the buffer does not touch,
+ * and they stop at the terminating '\0'.
+ */
+
+/// @brief Implementations of the kernels, fastest last
+typedef enum ScanKernel {
+  SCAN_KERNEL_SCALAR, ///< Byte at a time, always available
+  SCAN_KERNEL_SSE2,   ///< 16 bytes per step (x86)
+  SCAN_KERNEL_AVX2,   ///< 32 bytes per step (x86, AVX2 + POPCNT at run time)
+  SCAN_KERNEL_COUNT,
+} ScanKernel;
+
+/// @brief One set of search routines
+typedef struct ScanKernels {
+  /// First byte that is not ' ', '\t', '\r' or '\n'; adds the '\n's skipped
+  const char *(*skipBlanks)(const char *current, size_t *newlines);
+  /// First '\n' or '\0' (the end of a `//` comment)
+  const char *(*findLineEnd)(const char *current);
+  /// First '"' or '\0'; adds the '\n's skipped
+  const char *(*findStringEnd)(const char *current, size_t *newlines);
+} ScanKernels;
+
+bool scanKernelSupported(ScanKernel kernel);
+const char *scanKernelName(ScanKernel kernel);
+
+/**
+ * @brief Fastest kernel supported by this CPU.
+ *
+ * Always SCAN_KERNEL_SCALAR when the `scanner_simd` meson option is off.
+ */
+ScanKernel bestScanKernel(void);
+
+/// @brief Routines of `kernel`, which must be supported
+const ScanKernels *getScanKernels(ScanKernel kernel);
+
+#endif
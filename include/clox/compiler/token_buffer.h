@@ -0,0 +1,95 @@
+#ifndef CLOX_COMPILER_TOKEN_BUFFER_H
+#define CLOX_COMPILER_TOKEN_BUFFER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "clox/compiler/scanner.h"
+#include "clox/core/memory.h"
+
+/**
+ * @file token_buffer.h
+ * @brief Whole-source tokenization into a packed structure of arrays.
+ *
+ * Each token costs 9 bytes (type, offset, length) instead of the 32 of a
+ * Token. Lines are stored sparsely, one TokenLine per line change, and
+ * error messages live in a side table since they do not point into the
+ * source. Offsets and lengths are 32 bits, so sources are limited to 4 GiB.
+ *
+ * A buffer given an Arena allocates all of its arrays there and leaves their
+ * release to the arena; otherwise it uses the heap.
+ */
+
+/// @brief First token on a new line
+typedef struct TokenLine {
+  uint32_t token; ///< Index of the token
+  uint32_t line;  ///< Its line, kept by the following tokens
+} TokenLine;
+
+/// @brief Message of a TOKEN_ERROR token
+typedef struct TokenError {
+  uint32_t token;      ///< Index of the token
+  const char *message; ///< Static message from the scanner
+} TokenError;
+
+typedef struct TokenBuffer {
+  const char *source;   ///< Source the offsets refer to
+  Arena *arena;         ///< Owner of the arrays below, or NULL for the heap
+  size_t count;         ///< Number of tokens, the last one is TOKEN_EOF
+  size_t capacity;      ///< Allocated length of types, offsets, lengths
+  uint8_t *types;       ///< TokenType of each token
+  uint32_t *offsets;    ///< Start of each lexeme in `source`
+  uint32_t *lengths;    ///< Length of each lexeme
+  TokenLine *lines;     ///< Line changes, sorted by token
+  size_t lineCount;     ///< Entries in `lines`
+  size_t lineCapacity;  ///< Allocated length of `lines`
+  TokenError *errors;   ///< Error messages, sorted by token
+  size_t errorCount;    ///< Entries in `errors`
+  size_t errorCapacity; ///< Allocated length of `errors`
+} TokenBuffer;
+
+/**
+ * @brief Sequential reader over a TokenBuffer.
+ *
+ * Reading in order resolves lines in O(1) by walking the line table along
+ * with the tokens.
+ */
+typedef struct TokenCursor {
+  const TokenBuffer *buffer; ///< Tokens being read
+  size_t index;              ///< Next token to return
+  size_t lineRecord;         ///< TokenLine covering `index`
+} TokenCursor;
+
+void initTokenBuffer(TokenBuffer *buffer, Arena *arena);
+void freeTokenBuffer(TokenBuffer *buffer);
+
+/**
+ * @brief Tokenize all of `source` into `buffer`, ending with TOKEN_EOF.
+ *
+ * Scan errors are kept as TOKEN_ERROR tokens, as scanToken() returns them.
+ *
+ * @return false if the source is too large for 32-bit offsets.
+ */
+bool scanAll(const char *source, TokenBuffer *buffer);
+
+/// @brief Rebuild the Token at `index` (random access, O(log lines))
+Token tokenAt(const TokenBuffer *buffer, size_t index);
+
+void initTokenCursor(TokenCursor *cursor, const TokenBuffer *buffer);
+
+/// @brief Return the next token; TOKEN_EOF repeats once the end is reached
+Token nextToken(TokenCursor *cursor);
+
+/// @brief Type of the token `ahead` positions after the next one
+static inline TokenType peekTokenType(const TokenCursor *cursor,
+                                      size_t ahead) {
+  const TokenBuffer *buffer = cursor->buffer;
+  size_t index = cursor->index + ahead;
+  if (index >= buffer->count) {
+    return TOKEN_EOF;
+  }
+  return (TokenType)buffer->types[index];
+}
+
+#endif
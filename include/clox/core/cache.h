@@ -0,0 +1,137 @@
+#ifndef CLOX_CORE_CACHE_H
+#define CLOX_CORE_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "clox/core/chunk.h"
+#include "clox/core/globals.h"
+#include "clox/core/object.h"
+
+/**
+ * @file cache.h
+ * @brief On-disk bytecode cache (`.loxc` files).
+ *
+ * A compiled chunk is stored next to its script (`foo.lox` -> `foo.loxc`).
+ * The file is keyed by a hash of the source and by CLOX_VERSION, so editing
+ * the script or upgrading clox invalidates it.
+ *
+ * Layout (native byte order, every section 8-byte aligned):
+ * - CacheHeader
+ * - code: `codeCount` raw bytes, executed in place from the mapping
+ * - constants: `constantsCount` CacheConstant records
+ * - lines: `linesCount` CacheLine records
+ * - caches: `cachesCount` CacheConstant records, the field name (a string)
+ *   of each inline cache
+ * - globals: `globalsCount` CacheGlobal records
+ * - strings: `stringsCount` bytes, the characters of every string constant
+ *   and name back to back (not NUL-terminated)
+ *
+ * Strings are interned into the loading VM's heap while decoding, so a
+ * cached chunk shares its strings with everything else the VM runs. Global
+ * slots are numbered per VM, so the file also lists the slot the compiler
+ * gave each global name; it is only used by a VM that numbers them the same
+ * way, as a fresh VM running one script does. Inline caches are stored
+ * empty: the shapes they learn only exist in the VM that ran the chunk.
+ */
+
+#define CACHE_MAGIC "LOXC"
+#define CACHE_FORMAT_VERSION 5
+#define CACHE_VERSION_SIZE 16
+#define CACHE_EXTENSION "c" ///< Appended to the script path
+
+/// @brief Fixed-size header at the start of every `.loxc` file
+typedef struct CacheHeader {
+  char magic[4];                    ///< CACHE_MAGIC
+  uint16_t formatVersion;           ///< CACHE_FORMAT_VERSION
+  uint16_t byteOrder;               ///< 0x0102 as written by the producer
+  char version[CACHE_VERSION_SIZE]; ///< CLOX_VERSION, NUL padded
+  uint64_t sourceHash;              ///< hashSource() of the script
+  uint64_t sourceLength;            ///< Script length in bytes
+  uint64_t payloadHash;             ///< FNV-1a of everything after the header
+  uint64_t codeOffset;              ///< File offset of the code section
+  uint64_t codeCount;               ///< Bytes of code
+  uint64_t constantsOffset;         ///< File offset of the constants section
+  uint64_t constantsCount;          ///< Number of CacheConstant records
+  uint64_t linesOffset;             ///< File offset of the line table
+  uint64_t linesCount;              ///< Number of CacheLine records
+  uint64_t cachesOffset;            ///< File offset of the inline caches
+  uint64_t cachesCount;             ///< Number of inline cache records
+  uint64_t globalsOffset;           ///< File offset of the global records
+  uint64_t globalsCount;            ///< Number of CacheGlobal records
+  uint64_t stringsOffset;           ///< File offset of the string bytes
+  uint64_t stringsCount;            ///< Bytes of string characters
+} CacheHeader;
+
+/// @brief Type of a serialized constant, independent of the Value encoding
+typedef enum CacheConstantType {
+  CACHE_NIL,    ///< nil, payload unused
+  CACHE_BOOL,   ///< payload is 0 or 1
+  CACHE_NUMBER, ///< payload holds the bits of a double
+  CACHE_STRING, ///< payload is `length << 32 | start` in the string bytes
+} CacheConstantType;
+
+/// @brief One serialized constant
+typedef struct CacheConstant {
+  uint64_t payload; ///< Value bits, see CacheConstantType
+  uint8_t type;     ///< CacheConstantType
+  uint8_t padding[7];
+} CacheConstant;
+
+/// @brief One serialized ChunkGlobal
+typedef struct CacheGlobal {
+  uint64_t name; ///< CACHE_STRING payload of the global's name
+  uint64_t slot; ///< Slot operand used by the code
+} CacheGlobal;
+
+/// @brief One serialized LineRecord
+typedef struct CacheLine {
+  uint64_t line;  ///< Source line number
+  uint64_t start; ///< Code offset where the run begins
+} CacheLine;
+
+/**
+ * @brief A chunk loaded from a mapped cache file.
+ *
+ * `chunk.code` borrows the mapping (its capacity is 0), so the chunk must be
+ * released with freeCachedChunk(), never freeChunk().
+ */
+typedef struct CachedChunk {
+  Chunk chunk;        ///< Ready to pass to interpretChunk()
+  void *mapping;      ///< Base of the mapped file
+  size_t mappingSize; ///< Size of the mapping in bytes
+} CachedChunk;
+
+uint64_t hashSource(const char *source, size_t length);
+char *cachePathFor(const char *scriptPath);
+
+/**
+ * @brief Map `cachePath` and validate it against `source`.
+ *
+ * Rejects missing, truncated, stale (other source or clox version) and
+ * malformed files: the payload checksum must match, sections must be in
+ * bounds, every opcode known, every constant and name index in range, the
+ * stack must never underflow, the code must end with OP_RETURN, the line
+ * table must be sorted and every string must lie in the string bytes.
+ * Strings are interned into `heap`, and the globals must resolve to the
+ * slots the code uses in `globals` (new names get a slot either way).
+ *
+ * @return true if `out` holds a runnable chunk, false to recompile instead.
+ */
+bool loadCachedChunk(const char *cachePath, const char *source, size_t length,
+                     Heap *heap, Globals *globals, CachedChunk *out);
+void freeCachedChunk(CachedChunk *cached);
+
+/**
+ * @brief Write `chunk` to `cachePath`, keyed by `source`.
+ *
+ * The file is written under a temporary name and renamed into place, so
+ * concurrent clox processes never see a partial cache.
+ *
+ * @return false if the chunk cannot be cached or the file cannot be written.
+ */
+bool saveCachedChunk(const char *cachePath, const Chunk *chunk,
+                     const char *source, size_t length);
+
+#endif
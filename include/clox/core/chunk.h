@@ -5,6 +5,7 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "clox/core/inline_cache.h"
 #include "clox/core/value.h"
 #include "clox/utils/dynarr.h"
 
@@ -16,44 +17,130 @@
  * execute.
  */
 typedef enum OpCode {
-  OP_CONSTANT, ///< Push a constant value onto the stack
-  OP_ADD,      ///< Add the top two stack values (a + b)
-  OP_SUBTRACT, ///< Subtract the top two stack values (a - b)
-  OP_MULTIPLY, ///< Multiply the top two stack values (a * b)
-  OP_DIVIDE,   ///< Divide the top two stack values (a / b)
-  OP_NEGATE,   ///< Negate the top stack value (-a)
-  OP_RETURN    ///< Return from the current function
+  OP_CONSTANT,      ///< Push a constant value onto the stack
+  OP_CONSTANT_LONG, ///< OP_CONSTANT with a 24-bit little-endian operand
+  OP_NIL,           ///< Push nil
+  OP_TRUE,          ///< Push true
+  OP_FALSE,         ///< Push false
+  OP_POP,           ///< Discard the top stack value
+  OP_EQUAL,         ///< Compare the top two stack values (a == b)
+  OP_GREATER,       ///< Compare the top two stack numbers (a > b)
+  OP_LESS,          ///< Compare the top two stack numbers (a < b)
+  OP_ADD,           ///< Add the top two stack values (a + b)
+  OP_SUBTRACT,      ///< Subtract the top two stack values (a - b)
+  OP_MULTIPLY,      ///< Multiply the top two stack values (a * b)
+  OP_DIVIDE,        ///< Divide the top two stack values (a / b)
+  OP_NOT,           ///< Logical not of the top stack value (!a)
+  OP_NEGATE,        ///< Negate the top stack value (-a)
+  OP_PRINT,         ///< Pop and print the top stack value
+  OP_RETURN,        ///< Return from the current function
+  OP_DEFINE_GLOBAL, ///< Pop into a global slot (16-bit little-endian operand)
+  OP_GET_GLOBAL,    ///< Push a defined global slot (16-bit operand)
+  OP_SET_GLOBAL,    ///< Store the top in a defined global slot (16-bit)
+  OP_CALL,          ///< Call the value below argCount arguments (8-bit)
+  OP_CLASS,         ///< Replace the name string on top by a new class
+  OP_GET_PROPERTY,  ///< Replace the instance on top by a field (16-bit cache)
+  OP_SET_PROPERTY,  ///< Store the top in a field of the instance below it
+  OP_INVOKE,        ///< Call a field: operands 16-bit cache, 8-bit argCount
+
+  /// Superinstructions, emitted by fuseInstructions() (see peephole.h)
+  OP_ADD_CONSTANT,      ///< OP_CONSTANT k + OP_ADD: top = top + k
+  OP_SUBTRACT_CONSTANT, ///< OP_CONSTANT k + OP_SUBTRACT: top = top - k
+  OP_MULTIPLY_CONSTANT, ///< OP_CONSTANT k + OP_MULTIPLY: top = top * k
+  OP_DIVIDE_CONSTANT,   ///< OP_CONSTANT k + OP_DIVIDE: top = top / k
+  OP_CONSTANT_CONSTANT, ///< Two OP_CONSTANT loads, two 8-bit operands
 } OpCode;
 
+typedef struct Chunk Chunk;
+
 /**
  * @struct LineRecord
  * @brief A run-length record for source line information.
  *
- * Represents a source code line and how many consecutive instructions were
- * generated from that line.
+ * Represents a source code line and the offset of the first byte of code
+ * generated from it. The run extends up to the next record's `start` (or the
+ * end of the code), so the table stays run-length encoded while `start` is
+ * sorted and can be binary searched.
  */
 typedef struct LineRecord {
   size_t line;  ///< Source code line number
-  size_t count; ///< Number of consecutive instructions from this line
+  size_t start; ///< Code offset where this run of the line begins
 } LineRecord;
 
+DEFINE_DYNARRAY_PUSH(pushValueDynArray, Value)
+DEFINE_DYNARRAY_PUSH(pushLineDynArray, LineRecord)
+
+/**
+ * @struct ChunkGlobal
+ * @brief A global slot used by the chunk's code, with the name it was
+ * resolved from.
+ *
+ * Slot numbers are only meaningful to the VM the chunk was compiled for;
+ * the names let a cached chunk check that a VM numbers them the same way.
+ */
+typedef struct ChunkGlobal {
+  ObjString *name; ///< Interned name of the global
+  uint32_t slot;   ///< Slot operand emitted for `name`
+} ChunkGlobal;
+
+/**
+ * @struct LineIterator
+ * @brief Cursor over a chunk's line table for mostly sequential lookups.
+ *
+ * Moving to an offset in the current or next run is O(1); any other move
+ * falls back to a binary search, so jumping around is still correct.
+ */
+typedef struct LineIterator {
+  const Chunk *chunk; ///< Chunk whose line table is walked
+  size_t record;      ///< Index of the current LineRecord
+} LineIterator;
+
 /**
  * @struct Chunk
  * @brief Represents a contiguous sequence of bytecode instructions.
  *
  * A Chunk is the basic unit of executable code in the VM. It contains the
- * bytecode, constants pool, and line number information for debugging.
+ * bytecode, constants pool, and line number information for debugging, plus
+ * the names of the globals it uses and an inline cache per property access.
+ * Adding a constant, global or cache clears `tenured` and `markedCycle`.
  */
 typedef struct Chunk {
-  DynArray code;      ///< Dynamic array of bytecode instructions (uint8_t)
-  DynArray constants; ///< Constants pool
-  DynArray lines;     ///< Source code line information (LineRecord)
+  DynArray code;        ///< Dynamic array of bytecode instructions (uint8_t)
+  DynArray constants;   ///< Constants pool
+  DynArray lines;       ///< Source code line information (LineRecord)
+  DynArray globals;     ///< Global slots used by the code (ChunkGlobal)
+  DynArray caches;      ///< One per property instruction (InlineCache)
+  bool tenured;         ///< Every object above is old, see gc.h
+  uint32_t markedCycle; ///< Last major collection that visited it, or 0
 } Chunk;
 
 void initChunk(Chunk *chunk);
 void writeChunk(Chunk *chunk, uint8_t byte, size_t line);
 size_t addConstant(Chunk *chunk, Value value);
+/// @brief Record that the code uses global `slot`, once per slot
+void addChunkGlobal(Chunk *chunk, ObjString *name, uint32_t slot);
+static inline const ChunkGlobal *chunkGlobal(const Chunk *chunk,
+                                             size_t index) {
+  return &((const ChunkGlobal *)chunk->globals.data)[index];
+}
+/**
+ * @brief Give a new property instruction its own, empty, cache of `name`.
+ *
+ * @return The index of the cache, the instruction's operand.
+ */
+size_t addInlineCache(Chunk *chunk, ObjString *name);
+static inline InlineCache *chunkCache(const Chunk *chunk, size_t index) {
+  return &((InlineCache *)chunk->caches.data)[index];
+}
+void eraseChunk(Chunk *chunk, size_t start, size_t count);
+void truncateChunk(Chunk *chunk, size_t count);
+/// @brief Release the spare capacity of a finished chunk
+void shrinkChunk(Chunk *chunk);
 void freeChunk(Chunk *chunk);
 size_t getLine(const Chunk *chunk, size_t instructionsIndex);
+size_t instructionLength(uint8_t instruction);
+
+void initLineIterator(LineIterator *iterator, const Chunk *chunk);
+size_t lineIteratorSeek(LineIterator *iterator, size_t instructionsIndex);
 
 #endif
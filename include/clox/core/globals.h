@@ -0,0 +1,54 @@
+#ifndef CLOX_CORE_GLOBALS_H
+#define CLOX_CORE_GLOBALS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "clox/core/table.h"
+#include "clox/core/value.h"
+#include "clox/utils/dynarr.h"
+
+/**
+ * @file globals.h
+ * @brief Global variables, stored in slots numbered at compile time.
+ *
+ * The compiler gives every global name a slot the first time it sees it and
+ * emits the slot number, so reading or writing a global at run time is one
+ * array access, without hashing the name. The slots belong to the VM and
+ * outlive the chunks that use them: a name keeps its slot across REPL lines
+ * and programs compiled for the same VM.
+ *
+ * A slot holds UNDEFINED_VAL until its `var` statement has run, so using a
+ * global before (or without) defining it is still a runtime error.
+ */
+
+/// @brief Slot operands are 16-bit
+#define GLOBALS_MAX (UINT16_MAX + 1)
+
+typedef struct Globals {
+  Table slots;         ///< Slot number (a Lox number) of each name
+  DynArray names;      ///< Name of each slot (ObjString *)
+  DynArray values;     ///< Value of each slot, UNDEFINED_VAL until defined
+  size_t tenuredNames; ///< Leading slots whose names are old, see gc.h
+} Globals;
+
+void initGlobals(Globals *globals);
+void freeGlobals(Globals *globals);
+
+/**
+ * @brief The slot of `name`, added (undefined) the first time.
+ *
+ * @return GLOBALS_MAX if `name` is new and every slot is taken.
+ */
+size_t resolveGlobal(Globals *globals, ObjString *name);
+
+static inline ObjString *globalName(const Globals *globals, size_t slot) {
+  return ((ObjString *const *)globals->names.data)[slot];
+}
+
+/// @note Adding a slot may move the array; index it again afterwards
+static inline Value *globalValues(const Globals *globals) {
+  return (Value *)globals->values.data;
+}
+
+#endif
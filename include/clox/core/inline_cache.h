@@ -0,0 +1,71 @@
+#ifndef CLOX_CORE_INLINE_CACHE_H
+#define CLOX_CORE_INLINE_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "clox/core/object.h"
+
+/**
+ * @file inline_cache.h
+ * @brief Per-site caches of field lookups.
+ *
+ * Every OP_GET_PROPERTY, OP_SET_PROPERTY and OP_INVOKE gets its own
+ * InlineCache in its chunk. The cache remembers, for up to IC_WAYS receiver
+ * shapes, the index of the field in the instance's field array (and, for a
+ * store that adds the field, the shape the instance moves to). A site that
+ * only ever sees one shape is monomorphic and hits on the first compare; a
+ * site that sees a few is polymorphic; past IC_WAYS shapes it is
+ * megamorphic and stops learning, so lookups of new shapes always take the
+ * slow path through the shape tree.
+ *
+ * Each site counts its hits and misses; `clox --ic-stats` prints them.
+ */
+
+/// @brief Shapes remembered by one site
+#define IC_WAYS 4
+/// @brief InlineCache.count of a site that has seen more than IC_WAYS shapes
+#define IC_MEGAMORPHIC (IC_WAYS + 1)
+
+/// @brief What a site learned about one receiver shape
+typedef struct ICEntry {
+  ObjShape *shape; ///< Receiver shape, NULL while the entry is unused
+  ObjShape *next;  ///< Shape after a store; `shape` unless the field is new
+  uint32_t field;  ///< Index of the field in the instance's fields
+} ICEntry;
+
+typedef struct InlineCache {
+  ObjString *name;          ///< Field the site accesses
+  ICEntry entries[IC_WAYS]; ///< Filled in the order shapes are seen
+  uint32_t count;           ///< Entries in use, or IC_MEGAMORPHIC
+  uint64_t hits;            ///< Lookups answered by an entry
+  uint64_t misses;          ///< Lookups that walked the shape tree
+} InlineCache;
+
+void initInlineCache(InlineCache *cache, ObjString *name);
+
+/// @return The entry of `shape`, or NULL after counting a miss.
+static inline const ICEntry *lookupInlineCache(InlineCache *cache,
+                                               const ObjShape *shape) {
+  /// Unused entries have no shape, so no receiver matches them
+  for (size_t i = 0; i < IC_WAYS; ++i) {
+    if (cache->entries[i].shape == shape) {
+      cache->hits++;
+      return &cache->entries[i];
+    }
+  }
+  cache->misses++;
+  return NULL;
+}
+
+/**
+ * @brief Remember a lookup, unless the site is already megamorphic.
+ *
+ * The shapes are passed to markingBarrier(), since a major collection
+ * visits each chunk once.
+ */
+void updateInlineCache(Heap *heap, InlineCache *cache, ObjShape *shape,
+                       ObjShape *next, uint32_t field);
+
+#endif
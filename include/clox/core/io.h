@@ -1,9 +1,37 @@
 #ifndef CLOX_CORE_IO_H
 #define CLOX_CORE_IO_H
 
+#include <stdbool.h>
+#include <stddef.h>
+
 #include "clox/vm/vm.h"
 
 #define INITIAL_LINE_CAPACITY 1024
+#define INITIAL_SOURCE_CAPACITY 65536
+#define STDIN_PATH "-" ///< Script path that reads the program from stdin
+
+/**
+ * @struct Source
+ * @brief A script loaded into memory, followed by a NUL sentinel.
+ *
+ * Regular files are mapped and never copied. Pipes, stdin and files that
+ * cannot be mapped are read into a heap buffer. The scanner only needs a
+ * NUL-terminated view, since tokens point into `text`.
+ */
+typedef struct Source {
+  const char *text;   ///< NUL-terminated source, valid until freeSource()
+  size_t length;      ///< Bytes before the sentinel
+  size_t mappingSize; ///< Size of the mapping, 0 for a heap buffer
+  bool regularFile;   ///< Whether `text` came from a regular file
+} Source;
+
+/**
+ * @brief Load the script at `path`, or stdin when `path` is STDIN_PATH.
+ *
+ * @return false if the file cannot be opened or read.
+ */
+bool loadSource(const char *path, Source *source);
+void freeSource(Source *source);
 
 void runREPL(VM *vm);
 void executeFile(VM *vm, const char *path);
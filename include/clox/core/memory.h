@@ -6,17 +6,128 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-void *reallocate(void *pointer, size_t oldSize, size_t newSize);
+/// @brief Subsystem an allocation is accounted to
+typedef enum MemoryTag {
+  MEM_OTHER,           ///< Not attributed to a subsystem
+  MEM_CHUNK_CODE,      ///< Chunk bytecode
+  MEM_CHUNK_CONSTANTS, ///< Chunk constant pools
+  MEM_CHUNK_LINES,     ///< Chunk line tables
+  MEM_CHUNK_GLOBALS,   ///< Global slots referenced by chunks
+  MEM_CHUNK_CACHES,    ///< Inline caches of property instructions
+  MEM_VM_STACK,        ///< VM operand stacks
+  MEM_GLOBALS,         ///< Global variable slots of a VM
+  MEM_COMPILER,        ///< Compiler scratch data (tokens, arenas)
+  MEM_STRING,          ///< String objects and their characters
+  MEM_OBJECT,          ///< Other heap objects
+  MEM_TABLE,           ///< Hash table entries
+  MEM_PROFILER,        ///< Profiler counters and samples
+  MEM_GC,              ///< Nursery blocks and collector bookkeeping
+  MEM_TAG_COUNT,
+} MemoryTag;
+
+#define MEM_SIZE_BUCKETS 32 ///< Power-of-two buckets of the size histogram
+
+/// @brief Allocation counters of one tag, or of all of them
+typedef struct MemoryTagStats {
+  size_t liveBytes;     ///< Bytes currently allocated
+  size_t peakBytes;     ///< Largest liveBytes seen
+  size_t allocations;   ///< New blocks
+  size_t reallocations; ///< Resizes of existing blocks
+  size_t frees;         ///< Released blocks
+} MemoryTagStats;
+
+/// @brief Kind of garbage collection, see gc.h
+typedef enum GcKind {
+  GC_MINOR, ///< Promote the nursery's survivors
+  GC_MAJOR, ///< Mark and sweep the old generation, a slice at a time
+  GC_KIND_COUNT,
+} GcKind;
+
+/// @brief Buckets of GcKindStats.pauseHistogram, up to about 8.6 seconds
+#define GC_PAUSE_BUCKETS 128
+
+/**
+ * @brief Collections of one kind.
+ *
+ * A minor collection is one pause; a major one is spread over many pauses
+ * (slices). Pause bucket i >= 4 holds the durations whose two bits after the
+ * leading one are i % 4 and whose leading bit is i / 4 + 1, so it is at most
+ * 25% wide; buckets 0 to 3 hold 0 to 3 ns.
+ */
+typedef struct GcKindStats {
+  size_t collections;  ///< Collections completed
+  size_t bytes;        ///< Bytes promoted (minor) or freed (major)
+  size_t pauses;       ///< Times the VM stopped for this kind
+  uint64_t pauseNs;    ///< Time spent in those pauses
+  uint64_t maxPauseNs; ///< Longest single pause
+  size_t pauseHistogram[GC_PAUSE_BUCKETS]; ///< Pause durations, see above
+} GcKindStats;
+
+/**
+ * @struct MemoryStats
+ * @brief Allocations and garbage collections seen by an owner.
+ *
+ * Each thread has one, see getMemoryStats(), that sees everything
+ * reallocate() does on it. A VM's heap has its own for the allocations
+ * made on its behalf, see reallocateOwned().
+ */
+typedef struct MemoryStats {
+  MemoryTagStats total;               ///< Sum over all tags
+  MemoryTagStats tags[MEM_TAG_COUNT]; ///< Indexed by MemoryTag
+  /// Requested sizes of allocations and resizes: bucket i counts sizes in
+  /// [2^i, 2^(i+1)), the last bucket also everything larger
+  size_t sizeHistogram[MEM_SIZE_BUCKETS];
+  GcKindStats gc[GC_KIND_COUNT]; ///< Indexed by GcKind
+} MemoryStats;
+
+/**
+ * @brief Allocate, resize or (with `newSize` 0) free a block, accounting
+ * the change to `tag`.
+ *
+ * `oldSize` must be the size the block was last allocated with, so the live
+ * byte counts stay exact.
+ */
+void *reallocate(void *pointer, size_t oldSize, size_t newSize,
+                 MemoryTag tag);
+
+/// @brief reallocate() that also accounts the change to `owner`
+void *reallocateOwned(MemoryStats *owner, void *pointer, size_t oldSize,
+                      size_t newSize, MemoryTag tag);
+
+/// @brief Totals of the calling thread, over all its owners
+const MemoryStats *getMemoryStats(void);
+
+/// @brief Zero the counters and histogram; peaks restart from the live bytes
+void resetMemoryStats(MemoryStats *stats);
+
+const char *memoryTagName(MemoryTag tag);
+
+/// @brief Account one completed collection of `kind` to `owner` and the
+/// thread, see GcKindStats
+void recordCollection(MemoryStats *owner, GcKind kind, size_t bytes);
+
+/// @brief Account one pause of `owner`'s VM spent collecting for `kind`
+void recordGcPause(MemoryStats *owner, GcKind kind, uint64_t pauseNs);
+
+/**
+ * @brief Pause duration below which `percentile` percent of the pauses of
+ * `stats` fall, to the precision of the histogram (0 without pauses).
+ */
+uint64_t gcPausePercentile(const GcKindStats *stats, double percentile);
+
+/// @brief Print `stats` as a small table
+void printMemoryStats(FILE *out, const MemoryStats *stats);
 
 /** @brief Expand when the capacity is full */
 static inline size_t grow_capacity(size_t old) { return old < 8 ? 8 : old * 2; }
 
-/** @brief Reallocate more memory */
-static inline void *grow_array(void *pointer, size_t oldCount, size_t newCount,
-                               size_t elemSize) {
+/** @brief grow_array() accounted to `owner` too, see reallocateOwned() */
+static inline void *grow_owned_array(MemoryStats *owner, void *pointer,
+                                     size_t oldCount, size_t newCount,
+                                     size_t elemSize, MemoryTag tag) {
   size_t oldSize = oldCount * elemSize;
   size_t newSize = newCount * elemSize;
-  void *result = reallocate(pointer, oldSize, newSize);
+  void *result = reallocateOwned(owner, pointer, oldSize, newSize, tag);
   if (result == NULL) {
     fprintf(stderr, "Memory reallocation failed (old=%zu, new=%zu, elem=%zu)\n",
             oldCount, newCount, elemSize);
@@ -25,11 +136,76 @@ static inline void *grow_array(void *pointer, size_t oldCount, size_t newCount,
   return result;
 }
 
+/** @brief Reallocate more memory */
+static inline void *grow_array(void *pointer, size_t oldCount, size_t newCount,
+                               size_t elemSize, MemoryTag tag) {
+  return grow_owned_array(NULL, pointer, oldCount, newCount, elemSize, tag);
+}
+
+/** @brief free_array() accounted to `owner` too */
+static inline void *free_owned_array(MemoryStats *owner, void *pointer,
+                                     size_t oldCount, size_t elementSize,
+                                     MemoryTag tag) {
+  return reallocateOwned(owner, pointer, oldCount * elementSize, 0, tag);
+}
+
 /** Free array */
 static inline void *free_array(void *pointer, size_t oldCont,
-                               size_t elementSize) {
-  size_t oldSize = oldCont * elementSize;
-  return reallocate(pointer, oldSize, 0);
+                               size_t elementSize, MemoryTag tag) {
+  return free_owned_array(NULL, pointer, oldCont, elementSize, tag);
 }
 
+/// @brief Block size used when initArena() is given 0
+#define ARENA_DEFAULT_BLOCK_SIZE (32u * 1024u)
+
+typedef struct ArenaBlock ArenaBlock;
+
+/// @brief Usage counters of one arena
+typedef struct ArenaStats {
+  size_t bytesUsed;   ///< Bytes handed out since the last reset, with padding
+  size_t bytesHeld;   ///< Bytes of all blocks currently held
+  size_t blocks;      ///< Blocks currently held
+  size_t highWater;   ///< Largest bytesUsed seen over the arena's lifetime
+  size_t allocations; ///< Calls to arenaAlloc() since the last reset
+} ArenaStats;
+
+/**
+ * @struct Arena
+ * @brief Bump allocator for data that dies all at once.
+ *
+ * Allocations are carved out of large blocks and never freed one by one;
+ * freeArena() releases everything in one go and resetArena() keeps a block
+ * around for the next round. Every allocation is aligned for any type.
+ * Requests larger than a quarter of the block size get a block of their own.
+ */
+typedef struct Arena {
+  ArenaBlock *head; ///< Block being bumped into, followed by the full ones
+  void *last;       ///< Most recent allocation, which can grow in place
+  size_t blockSize; ///< Size of a regular block
+  MemoryTag tag;    ///< Tag the blocks are accounted to
+  ArenaStats stats;
+} Arena;
+
+void initArena(Arena *arena, size_t blockSize, MemoryTag tag);
+
+/// @brief Allocate `size` bytes; exits like grow_array() when out of memory
+void *arenaAlloc(Arena *arena, size_t size);
+
+/**
+ * @brief Arena counterpart of grow_array().
+ *
+ * The most recent allocation is extended in place when its block has room;
+ * otherwise the contents move to a new allocation and the old space stays
+ * unused until the arena is reset.
+ */
+void *arenaGrowArray(Arena *arena, void *pointer, size_t oldCount,
+                     size_t newCount, size_t elemSize);
+
+/// @brief Drop all allocations, keeping one regular block for reuse
+void resetArena(Arena *arena);
+void freeArena(Arena *arena);
+
+/// @brief Print `arena`'s statistics as one line prefixed with `name`
+void printArenaStats(FILE *out, const char *name, const Arena *arena);
+
 #endif
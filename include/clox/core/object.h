@@ -0,0 +1,298 @@
+#ifndef CLOX_CORE_OBJECT_H
+#define CLOX_CORE_OBJECT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "clox/clox.h"
+#include "clox/core/memory.h"
+#include "clox/core/table.h"
+#include "clox/core/value.h"
+#include "clox/utils/dynarr.h"
+#include "config.h"
+
+/**
+ * @file object.h
+ * @brief Heap-allocated Lox objects and the heap that owns them.
+ *
+ * Every string is interned: a Heap holds at most one ObjString per sequence
+ * of characters, so string equality is pointer equality and strings can key
+ * tables without comparing characters. The compiler interns literals and
+ * identifiers into the heap of the VM that will run the chunk, so a name in
+ * the source and the same text in a string literal are one object.
+ *
+ * Instances keep their fields in a flat array. Which field lives at which
+ * index is described by the instance's shape (a hidden class): instances
+ * that got the same fields in the same order share one shape, so a cached
+ * (shape, index) pair answers a field access without looking the name up
+ * (see inline_cache.h).
+ *
+ * The heap has two generations. New objects are bump-allocated in the
+ * nursery, a list of fixed-size blocks; the ones that survive a minor
+ * collection are copied (promoted) to the old generation, where every
+ * object is a separate allocation on the `objects` list. Shapes, objects
+ * too large for the nursery, and all objects when `nurserySize` is 0 start
+ * old, so inline caches never point into the nursery.
+ * The heap never collects by itself: allocation only sets
+ * `collectRequested`, and the VM collects at its next safe point (gc.h),
+ * where it knows every root. Code that stores a pointer into an existing
+ * object calls writeBarrier(), so that the old objects pointing into the
+ * nursery are known without scanning the old generation, and so that an
+ * incremental major collection (`phase`) does not miss the stored object.
+ */
+
+typedef enum ObjType {
+  OBJ_STRING,
+  OBJ_NATIVE,
+  OBJ_CLASS,
+  OBJ_INSTANCE,
+  OBJ_SHAPE,
+} ObjType;
+
+/// @name Obj.flags, maintained by the heap and the collector (gc.h)
+/// @{
+#define OBJ_YOUNG 0x1u           ///< Lives in the nursery
+#define OBJ_FORWARDED 0x2u       ///< Promoted; `next` is the old copy
+#define OBJ_REMEMBERED 0x4u      ///< Old and in the remembered set
+#define OBJ_MARKED 0x8u          ///< Marked if equal to Heap.markSense
+#define OBJ_NURSERY_FIELDS 0x10u ///< Young instance, fields in the nursery
+/// @}
+
+struct Obj {
+  ObjType type;
+  uint8_t flags;    ///< OBJ_YOUNG, OBJ_MARKED...
+  struct Obj *next; ///< Next old object, or the copy of a forwarded one
+};
+
+/**
+ * @brief An immutable string, allocated in one block with its characters.
+ *
+ * The hash is computed once when the string is created.
+ */
+struct ObjString {
+  Obj obj;
+  uint32_t hash; ///< hashString() of the characters
+  size_t length; ///< Bytes, without the terminating NUL
+  char chars[];  ///< NUL-terminated
+};
+
+/// @brief A host function registered with cloxDefineNative()
+typedef struct ObjNative {
+  Obj obj;
+  ObjString *name;       ///< Name it was defined as, for error messages
+  CloxNativeFn function; ///< Called by OP_CALL and OP_INVOKE
+  int arity;             ///< Expected argument count, -1 for any
+} ObjNative;
+
+/// @brief Returned by shapeFieldIndex() for a field the shape lacks
+#define SHAPE_NO_FIELD UINT32_MAX
+
+/**
+ * @brief A field layout: the fields an instance has, in the order they were
+ * added.
+ *
+ * Shapes form a tree per class. The root has no fields, and each child adds
+ * one field, `key`, at index `fieldCount - 1`. Adding the same field to
+ * instances of the same shape always leads to the same child, which is
+ * remembered in `transitions`.
+ */
+typedef struct ObjShape {
+  Obj obj;
+  struct ObjShape *parent; ///< Shape without `key`, NULL for a root
+  ObjString *key;          ///< Field added last, NULL for a root
+  uint32_t fieldCount;     ///< Fields of the instances with this shape
+  Table transitions;       ///< Child shape (an object) per added field name
+} ObjShape;
+
+typedef struct ObjClass {
+  Obj obj;
+  ObjString *name;
+  ObjShape *rootShape; ///< Shape of the class's new instances
+} ObjClass;
+
+typedef struct ObjInstance {
+  Obj obj;
+  ObjClass *klass;
+  ObjShape *shape;   ///< Layout of `fields`
+  Value *fields;     ///< shape->fieldCount values
+  uint32_t capacity; ///< Allocated length of `fields`
+} ObjInstance;
+
+/// @brief Default Heap.nurserySize (`nursery_size` option, in KiB)
+#define NURSERY_SIZE ((size_t)CLOX_NURSERY_SIZE * 1024u)
+
+/// @brief Old-generation bytes below which no major collection starts
+#define HEAP_MIN_OLD_BYTES ((size_t)1024u * 1024u)
+
+/// @brief Default Heap.sliceBudget (`gc_slice_budget` option)
+#define GC_SLICE_BUDGET ((size_t)CLOX_GC_SLICE_BUDGET)
+
+typedef struct NurseryBlock NurseryBlock;
+
+/// @brief Progress of a heap's major collection, see gc.h
+typedef enum GcPhase {
+  GC_IDLE,     ///< None running
+  GC_MARKING,  ///< Tracing the gray objects, a slice at a time
+  GC_SWEEPING, ///< Freeing the unmarked objects of `sweeping`
+} GcPhase;
+
+/**
+ * @brief Owner of a set of objects.
+ *
+ * Objects live until a collection finds them unreachable, or until the
+ * heap is freed. `stats` counts the heap's objects, strings and nursery
+ * blocks, its collections, and whatever else its VM accounts there.
+ */
+typedef struct Heap {
+  Obj *objects;          ///< Old generation, newest first
+  Table strings;         ///< Interned strings, used as a set (nil values)
+  NurseryBlock *nursery; ///< Block being filled, followed by full ones
+  uint8_t *nurseryTop;   ///< Next free byte of the current block
+  uint8_t *nurseryEnd;   ///< End of the current block
+  size_t nurserySize;    ///< Bytes per block; 0 allocates everything old
+  DynArray youngStrings; ///< Interned strings in the nursery (ObjString *)
+  DynArray youngOwners;  ///< Young objects owning an allocation (Obj *)
+  DynArray remembered;   ///< Old objects that may point into the nursery
+  DynArray survivors;    ///< Worklist of minor collections (Obj *)
+  DynArray gray;         ///< Marked objects whose children are not (Obj *)
+  Obj *sweeping;         ///< Old objects the running sweep has yet to visit
+  size_t oldBytes;       ///< Bytes of the old generation's objects
+  size_t nextMajor;      ///< `oldBytes` that asks for a major collection
+  size_t sliceBudget;    ///< Work per major collection slice
+  size_t freedBytes;     ///< Bytes freed by the running major collection
+  GcPhase phase;         ///< Progress of the major collection
+  uint32_t cycle;        ///< Major collections started
+  uint8_t markSense;     ///< OBJ_MARKED bit of marked objects, flips
+  bool nurseryFull;      ///< A minor collection is due
+  bool collectRequested; ///< A collection is due or one is running
+  MemoryStats stats;     ///< Allocations and collections of this heap
+} Heap;
+
+#define OBJ_TYPE(value) (AS_OBJ(value)->type)
+#define IS_STRING(value) isObjType(value, OBJ_STRING)
+#define AS_STRING(value) ((ObjString *)AS_OBJ(value))
+#define AS_CSTRING(value) (AS_STRING(value)->chars)
+#define IS_NATIVE(value) isObjType(value, OBJ_NATIVE)
+#define AS_NATIVE(value) ((ObjNative *)AS_OBJ(value))
+#define IS_CLASS(value) isObjType(value, OBJ_CLASS)
+#define AS_CLASS(value) ((ObjClass *)AS_OBJ(value))
+#define IS_INSTANCE(value) isObjType(value, OBJ_INSTANCE)
+#define AS_INSTANCE(value) ((ObjInstance *)AS_OBJ(value))
+
+DEFINE_DYNARRAY_PUSH(pushObjectDynArray, Obj *)
+
+static inline bool isObjType(Value value, ObjType type) {
+  return IS_OBJ(value) && AS_OBJ(value)->type == type;
+}
+
+void initHeap(Heap *heap);
+/// @brief Free every object of the heap
+void freeHeap(Heap *heap);
+
+/// @brief Bytes of `object` itself, without arrays it points to
+size_t objectSize(const Obj *object);
+
+/**
+ * @brief Release `object`: the arrays it owns and, if it is old, its own
+ * memory. A young object's memory goes away with its nursery block.
+ */
+void freeObject(Heap *heap, Obj *object);
+
+/**
+ * @brief Copy young `object` to the old generation, leaving the copy's
+ * address in its `next` (see OBJ_FORWARDED). The copy is marked, and
+ * shaded while marking, like every new old object.
+ *
+ * @return The copy.
+ */
+Obj *promoteObject(Heap *heap, Obj *object);
+
+/// @brief Add old `object` to the remembered set, see writeBarrier()
+void rememberObject(Heap *heap, Obj *object);
+
+/// @brief Whether the running major collection has reached old `object`
+static inline bool isMarked(const Heap *heap, const Obj *object) {
+  return (object->flags & OBJ_MARKED) == heap->markSense;
+}
+
+/**
+ * @brief Mark old `object` and, unless it is a string, queue it on `gray`
+ * for its children to be marked.
+ */
+void shadeObject(Heap *heap, Obj *object);
+
+/**
+ * @brief Record that `object` now points to `target`.
+ *
+ * Must follow every store of an object pointer into an existing object;
+ * stores into objects just allocated, globals and the stack need none,
+ * since the collector scans those as roots. While marking, an old target
+ * is shaded, so that no marked object ever points to an unmarked one.
+ */
+static inline void writeBarrier(Heap *heap, Obj *object, Obj *target) {
+  if ((target->flags & OBJ_YOUNG) != 0) {
+    if ((object->flags & (OBJ_YOUNG | OBJ_REMEMBERED)) == 0) {
+      rememberObject(heap, object);
+    }
+  } else if (heap->phase == GC_MARKING && !isMarked(heap, target)) {
+    shadeObject(heap, target);
+  }
+}
+
+/**
+ * @brief Shade `target`, stored outside the heap where the running marking
+ * does not look again (the inline caches of a chunk it visited).
+ */
+static inline void markingBarrier(Heap *heap, Obj *target) {
+  if (heap->phase == GC_MARKING && (target->flags & OBJ_YOUNG) == 0 &&
+      !isMarked(heap, target)) {
+    shadeObject(heap, target);
+  }
+}
+
+/// @brief writeBarrier() for a stored Value
+static inline void writeBarrierValue(Heap *heap, Obj *object, Value value) {
+  if (IS_OBJ(value)) {
+    writeBarrier(heap, object, AS_OBJ(value));
+  }
+}
+
+/**
+ * @brief Empty the nursery, keeping one block, and free what the objects
+ * in it that were not promoted own.
+ */
+void resetNursery(Heap *heap);
+
+/// @brief 32-bit FNV-1a
+uint32_t hashString(const char *chars, size_t length);
+
+/// @brief The interned string holding `chars`, created if needed
+ObjString *copyString(Heap *heap, const char *chars, size_t length);
+
+/// @brief The interned string `a` followed by `b`
+ObjString *concatenateStrings(Heap *heap, const ObjString *a,
+                              const ObjString *b);
+
+ObjNative *newNative(Heap *heap, ObjString *name, CloxNativeFn function,
+                     int arity);
+ObjClass *newClass(Heap *heap, ObjString *name);
+/// @brief An instance of `klass` without fields
+ObjInstance *newInstance(Heap *heap, ObjClass *klass);
+
+/// @return The index of field `name` in instances of `shape`, or
+/// SHAPE_NO_FIELD.
+uint32_t shapeFieldIndex(const ObjShape *shape, const ObjString *name);
+
+/// @brief The shape reached from `shape` by adding field `name`
+ObjShape *shapeTransition(Heap *heap, ObjShape *shape, ObjString *name);
+
+/**
+ * @brief Move `instance` to `shape`, a descendant of its shape, growing
+ * its field array; new fields are nil.
+ */
+void setInstanceShape(Heap *heap, ObjInstance *instance, ObjShape *shape);
+
+void printObject(Value value);
+
+#endif
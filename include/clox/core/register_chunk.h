@@ -0,0 +1,91 @@
+#ifndef CLOX_CORE_REGISTER_CHUNK_H
+#define CLOX_CORE_REGISTER_CHUNK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "clox/core/chunk.h"
+#include "clox/utils/dynarr.h"
+
+/**
+ * @file register_chunk.h
+ * @brief Bytecode of the experimental register VM.
+ *
+ * Instructions are 64-bit words holding an opcode and three 18-bit slot
+ * operands: `A` is the destination, `B` and `C` the sources. Slots index one
+ * register window per run; its first slots are preloaded with the chunk's
+ * constants and the rest are temporaries, so constants need no load
+ * instruction and every operand is decoded the same way. The global
+ * instructions are the exception: one of their operands is a global slot
+ * (globals.h) rather than a register.
+ */
+
+/// @brief Register VM operation codes
+typedef enum RegOpCode {
+  REG_ADD,            ///< A = B + C, numbers or strings
+  REG_SUBTRACT,       ///< A = B - C
+  REG_MULTIPLY,       ///< A = B * C
+  REG_DIVIDE,         ///< A = B / C
+  REG_EQUAL,          ///< A = B == C
+  REG_GREATER,        ///< A = B > C
+  REG_LESS,           ///< A = B < C
+  REG_NOT_EQUAL,      ///< A = !(B == C)
+  REG_NOT_GREATER,    ///< A = !(B > C), i.e. `<=`
+  REG_NOT_LESS,       ///< A = !(B < C), i.e. `>=`
+  REG_NOT,            ///< A = !B
+  REG_NEGATE,         ///< A = -B
+  REG_GET_GLOBAL,     ///< A = global slot B, which must be defined
+  REG_SET_GLOBAL,     ///< Global slot A = B, which must be defined
+  REG_DEFINE_GLOBAL,  ///< Global slot A = B
+  REG_PRINT,          ///< Print A
+  REG_RETURN,         ///< Leave the script
+  REG_OP_COUNT,
+} RegOpCode;
+
+typedef uint64_t RegInstruction;
+
+#define REG_OPERAND_BITS 18
+#define REG_SLOT_MAX ((1u << REG_OPERAND_BITS) - 1) ///< Largest slot index
+
+static inline RegInstruction makeRegInstruction(RegOpCode op, uint32_t a,
+                                                uint32_t b, uint32_t c) {
+  return (RegInstruction)op | ((RegInstruction)a << 8) |
+         ((RegInstruction)b << (8 + REG_OPERAND_BITS)) |
+         ((RegInstruction)c << (8 + 2 * REG_OPERAND_BITS));
+}
+
+static inline uint8_t regOp(RegInstruction instruction) {
+  return (uint8_t)(instruction & 0xff);
+}
+
+static inline uint32_t regA(RegInstruction instruction) {
+  return (uint32_t)(instruction >> 8) & REG_SLOT_MAX;
+}
+
+static inline uint32_t regB(RegInstruction instruction) {
+  return (uint32_t)(instruction >> (8 + REG_OPERAND_BITS)) & REG_SLOT_MAX;
+}
+
+static inline uint32_t regC(RegInstruction instruction) {
+  return (uint32_t)(instruction >> (8 + 2 * REG_OPERAND_BITS)) & REG_SLOT_MAX;
+}
+
+/**
+ * @struct RegChunk
+ * @brief A script translated for the register VM.
+ */
+typedef struct RegChunk {
+  DynArray code;      ///< RegInstruction words
+  DynArray constants; ///< Values preloaded into slots 0..count-1
+  DynArray lines;     ///< LineRecord runs; `start` counts instructions
+  size_t slotCount;   ///< Size of the register window (constants included)
+} RegChunk;
+
+void initRegChunk(RegChunk *chunk);
+void writeRegChunk(RegChunk *chunk, RegInstruction instruction, size_t line);
+void freeRegChunk(RegChunk *chunk);
+
+/// @brief Source line of instruction `index`, O(log n)
+size_t getRegLine(const RegChunk *chunk, size_t index);
+
+#endif
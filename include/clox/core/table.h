@@ -0,0 +1,77 @@
+#ifndef CLOX_CORE_TABLE_H
+#define CLOX_CORE_TABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "clox/core/value.h"
+
+/**
+ * @file table.h
+ * @brief Hash table keyed by interned strings.
+ *
+ * Open addressing with linear probing over a power-of-two array of entries,
+ * so the probe start is `hash & (capacity - 1)` and a lookup usually touches
+ * a single cache line. Keys are interned (see object.h): two keys are equal
+ * exactly when they are the same pointer, so probing never compares
+ * characters. Only tableFindString(), which does the interning, looks at
+ * the characters, and only of entries with the same hash.
+ *
+ * Deleting leaves a tombstone (no key, value `true`) so that probe sequences
+ * running through the slot stay intact; insertions reuse the first tombstone
+ * they pass. Tombstones count towards the load. Once more than
+ * TABLE_MAX_LOAD of the slots are used the table is rehashed without them,
+ * into twice the slots unless most of the load was tombstones.
+ */
+
+/// @brief Fraction of used slots (entries and tombstones) before growing
+#define TABLE_MAX_LOAD 0.75
+
+/// @brief One slot: an empty slot has no key and a nil value
+typedef struct Entry {
+  ObjString *key; ///< NULL for an empty slot or a tombstone
+  Value value;
+} Entry;
+
+typedef struct Table {
+  size_t count;    ///< Entries plus tombstones
+  size_t capacity; ///< Number of slots, a power of two (or 0)
+  Entry *entries;
+} Table;
+
+void initTable(Table *table);
+void freeTable(Table *table);
+
+/// @return true and the value in `value` if `key` is present.
+bool tableGet(const Table *table, const ObjString *key, Value *value);
+
+/// @return true if `key` was not in the table yet.
+bool tableSet(Table *table, ObjString *key, Value value);
+
+/// @return true if `key` was present and is now a tombstone.
+bool tableDelete(Table *table, const ObjString *key);
+
+/**
+ * @brief Make the entry of `key` use `replacement` as its key.
+ *
+ * `replacement` must hash like `key`, e.g. be its copy made by the
+ * collector, so the entry stays where probes look for it.
+ *
+ * @return false if `key` is not in the table.
+ */
+bool tableReplaceKey(Table *table, const ObjString *key,
+                     ObjString *replacement);
+
+/// @brief Copy every entry of `from` into `to`
+void tableAddAll(const Table *from, Table *to);
+
+/**
+ * @brief Find a key by its characters, for interning.
+ *
+ * @return The key equal to `chars`, or NULL if there is none.
+ */
+ObjString *tableFindString(const Table *table, const char *chars,
+                           size_t length, uint32_t hash);
+
+#endif
@@ -1,12 +1,140 @@
 #ifndef CLOX_CORE_VALUE_H
 #define CLOX_CORE_VALUE_H
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 
-/** @brief This typedef abstracts how Lox values are concretely represented in C
+#include "config.h"
+
+/// @brief Header shared by every heap-allocated Lox object
+typedef struct Obj Obj;
+/// @brief An interned string object (see object.h)
+typedef struct ObjString ObjString;
+
+/**
+ * @file value.h
+ * @brief Representation of Lox values.
+ *
+ * Two encodings are available, selected by the `nan_boxing` meson option
+ * (CLOX_NAN_BOXING). Both expose the same macro API:
+ * - `IS_BOOL/IS_NIL/IS_NUMBER/IS_OBJ(value)` test the type,
+ * - `AS_BOOL/AS_NUMBER/AS_OBJ(value)` unwrap the payload,
+ * - `BOOL_VAL/NIL_VAL/NUMBER_VAL/OBJ_VAL(x)` wrap a C value.
+ *
+ * `UNDEFINED_VAL` marks a global slot that has not been defined yet (see
+ * globals.h). It is never stored anywhere else, so scripts never see it.
+ *
+ * Code outside this header must only use these macros, never the layout.
+ */
+
+#ifdef CLOX_NAN_BOXING
+
+/**
+ * @brief A Lox value packed into the bits of a double (NaN boxing).
+ *
+ * Numbers are stored as plain IEEE 754 doubles. Every other value lives in
+ * the payload of a quiet NaN that real arithmetic never produces:
+ * - nil/false/true: QNAN with a small tag in the lowest bits,
+ * - objects: QNAN plus the sign bit, with the pointer in the low 48 bits.
+ *
+ * @note This relies on user-space pointers fitting in 48 bits, which holds on
+ * - x86-64 and AArch64.
+ */
+typedef uint64_t Value;
+
+#define SIGN_BIT ((uint64_t)0x8000000000000000)
+#define QNAN ((uint64_t)0x7ffc000000000000)
+
+#define TAG_NIL 1       ///< 001
+#define TAG_FALSE 2     ///< 010
+#define TAG_TRUE 3      ///< 011
+#define TAG_UNDEFINED 4 ///< 100
+
+/// @brief Reinterpret the bits of a Value as a double
+static inline double valueToNum(Value value) {
+  double number;
+  memcpy(&number, &value, sizeof(Value));
+  return number;
+}
+
+/// @brief Reinterpret the bits of a double as a Value
+static inline Value numToValue(double number) {
+  Value value;
+  memcpy(&value, &number, sizeof(double));
+  return value;
+}
+
+#define FALSE_VAL ((Value)(QNAN | TAG_FALSE))
+#define TRUE_VAL ((Value)(QNAN | TAG_TRUE))
+#define NIL_VAL ((Value)(QNAN | TAG_NIL))
+#define UNDEFINED_VAL ((Value)(QNAN | TAG_UNDEFINED))
+#define BOOL_VAL(b) ((b) ? TRUE_VAL : FALSE_VAL)
+#define NUMBER_VAL(num) numToValue(num)
+#define OBJ_VAL(obj) (Value)(SIGN_BIT | QNAN | (uint64_t)(uintptr_t)(obj))
+
+/// false and true only differ in the lowest bit
+#define IS_BOOL(value) (((value) | 1) == TRUE_VAL)
+#define IS_NIL(value) ((value) == NIL_VAL)
+#define IS_UNDEFINED(value) ((value) == UNDEFINED_VAL)
+#define IS_NUMBER(value) (((value) & QNAN) != QNAN)
+#define IS_OBJ(value) (((value) & (QNAN | SIGN_BIT)) == (QNAN | SIGN_BIT))
+
+#define AS_BOOL(value) ((value) == TRUE_VAL)
+#define AS_NUMBER(value) valueToNum(value)
+#define AS_OBJ(value) ((Obj *)(uintptr_t)((value) & ~(SIGN_BIT | QNAN)))
+
+#else
+
+/// @brief Type tag of a tagged-union Value
+typedef enum ValueType {
+  VAL_BOOL,      ///< true / false
+  VAL_NIL,       ///< nil
+  VAL_NUMBER,    ///< double precision number
+  VAL_OBJ,       ///< pointer to a heap object
+  VAL_UNDEFINED, ///< an empty global slot
+} ValueType;
+
+/**
+ * @brief A Lox value as a tagged union (debug representation).
+ *
+ * Twice the size of the NaN-boxed encoding, but easy to inspect in a
+ * debugger.
  */
-typedef double Value;
+typedef struct Value {
+  ValueType type; ///< Which member of `as` is valid
+  union {
+    bool boolean;
+    double number;
+    Obj *obj;
+  } as; ///< Payload
+} Value;
+
+#define IS_BOOL(value) ((value).type == VAL_BOOL)
+#define IS_NIL(value) ((value).type == VAL_NIL)
+#define IS_UNDEFINED(value) ((value).type == VAL_UNDEFINED)
+#define IS_NUMBER(value) ((value).type == VAL_NUMBER)
+#define IS_OBJ(value) ((value).type == VAL_OBJ)
+
+#define AS_BOOL(value) ((value).as.boolean)
+#define AS_NUMBER(value) ((value).as.number)
+#define AS_OBJ(value) ((value).as.obj)
+
+#define BOOL_VAL(value) ((Value){VAL_BOOL, {.boolean = (value)}})
+#define NIL_VAL ((Value){VAL_NIL, {.number = 0}})
+#define UNDEFINED_VAL ((Value){VAL_UNDEFINED, {.number = 0}})
+#define NUMBER_VAL(value) ((Value){VAL_NUMBER, {.number = (value)}})
+#define OBJ_VAL(object) ((Value){VAL_OBJ, {.obj = (Obj *)(object)}})
+
+#endif
+
+/// @brief Lox truthiness: nil and false are falsey, everything else is truthy
+static inline bool isFalsey(Value value) {
+  return IS_NIL(value) || (IS_BOOL(value) && !AS_BOOL(value));
+}
 
+bool valuesEqual(Value a, Value b);
 void printValue(Value value);
 
 #endif
@@ -2,10 +2,44 @@
 #define CLOX_UTILS_DEBUG_H
 
 #include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 
 #include "clox/core/chunk.h"
+#include "clox/core/register_chunk.h"
+#include "clox/core/value.h"
+
+/// @brief Mnemonic of an opcode, or NULL for an unknown byte
+const char *opcodeName(uint8_t instruction);
 
 size_t disassembleInstruction(Chunk *chunk, size_t offset);
+size_t disassembleInstructionAt(Chunk *chunk, size_t offset,
+                                LineIterator *lines);
 void disassembleChunk(Chunk *chunk, const char *name);
 
+/**
+ * @brief Print the state and hit/miss counts of every inline cache of
+ * `chunk`, one line per property instruction (`--ic-stats`).
+ */
+void printInlineCaches(FILE *out, const Chunk *chunk);
+
+/**
+ * @brief Report how the register backend runs a chunk
+ * (`--register-stats`).
+ *
+ * @param chunk Its register code, or NULL if it could not be translated and
+ *              runs on the stack VM.
+ */
+void printRegisterStats(FILE *out, const RegChunk *chunk);
+
+/**
+ * @brief Print register instruction `index`.
+ *
+ * @param slots The register window, to show operand values while tracing,
+ *              or NULL to show only constants.
+ */
+void disassembleRegInstruction(const RegChunk *chunk, size_t index,
+                               const Value *slots);
+void disassembleRegChunk(const RegChunk *chunk, const char *name);
+
 #endif
@@ -2,16 +2,49 @@
 #define CLOX_UTILS_DYNARR_H
 
 #include <stddef.h>
+#include <stdint.h>
+
+#include "clox/core/memory.h"
 
 typedef struct DynArray {
   size_t count;    ///< Current number of values in the dynamic array
   size_t capacity; ///< Allocated capacity
   size_t elemSize; ///< Dynamic array data type
+  MemoryTag tag;   ///< Subsystem the data is accounted to
   void *data;      ///< Dynamic array data
 } DynArray;
 
-void initDynArray(DynArray *array, size_t elemSize);
-void pushDynArray(DynArray *array, void *element);
+void initDynArray(DynArray *array, size_t elemSize, MemoryTag tag);
+void pushDynArray(DynArray *array, const void *element);
 void freeDynArray(DynArray *array);
 
+/// @brief Make room for at least `capacity` elements
+void reserveDynArray(DynArray *array, size_t capacity);
+
+/// @brief Append `count` elements with one capacity check and one copy
+void pushManyDynArray(DynArray *array, const void *elements, size_t count);
+
+/// @brief Release unused capacity once an array stops growing
+void shrinkToFitDynArray(DynArray *array);
+
+/// @brief Slow path of the pushes below: double the capacity
+void growDynArray(DynArray *array);
+
+/**
+ * @brief Define `static inline void name(DynArray *array, type value)`.
+ *
+ * The generated push stores `value` with a typed assignment instead of the
+ * memcpy() of pushDynArray(), and only calls out to grow. The array's
+ * `elemSize` must be `sizeof(type)`.
+ */
+#define DEFINE_DYNARRAY_PUSH(name, type)                                       \
+  static inline void name(DynArray *array, type value) {                       \
+    if (array->count == array->capacity) {                                     \
+      growDynArray(array);                                                     \
+    }                                                                          \
+    ((type *)array->data)[array->count++] = value;                             \
+  }
+
+DEFINE_DYNARRAY_PUSH(pushByteDynArray, uint8_t)
+
 #endif
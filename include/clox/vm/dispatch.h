@@ -2,33 +2,136 @@
 #define CLOX_VM_DISPATCH_H
 
 #include "clox/core/chunk.h"
+#include "clox/vm/profiler.h"
 #include "clox/vm/vm.h"
+#include "config.h"
 
-/// @brief Function Pointers of binary operators
-/// @note [WARN|TODO] : In future, Value and Value can use binary arithmetic too
-typedef void (*BinaryOpFunc)(VM *, double, double);
-
-static inline void addImpl(VM *vm, double a, double b) { push(vm, a + b); }
-static inline void subtractImpl(VM *vm, double a, double b) { push(vm, a - b); }
-static inline void multiplyImpl(VM *vm, double a, double b) { push(vm, a * b); }
-static inline void divideImpl(VM *vm, double a, double b) { push(vm, a / b); }
-
-static const BinaryOpFunc binaryOps[5] = {
-    [OP_ADD] = addImpl,
-    [OP_SUBTRACT] = subtractImpl,
-    [OP_MULTIPLY] = multiplyImpl,
-    [OP_DIVIDE] = divideImpl,
-};
-
-static inline void binaryOp(VM *vm, OpCode op) {
-  if (op < OP_ADD || op > OP_DIVIDE || !binaryOps[op]) {
-    /// [WARN|TODO]
-    return;
-  }
-
-  double b = pop(vm);
-  double a = pop(vm);
-  binaryOps[op](vm, a, b);
-}
+/**
+ * @file dispatch.h
+ * @brief Instruction dispatch macros used by executeBytecode().
+ *
+ * Two strategies are available:
+ * - threaded: every handler ends with an indirect `goto` through a label
+ *   table, so each opcode gets its own branch site (GNU computed goto).
+ * - switch: a portable `for (;;) switch` loop.
+ *
+ * The strategy is chosen by the `dispatch` meson option (CLOX_COMPUTED_GOTO).
+ * A translation unit can define CLOX_FORCE_SWITCH_DISPATCH before including
+ * this header to get the switch loop regardless of the configured default
+ * (the dispatch benchmark uses this to compare both modes).
+ *
+ * Handlers are written as:
+ * @code
+ * VM_LOOP() {
+ *   VM_CASE(OP_NEGATE) {
+ *     ...
+ *     VM_NEXT();
+ *   }
+ *   VM_DEFAULT() { ... }
+ * }
+ * @endcode
+ * Handlers must leave through VM_NEXT() or `return`, never `break`.
+ *
+ * With a profiler attached (see profiler.h), every instruction first goes
+ * through profileInstruction(). Threaded dispatch does this by jumping
+ * through `profileTable`, whose entries all lead to VM_PROFILE_HOOK(), so
+ * the loop without a profiler is unchanged; the switch loop tests for the
+ * profiler after each fetch.
+ */
+
+#if defined(CLOX_COMPUTED_GOTO) && !defined(CLOX_FORCE_SWITCH_DISPATCH)
+#define CLOX_THREADED_DISPATCH 1
+#endif
+
+#ifdef DEBUG_TRACE_EXECUTION
+#define VM_TRACE() traceExecution(vm)
+#else
+#define VM_TRACE() ((void)0)
+#endif
+
+/// @brief Report the instruction just fetched to the profiler
+#define VM_PROFILE() profileInstruction(profiler, vm->ip - 1)
+
+#ifdef CLOX_THREADED_DISPATCH
+
+/// @note Labels live in their own namespace, so `OP_ADD:` does not clash with
+/// - the enumerator of the same name.
+#define VM_LOOP() VM_NEXT();
+#define VM_CASE(opcode) opcode:
+#define VM_DEFAULT() op_unknown:
+#define VM_NEXT()                                                              \
+  do {                                                                         \
+    VM_TRACE();                                                                \
+    instruction = readInstruction(vm);                                         \
+    goto *dispatch[instruction];                                               \
+  } while (0)
+/// @brief Target of every `profileTable` entry, placed among the handlers
+#define VM_PROFILE_HOOK()                                                      \
+  op_profile:                                                                  \
+  VM_PROFILE();                                                                \
+  goto *dispatchTable[instruction];
+
+#else
+
+#define VM_LOOP()                                                              \
+  for (;;)                                                                     \
+    switch (VM_TRACE(), instruction = readInstruction(vm),                     \
+            profiler != NULL ? VM_PROFILE() : (void)0, instruction)
+#define VM_CASE(opcode) case opcode:
+#define VM_DEFAULT() default:
+#define VM_NEXT() continue
+#define VM_PROFILE_HOOK()
+
+#endif
+
+/// @brief Runtime error of the arithmetic and comparison instructions
+#define NUMBER_OPERANDS_ERROR "Operands must be numbers."
+/// @brief Runtime error of `+`, which also concatenates strings
+#define ADD_OPERANDS_ERROR "Operands must be two numbers or two strings."
+
+/// @brief Raise "Stack overflow." unless `slots` more values fit on the stack
+#define VM_RESERVE_STACK(slots)                                                \
+  do {                                                                         \
+    if (!stackHasRoom(vm, (slots))) {                                          \
+      runtimeError(vm, "Stack overflow.");                                     \
+      return INTERPRET_RUNTIME_ERROR;                                          \
+    }                                                                          \
+  } while (0)
+
+/**
+ * @brief Pop two numbers and push `valueType(a op b)`, inlined into each
+ * handler.
+ *
+ * Raises NUMBER_OPERANDS_ERROR if either operand is not a number.
+ * Must be used inside executeBytecode().
+ */
+#define VM_BINARY_OP(valueType, op)                                            \
+  do {                                                                         \
+    if (!IS_NUMBER(peek(vm, 0)) || !IS_NUMBER(peek(vm, 1))) {                  \
+      runtimeError(vm, NUMBER_OPERANDS_ERROR);                                 \
+      return INTERPRET_RUNTIME_ERROR;                                          \
+    }                                                                          \
+    double b = AS_NUMBER(pop(vm));                                             \
+    double a = AS_NUMBER(pop(vm));                                             \
+    push(vm, valueType(a op b));                                               \
+  } while (0)
+
+/**
+ * @brief VM_BINARY_OP() with the right operand read from the constant pool,
+ * for the OP_*_CONSTANT superinstructions. The result replaces the top.
+ *
+ * @param message Error raised if an operand is not a number, so that fused
+ *                and unfused code report the same error.
+ */
+#define VM_CONSTANT_OP(valueType, op, message)                                 \
+  do {                                                                         \
+    Value constant = readConstant(vm);                                         \
+    if (!IS_NUMBER(peek(vm, 0)) || !IS_NUMBER(constant)) {                     \
+      runtimeError(vm, message);                                               \
+      return INTERPRET_RUNTIME_ERROR;                                          \
+    }                                                                          \
+    vm->stackTop[-1] =                                                         \
+        valueType(AS_NUMBER(vm->stackTop[-1]) op AS_NUMBER(constant));         \
+  } while (0)
 
 #endif
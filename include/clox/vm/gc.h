@@ -0,0 +1,75 @@
+#ifndef CLOX_VM_GC_H
+#define CLOX_VM_GC_H
+
+#include <stdbool.h>
+
+#include "clox/vm/vm.h"
+#include "config.h"
+
+/**
+ * @file gc.h
+ * @brief Generational garbage collector of a VM's heap (see object.h).
+ *
+ * A minor collection empties the nursery. Every young object reachable from
+ * the roots or from the remembered set is copied to the old generation,
+ * leaving a forwarding pointer behind so that later references to it are
+ * redirected to the copy; the copies are then scanned in turn, Cheney
+ * style. The work is proportional to the survivors and the roots, not to
+ * the garbage, which is dropped with its nursery block (only dead objects
+ * owning arrays are visited, to free them).
+ *
+ * A major collection marks the old generation from the roots and sweeps it,
+ * incrementally: each safe point while one runs does a slice of about
+ * Heap.sliceBudget work (the `gc_slice_budget` option), so its pauses do
+ * not grow with the heap. It is a tri-color marking: marked objects on
+ * Heap.gray are gray, other marked ones black, unmarked ones white. Between
+ * slices the VM keeps running; writeBarrier() shades the old objects it
+ * stores into objects, new old objects (including promoted ones) start
+ * gray, and the roots are visited again before the marking ends, so no
+ * black object is left pointing to a white one. The sweep then frees the
+ * white objects a slice at a time. A major collection starts once the old
+ * generation holds GC_HEAP_GROW_FACTOR times what the previous one left
+ * alive.
+ *
+ * The roots are the VM stack, the global slots (names and values), the
+ * register window and constants of running register code, and the
+ * constants, global names and inline caches of the chunk being run and of
+ * the chunks registered with registerChunk(). The string intern table
+ * is weak: a string only it refers to is removed from it when swept.
+ *
+ * Collections only happen at safe points of the VM (gcSafePoint()), right
+ * after instructions that allocate, when every live value is on the stack,
+ * in the register window or in a global. Allocation itself never collects,
+ * so the compiler and natives can keep objects in C variables; an object
+ * given to a native stays valid until the native returns. Root visits and
+ * minor collections are not sliced, so the pauses still grow with the roots
+ * and survivors.
+ */
+
+/// @brief Old-generation growth, over what the last major collection left
+/// alive, that triggers the next one
+#define GC_HEAP_GROW_FACTOR 2
+
+/**
+ * @brief Promote the nursery if it is full, then run a slice of the major
+ * collection if one is running or the old generation is full.
+ *
+ * @param force Promote the nursery and start a major collection anyway.
+ */
+void collectGarbage(VM *vm, bool force);
+
+/**
+ * @brief Collect if an allocation or a running major collection asked for
+ * it (always, with the `debug_stress_gc` option).
+ */
+static inline void gcSafePoint(VM *vm) {
+#ifdef DEBUG_STRESS_GC
+  collectGarbage(vm, true);
+#else
+  if (vm->heap.collectRequested) {
+    collectGarbage(vm, false);
+  }
+#endif
+}
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef CLOX_VM_PROFILER_H
+#define CLOX_VM_PROFILER_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "clox/core/chunk.h"
+#include "clox/utils/dynarr.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+/**
+ * @file profiler.h
+ * @brief Per-opcode and per-line profiling of the stack VM (`--profile`).
+ *
+ * A VM with a profiler calls profileInstruction() before every instruction.
+ * With threaded dispatch that call sits behind a second dispatch table, so
+ * a VM without a profiler runs the unmodified loop; the switch loop tests
+ * for a profiler once per instruction.
+ *
+ * Two modes can be combined:
+ * - PROFILE_COUNT counts every instruction and charges the clock ticks
+ *   until the next one to it: exact, but the clock read costs ~20 cycles.
+ * - PROFILE_SAMPLE only publishes the instruction being executed; a SIGPROF
+ *   timer samples it. Samples taken outside the VM loop (compiling,
+ *   loading) are kept separately.
+ *
+ * Everything is recorded per bytecode offset while a chunk runs and folded
+ * into (line, opcode) entries when it returns, so reports survive the chunk.
+ * Only one profiler can sample at a time, since the timer is per process.
+ */
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PROFILE_CLOCK_UNIT "cycles" ///< Time stamp counter ticks
+#else
+#define PROFILE_CLOCK_UNIT "ns"
+#endif
+
+#define PROFILE_DEFAULT_INTERVAL 1000 ///< Sampling period in microseconds
+#define PROFILE_REPORT_LINES 20       ///< Hottest lines in the flat report
+
+/// @brief What a profiler records, as a bit set
+typedef enum ProfileMode {
+  PROFILE_COUNT = 1 << 0,  ///< Count and time every instruction
+  PROFILE_SAMPLE = 1 << 1, ///< Sample the current instruction on SIGPROF
+} ProfileMode;
+
+/// @brief Totals of one opcode on one source line
+typedef struct ProfileEntry {
+  size_t line;
+  uint8_t opcode;
+  uint64_t count;   ///< Executions (PROFILE_COUNT)
+  uint64_t ticks;   ///< Clock ticks spent (PROFILE_COUNT)
+  uint64_t samples; ///< SIGPROF samples (PROFILE_SAMPLE)
+} ProfileEntry;
+
+typedef struct Profiler {
+  unsigned mode; ///< ProfileMode bits
+  long interval; ///< Sampling period in microseconds
+  DynArray entries; ///< ProfileEntry of every finished run, unmerged
+  uint64_t outsideSamples; ///< Samples taken while no chunk was running
+  double seconds;          ///< Wall time between start and stop
+
+  /// State of the running chunk
+  const Chunk *chunk;
+  const uint8_t *code;   ///< Bytecode of `chunk`
+  size_t codeCount;      ///< Length of the arrays below
+  uint64_t *counts;      ///< Executions per offset
+  uint64_t *ticks;       ///< Clock ticks per offset
+  uint32_t *samples;     ///< Samples per offset, written by the handler
+  size_t previous;       ///< Offset charged with the ticks since `lastClock`
+  uint64_t lastClock;
+  /// Instruction being executed, NULL outside the VM
+  _Atomic(const uint8_t *) current;
+  double startTime;
+} Profiler;
+
+/// @brief Read the profiling clock (the time stamp counter where available)
+static inline uint64_t readProfileClock(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+#endif
+}
+
+/// @brief Record that the instruction at `ip` is about to run
+static inline void profileInstruction(Profiler *profiler,
+                                      const uint8_t *ip) {
+  atomic_store_explicit(&profiler->current, ip, memory_order_relaxed);
+  if (profiler->mode & PROFILE_COUNT) {
+    size_t offset = (size_t)(ip - profiler->code);
+    uint64_t now = readProfileClock();
+    profiler->ticks[profiler->previous] += now - profiler->lastClock;
+    profiler->counts[offset]++;
+    profiler->previous = offset;
+    profiler->lastClock = now;
+  }
+}
+
+/**
+ * @param mode ProfileMode bits.
+ * @param interval Sampling period in microseconds, used with PROFILE_SAMPLE.
+ */
+void initProfiler(Profiler *profiler, unsigned mode, long interval);
+void freeProfiler(Profiler *profiler);
+
+/// @brief Start the clock and, with PROFILE_SAMPLE, the SIGPROF timer
+void startProfiler(Profiler *profiler);
+/// @brief Stop sampling; the profiler keeps its data for the reports
+void stopProfiler(Profiler *profiler);
+
+/// @brief Prepare the per-offset arrays for `chunk`, called by the VM
+void beginProfileRun(Profiler *profiler, const Chunk *chunk);
+/// @brief Fold the finished run into the entries, called by the VM
+void endProfileRun(Profiler *profiler);
+
+/// @brief Opcode table and hottest source lines
+void printProfile(FILE *out, Profiler *profiler);
+
+/**
+ * @brief Write collapsed stacks (`script;script:line;OPCODE weight`) for
+ * flamegraph.pl and compatible viewers.
+ *
+ * Weights are samples with PROFILE_SAMPLE, clock ticks otherwise.
+ */
+void writeFoldedStacks(FILE *out, Profiler *profiler, const char *script);
+
+#endif
@@ -5,14 +5,65 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "clox/clox.h"
 #include "clox/core/chunk.h"
+#include "clox/core/globals.h"
+#include "clox/core/inline_cache.h"
+#include "clox/core/object.h"
+#include "clox/core/register_chunk.h"
 #include "clox/core/value.h"
 #include "clox/utils/dynarr.h"
+#include "clox/vm/profiler.h"
+#include "config.h"
 
-typedef struct VM {
-  Chunk *chunk;   ///< Currently loaded bytecode chunk
-  uint8_t *ip;    ///< Instruction pointer into the chunk's code array
-  DynArray stack; ///< Operand stack (Value)
+/// @brief Number of Value slots in the operand stack (`stack_max` option)
+#define STACK_MAX CLOX_STACK_MAX
+
+/// @brief Instruction set a VM executes chunks with
+typedef enum VMBackend {
+  VM_BACKEND_STACK,    ///< The stack bytecode, as compiled
+  VM_BACKEND_REGISTER, ///< Translated to register code first (experimental)
+} VMBackend;
+
+#define NATIVE_ERROR_MAX 256 ///< Bytes kept of a native error message
+
+/**
+ * @struct VM
+ * @brief The virtual machine state, `CloxVM` in the public API (clox.h).
+ *
+ * The operand stack is a single allocation of STACK_MAX values made by
+ * initVM(); it never moves, so pointers into it stay valid while the VM runs.
+ * The register window of the register backend grows to the largest script
+ * run so far; while register code runs, the slots it uses hold live values
+ * like the stack. Host functions are ObjNative values in the VM's global slots,
+ * so scripts call them like any other value. Chunks run by a VM must be
+ * compiled (or loaded) into its heap, since strings are compared by
+ * identity, and against its global slots, which keep their values from one
+ * chunk to the next. A chunk kept to be run later must be registered with
+ * registerChunk(), or the collector (gc.h) frees the objects it refers to.
+ */
+typedef struct CloxVM {
+  Chunk *chunk;         ///< Currently loaded bytecode chunk
+  uint8_t *ip;          ///< Instruction pointer into the chunk's code array
+  Value *stack;         ///< Operand stack (STACK_MAX values)
+  Value *stackTop;      ///< One past the top element, the next free slot
+  VMBackend backend;    ///< Set after initVM() to pick the instruction set
+  Value *registers;     ///< Register window of the register backend
+  size_t registerCount; ///< Allocated length of `registers`
+  /// Register code being run, whose constants and slots are roots of the
+  /// collector, or NULL
+  const RegChunk *registerChunk;
+  Profiler *profiler;   ///< Set after initVM() to profile the stack VM
+  Heap heap;            ///< Every object of the VM, interned strings
+  Globals globals;      ///< Global variables and natives, by slot
+  DynArray chunks;      ///< Registered chunks, roots of the collector
+  bool icStats;         ///< Print the inline caches of each chunk run
+  bool registerStats;   ///< Report whether the register backend ran a chunk
+  void *userData;       ///< Embedder pointer, see cloxSetUserData()
+  char nativeError[NATIVE_ERROR_MAX]; ///< Error of the current native call
+#ifdef DEBUG_TRACE_EXECUTION
+  LineIterator traceLines; ///< Line cursor used by the execution trace
+#endif
 } VM;
 
 typedef enum InterpretResult {
@@ -35,33 +86,62 @@ static inline Value readConstant(VM *vm) {
   return ((Value *)vm->chunk->constants.data)[readInstruction(vm)];
 }
 
-/// @brief Push a Value onto the top of the stack
-static inline void push(VM *vm, Value value) {
-  pushDynArray(&vm->stack, &value);
+/// @brief Read Value from constants pool through a 24-bit operand
+/// @note The operand is little-endian, see OP_CONSTANT_LONG
+static inline Value readConstantLong(VM *vm) {
+  size_t index = (size_t)vm->ip[0] | ((size_t)vm->ip[1] << 8) |
+                 ((size_t)vm->ip[2] << 16);
+  vm->ip += 3;
+  return ((Value *)vm->chunk->constants.data)[index];
 }
 
-/// @brief Pop a Value from the top of the stack and return
-/// @note 1. (Value *)vm->stack.data Change the empty pointer to the Value
-/// - pointer
-/// @note 2. + vm->stack.count Pointer arithmetic, move the position of count
-/// - Value elements backward
-/// @note 3. *(...) Dereference to obtain the Value stored at this location
-static inline Value pop(VM *vm) {
-  vm->stack.count--;
-
-  return *((Value *)vm->stack.data + vm->stack.count);
+/// @brief Read a 16-bit little-endian operand (global slot or cache index)
+static inline uint16_t readShort(VM *vm) {
+  uint16_t operand = (uint16_t)(vm->ip[0] | (vm->ip[1] << 8));
+  vm->ip += 2;
+  return operand;
+}
+
+/// @brief Read the cache operand of a property instruction
+static inline InlineCache *readInlineCache(VM *vm) {
+  return chunkCache(vm->chunk, readShort(vm));
 }
 
+/// @brief Push a Value onto the top of the stack
+/// @note No bounds check: opcodes that grow the stack check stackHasRoom()
+/// - before pushing.
+static inline void push(VM *vm, Value value) { *vm->stackTop++ = value; }
+
+/// @brief Pop a Value from the top of the stack and return
+static inline Value pop(VM *vm) { return *--vm->stackTop; }
+
 /// @brief View elements of specified distance in the stack (no pop)
-/// @note stack.count - 1 The position of the top element on the stack
-/// @note stack.count - 1 - distance Target element position
+/// @note stackTop[-1] is the top element
 static inline Value peek(VM *vm, size_t distance) {
+  return vm->stackTop[-1 - (ptrdiff_t)distance];
+}
 
-  return *((Value *)vm->stack.data + vm->stack.count - 1 - distance);
+/// @brief Check whether `slots` more values can be pushed
+static inline bool stackHasRoom(VM *vm, size_t slots) {
+  return (size_t)(vm->stack + STACK_MAX - vm->stackTop) >= slots;
 }
 
 void initVM(VM *vm);
 void freeVM(VM *vm);
+/**
+ * @brief Define global `name` as a host function, replacing its value.
+ *
+ * @return false if `name` is new and the VM has no global slot left.
+ */
+bool defineNative(VM *vm, const char *name, int arity, CloxNativeFn function);
+/// @brief Keep the objects `chunk` refers to alive until unregistered
+void registerChunk(VM *vm, Chunk *chunk);
+void unregisterChunk(VM *vm, Chunk *chunk);
+/// @brief Run `chunk` with the VM's backend
+InterpretResult interpretChunk(VM *vm, Chunk *chunk);
+
+/// @brief Run register code directly (see register_codegen.h)
+InterpretResult interpretRegisterChunk(VM *vm, const RegChunk *chunk);
 InterpretResult interpret(VM *vm, const char *source);
 
 #endif
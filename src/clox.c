@@ -0,0 +1,182 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "clox/clox.h"
+#include "clox/compiler/compiler.h"
+#include "clox/core/chunk.h"
+#include "clox/core/inline_cache.h"
+#include "clox/core/memory.h"
+#include "clox/vm/vm.h"
+#include "config.h"
+
+/**
+ * @file clox.c
+ * @brief The public API (clox.h), a thin layer over the VM and compiler.
+ *
+ * CloxVM is the internal VM itself; CloxProgram wraps a compiled Chunk,
+ * whose strings live in the heap of its VM and which is registered with
+ * the VM so that the collector keeps them.
+ */
+
+struct CloxProgram {
+  Chunk chunk;
+  CloxVM *vm; ///< VM whose heap holds the chunk's strings
+};
+
+static CloxResult toCloxResult(InterpretResult result) {
+  switch ((int)result) {
+  case INTERPRET_OK:
+    return CLOX_OK;
+  case INTERPRET_COMPILE_ERROR:
+    return CLOX_COMPILE_ERROR;
+  default:
+    return CLOX_RUNTIME_ERROR;
+  }
+}
+
+/// @brief Whether `vm` is running a chunk, i.e. called from one of its natives
+static bool vmBusy(const CloxVM *vm) {
+  if (vm->chunk == NULL) {
+    return false;
+  }
+  fprintf(stderr, "Runtime error: The VM is already running a script.\n");
+  return true;
+}
+
+const char *cloxVersion(void) { return CLOX_VERSION; }
+
+CloxVM *cloxNewVM(void) {
+  CloxVM *vm = malloc(sizeof(CloxVM));
+  if (vm != NULL) {
+    initVM(vm);
+  }
+  return vm;
+}
+
+void cloxFreeVM(CloxVM *vm) {
+  if (vm == NULL) {
+    return;
+  }
+  freeVM(vm);
+  free(vm);
+}
+
+CloxResult cloxInterpret(CloxVM *vm, const char *source) {
+  if (vmBusy(vm)) {
+    return CLOX_RUNTIME_ERROR;
+  }
+  return toCloxResult(interpret(vm, source));
+}
+
+CloxProgram *cloxCompile(CloxVM *vm, const char *source) {
+  CloxProgram *program = malloc(sizeof(CloxProgram));
+  if (program == NULL) {
+    return NULL;
+  }
+  program->vm = vm;
+  initChunk(&program->chunk);
+  if (!compile(source, &program->chunk, &vm->heap, &vm->globals)) {
+    cloxFreeProgram(program);
+    return NULL;
+  }
+  registerChunk(vm, &program->chunk);
+  return program;
+}
+
+CloxResult cloxRunProgram(CloxVM *vm, CloxProgram *program) {
+  if (program->vm != vm) {
+    fprintf(stderr, "Runtime error: The program was compiled for another "
+                    "VM.\n");
+    return CLOX_RUNTIME_ERROR;
+  }
+  if (vmBusy(vm)) {
+    return CLOX_RUNTIME_ERROR;
+  }
+  InterpretResult result = interpretChunk(vm, &program->chunk);
+  vm->chunk = NULL;
+  vm->ip = NULL;
+  return toCloxResult(result);
+}
+
+void cloxFreeProgram(CloxProgram *program) {
+  if (program == NULL) {
+    return;
+  }
+  unregisterChunk(program->vm, &program->chunk);
+  freeChunk(&program->chunk);
+  free(program);
+}
+
+bool cloxDefineNative(CloxVM *vm, const char *name, int arity,
+                      CloxNativeFn fn) {
+  return defineNative(vm, name, arity, fn);
+}
+
+void cloxNativeError(CloxVM *vm, const char *message) {
+  snprintf(vm->nativeError, sizeof(vm->nativeError), "%s", message);
+}
+
+void cloxSetUserData(CloxVM *vm, void *userData) { vm->userData = userData; }
+
+void *cloxGetUserData(const CloxVM *vm) { return vm->userData; }
+
+bool cloxGetMemoryStats(const CloxVM *vm, size_t index,
+                        CloxMemoryStats *stats) {
+  if (index > MEM_TAG_COUNT) {
+    return false;
+  }
+  const MemoryStats *memory = &vm->heap.stats;
+  const MemoryTagStats *tag = &memory->total;
+  stats->name = "total";
+  if (index > 0) {
+    tag = &memory->tags[index - 1];
+    stats->name = memoryTagName((MemoryTag)(index - 1));
+  }
+  stats->liveBytes = tag->liveBytes;
+  stats->peakBytes = tag->peakBytes;
+  stats->allocations = tag->allocations;
+  stats->reallocations = tag->reallocations;
+  stats->frees = tag->frees;
+  return true;
+}
+
+void cloxResetMemoryStats(CloxVM *vm) { resetMemoryStats(&vm->heap.stats); }
+
+void cloxPrintMemoryStats(const CloxVM *vm, FILE *out) {
+  printMemoryStats(out, &vm->heap.stats);
+}
+
+_Static_assert((int)CLOX_GC_MINOR == GC_MINOR &&
+                   (int)CLOX_GC_MAJOR == GC_MAJOR,
+               "CloxGcKind must index MemoryStats.gc");
+
+bool cloxGetGcStats(const CloxVM *vm, CloxGcKind kind, CloxGcStats *stats) {
+  if ((int)kind < 0 || (int)kind >= GC_KIND_COUNT) {
+    return false;
+  }
+  const GcKindStats *gc = &vm->heap.stats.gc[kind];
+  stats->collections = gc->collections;
+  stats->bytes = gc->bytes;
+  stats->pauses = gc->pauses;
+  stats->pauseNs = gc->pauseNs;
+  stats->p50PauseNs = gcPausePercentile(gc, 50.0);
+  stats->p99PauseNs = gcPausePercentile(gc, 99.0);
+  stats->maxPauseNs = gc->maxPauseNs;
+  return true;
+}
+
+bool cloxGetCacheStats(const CloxProgram *program, size_t index,
+                       CloxCacheStats *stats) {
+  if (index >= program->chunk.caches.count) {
+    return false;
+  }
+  const InlineCache *cache = chunkCache(&program->chunk, index);
+  stats->name = cache->name->chars;
+  stats->megamorphic = cache->count == IC_MEGAMORPHIC;
+  stats->shapes = stats->megamorphic ? IC_WAYS : cache->count;
+  stats->hits = cache->hits;
+  stats->misses = cache->misses;
+  return true;
+}
@@ -1,4 +1,1011 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "clox/compiler/compiler.h"
+#include "clox/compiler/peephole.h"
 #include "clox/compiler/scanner.h"
+#include "clox/compiler/token_buffer.h"
+#include "clox/core/chunk.h"
+#include "clox/core/globals.h"
+#include "clox/core/memory.h"
+#include "clox/core/object.h"
+#include "clox/core/table.h"
+#include "clox/core/value.h"
+
+/// @brief Largest index an OP_CONSTANT_LONG operand can hold
+#define MAX_CONSTANTS (1u << 24)
+/// @brief Argument counts of OP_CALL and OP_INVOKE are 8-bit operands
+#define MAX_ARGUMENTS UINT8_MAX
+/// @brief Property instructions name their inline cache with 16 bits
+#define MAX_CACHES (UINT16_MAX + 1)
+/// @brief Nested operands (parentheses, unary operators, right operands)
+/// the recursive descent allows, well within a thread's stack
+#define MAX_EXPRESSION_DEPTH 4096
+
+#define SLOT_EMPTY UINT32_MAX           ///< Never used
+#define SLOT_TOMBSTONE (UINT32_MAX - 1) ///< Deleted, keep probing
+#define CACHE_MAX_LOAD 0.75
+
+/**
+ * @struct ConstantSlot
+ * @brief Entry of the constant deduplication table.
+ */
+typedef struct ConstantSlot {
+  uint64_t key;   ///< constantKey() of the pool entry
+  uint32_t index; ///< Pool index, or SLOT_EMPTY / SLOT_TOMBSTONE
+  uint32_t uses;  ///< Instructions currently referencing the entry
+} ConstantSlot;
+
+/**
+ * @struct ConstantCache
+ * @brief Maps constant values to their pool index so that repeated literals
+ * share one pool entry.
+ *
+ * Open addressing with linear probing. Use counts let constant folding drop
+ * an entry once the last instruction referencing it is gone.
+ */
+typedef struct ConstantCache {
+  ConstantSlot *slots; ///< Hash table
+  size_t capacity;     ///< Number of slots, a power of two (or 0)
+  size_t filled;       ///< Occupied slots plus tombstones
+} ConstantCache;
+
+/**
+ * @struct Parser
+ * @brief All state of one compilation.
+ *
+ * The compiler keeps no global state: every function takes the Parser, so
+ * independent compilations can run side by side.
+ */
+typedef struct Parser {
+  Arena *arena;            ///< Compile-lifetime allocations
+  TokenBuffer tokens;      ///< The whole source, tokenized up front
+  TokenCursor cursor;      ///< Next token to read from `tokens`
+  Token current;           ///< Token being looked at
+  Token previous;          ///< Token just consumed
+  Chunk *chunk;            ///< Chunk receiving the bytecode
+  Heap *heap;              ///< Interns string literals and names
+  Globals *globals;        ///< Slots of the VM's global variables
+  Table chunkGlobals;      ///< Names already in the chunk's global list
+  Table fieldCaches;       ///< Last inline cache made for each field name
+  ConstantCache constants; ///< Deduplicates the chunk's constant pool
+  bool hadError;           ///< A compile error was reported
+  bool panicMode;          ///< Suppress cascading errors until synchronize()
+  bool canAssign;          ///< The expression being parsed may be `name = `
+  unsigned depth;          ///< Active parsePrecedence() calls
+
+  size_t exprStart;       ///< Code offset where the left operand starts
+  size_t lastInstruction; ///< Code offset of the last emitted instruction
+} Parser;
+
+/**
+ * @enum Precedence
+ * @brief Operator precedence levels, from lowest to highest.
+ */
+typedef enum Precedence {
+  PREC_NONE,
+  PREC_ASSIGNMENT, ///< =
+  PREC_OR,         ///< or
+  PREC_AND,        ///< and
+  PREC_EQUALITY,   ///< == !=
+  PREC_COMPARISON, ///< < > <= >=
+  PREC_TERM,       ///< + -
+  PREC_FACTOR,     ///< * /
+  PREC_UNARY,      ///< ! -
+  PREC_CALL,       ///< . ()
+  PREC_PRIMARY
+} Precedence;
+
+typedef void (*ParseFn)(Parser *parser);
+
+/**
+ * @struct ParseRule
+ * @brief One row of the Pratt parser table.
+ */
+typedef struct ParseRule {
+  ParseFn prefix;        ///< Called when the token starts an expression
+  ParseFn infix;         ///< Called when the token follows an operand
+  Precedence precedence; ///< Precedence of the token as an infix operator
+} ParseRule;
+
+/* ---------------------------------------------------------------------------
+ * Error reporting
+ * ------------------------------------------------------------------------- */
+
+static void errorAt(Parser *parser, Token *token, const char *message) {
+  if (parser->panicMode) {
+    return;
+  }
+  parser->panicMode = true;
+
+  fprintf(stderr, "[line %zu] Error", token->line);
+  if (token->type == TOKEN_EOF) {
+    fprintf(stderr, " at end");
+  } else if (token->type == TOKEN_ERROR) {
+    /// The message is the error itself, the lexeme is not useful
+  } else {
+    fprintf(stderr, " at '%.*s'", (int)token->length, token->start);
+  }
+  fprintf(stderr, ": %s\n", message);
+
+  parser->hadError = true;
+}
+
+static void error(Parser *parser, const char *message) {
+  errorAt(parser, &parser->previous, message);
+}
+
+static void errorAtCurrent(Parser *parser, const char *message) {
+  errorAt(parser, &parser->current, message);
+}
+
+/* ---------------------------------------------------------------------------
+ * Token stream
+ * ------------------------------------------------------------------------- */
+
+static void advanceToken(Parser *parser) {
+  parser->previous = parser->current;
+
+  for (;;) {
+    parser->current = nextToken(&parser->cursor);
+    if (parser->current.type != TOKEN_ERROR) {
+      break;
+    }
+    errorAtCurrent(parser, parser->current.start);
+  }
+}
+
+static void consume(Parser *parser, TokenType type, const char *message) {
+  if (parser->current.type == type) {
+    advanceToken(parser);
+    return;
+  }
+  errorAtCurrent(parser, message);
+}
+
+static bool check(Parser *parser, TokenType type) {
+  return parser->current.type == type;
+}
+
+static bool match(Parser *parser, TokenType type) {
+  if (!check(parser, type)) {
+    return false;
+  }
+  advanceToken(parser);
+  return true;
+}
+
+/* ---------------------------------------------------------------------------
+ * Bytecode emission
+ * ------------------------------------------------------------------------- */
+
+static size_t currentOffset(Parser *parser) {
+  return parser->chunk->code.count;
+}
+
+/// @brief Emit an operand byte of the current instruction
+static void emitByte(Parser *parser, uint8_t byte) {
+  writeChunk(parser->chunk, byte, parser->previous.line);
+}
+
+/// @brief Emit the opcode that starts a new instruction
+static void emitOp(Parser *parser, uint8_t opcode) {
+  parser->lastInstruction = currentOffset(parser);
+  emitByte(parser, opcode);
+}
+
+/* ---------------------------------------------------------------------------
+ * Constant pool
+ * ------------------------------------------------------------------------- */
+
+/// @brief Bit pattern identifying a constant, so -0 and 0 stay distinct and
+/// NaN matches itself
+static uint64_t constantKey(Value value) {
+#ifdef CLOX_NAN_BOXING
+  return value;
+#else
+  uint64_t key = 0;
+  if (IS_NUMBER(value)) {
+    double number = AS_NUMBER(value);
+    memcpy(&key, &number, sizeof(double));
+  } else if (IS_OBJ(value)) {
+    key = (uint64_t)(uintptr_t)AS_OBJ(value);
+  } else if (IS_BOOL(value)) {
+    key = AS_BOOL(value);
+  }
+  return key;
+#endif
+}
+
+static bool sameConstant(Value a, Value b) {
+#ifdef CLOX_NAN_BOXING
+  return a == b;
+#else
+  return a.type == b.type && constantKey(a) == constantKey(b);
+#endif
+}
+
+/// @brief 64-bit finalizer from MurmurHash3
+static uint64_t hashKey(uint64_t key) {
+  key ^= key >> 33;
+  key *= UINT64_C(0xff51afd7ed558ccd);
+  key ^= key >> 33;
+  key *= UINT64_C(0xc4ceb9fe1a85ec53);
+  key ^= key >> 33;
+  return key;
+}
+
+static Value poolEntry(Parser *parser, size_t index) {
+  return ((Value *)parser->chunk->constants.data)[index];
+}
+
+/**
+ * @brief Find the slot holding `value`, or the slot where it should go.
+ *
+ * @return The matching slot, otherwise the first tombstone or empty slot on
+ * the probe sequence.
+ */
+static ConstantSlot *findSlot(Parser *parser, ConstantSlot *slots,
+                              size_t capacity, Value value) {
+  uint64_t key = constantKey(value);
+  size_t mask = capacity - 1;
+  ConstantSlot *tombstone = NULL;
+
+  for (size_t i = (size_t)hashKey(key) & mask;; i = (i + 1) & mask) {
+    ConstantSlot *slot = &slots[i];
+    if (slot->index == SLOT_EMPTY) {
+      return tombstone != NULL ? tombstone : slot;
+    }
+    if (slot->index == SLOT_TOMBSTONE) {
+      if (tombstone == NULL) {
+        tombstone = slot;
+      }
+    } else if (slot->key == key &&
+               sameConstant(poolEntry(parser, slot->index), value)) {
+      return slot;
+    }
+  }
+}
+
+static void growConstantCache(Parser *parser) {
+  ConstantCache *cache = &parser->constants;
+  size_t capacity = grow_capacity(cache->capacity);
+  ConstantSlot *slots = arenaGrowArray(parser->arena, NULL, 0, capacity,
+                                       sizeof(ConstantSlot));
+  for (size_t i = 0; i < capacity; ++i) {
+    slots[i].index = SLOT_EMPTY;
+  }
+
+  /// Re-insert live entries only, tombstones are dropped
+  cache->filled = 0;
+  for (size_t i = 0; i < cache->capacity; ++i) {
+    ConstantSlot *old = &cache->slots[i];
+    if (old->index == SLOT_EMPTY || old->index == SLOT_TOMBSTONE) {
+      continue;
+    }
+    *findSlot(parser, slots, capacity, poolEntry(parser, old->index)) = *old;
+    cache->filled++;
+  }
+
+  /// The old table stays in the arena until the compilation ends
+  cache->slots = slots;
+  cache->capacity = capacity;
+}
+
+/**
+ * @brief Return the pool index of `value`, adding it only if no identical
+ * constant is in the pool yet.
+ */
+static size_t makeConstant(Parser *parser, Value value) {
+  ConstantCache *cache = &parser->constants;
+  if ((double)(cache->filled + 1) > (double)cache->capacity * CACHE_MAX_LOAD) {
+    growConstantCache(parser);
+  }
+
+  ConstantSlot *slot = findSlot(parser, cache->slots, cache->capacity, value);
+  if (slot->index != SLOT_EMPTY && slot->index != SLOT_TOMBSTONE) {
+    slot->uses++;
+    return slot->index;
+  }
+
+  if (parser->chunk->constants.count >= MAX_CONSTANTS) {
+    error(parser, "Too many constants in one chunk.");
+    return 0;
+  }
+
+  if (slot->index == SLOT_EMPTY) {
+    cache->filled++;
+  }
+  slot->key = constantKey(value);
+  slot->index = (uint32_t)addConstant(parser->chunk, value);
+  slot->uses = 1;
+  return slot->index;
+}
+
+/**
+ * @brief Drop one use of a pool entry, removing it once unused.
+ *
+ * Only the last pool entry can be removed without renumbering. That is the
+ * common case: operands are added right before they are folded.
+ */
+static void releaseConstant(Parser *parser, size_t index) {
+  ConstantCache *cache = &parser->constants;
+  ConstantSlot *slot = findSlot(parser, cache->slots, cache->capacity,
+                                poolEntry(parser, index));
+  if (slot->index != index || --slot->uses > 0) {
+    return;
+  }
+  if (index + 1 == parser->chunk->constants.count) {
+    parser->chunk->constants.count--;
+    slot->index = SLOT_TOMBSTONE;
+  }
+}
+
+/// @brief Check whether releasing one use of a pool entry leaves no dead entry
+static bool canReleaseConstant(Parser *parser, size_t index) {
+  ConstantCache *cache = &parser->constants;
+  ConstantSlot *slot = findSlot(parser, cache->slots, cache->capacity,
+                                poolEntry(parser, index));
+  return slot->uses > 1 || index + 1 == parser->chunk->constants.count;
+}
+
+/// @brief Emit OP_CONSTANT, or OP_CONSTANT_LONG past 256 constants
+static void emitConstant(Parser *parser, Value value) {
+  size_t index = makeConstant(parser, value);
+
+  if (index <= UINT8_MAX) {
+    emitOp(parser, OP_CONSTANT);
+    emitByte(parser, (uint8_t)index);
+  } else {
+    emitOp(parser, OP_CONSTANT_LONG);
+    emitByte(parser, (uint8_t)(index & 0xff));
+    emitByte(parser, (uint8_t)((index >> 8) & 0xff));
+    emitByte(parser, (uint8_t)((index >> 16) & 0xff));
+  }
+}
+
+/**
+ * @brief Slot of the global `name`, recorded in the chunk's global list the
+ * first time the chunk uses it.
+ *
+ * @return false after reporting an error if the VM has no slot left.
+ */
+static bool globalSlot(Parser *parser, const Token *name, uint16_t *slot) {
+  ObjString *string = copyString(parser->heap, name->start, name->length);
+  size_t index = resolveGlobal(parser->globals, string);
+  if (index == GLOBALS_MAX) {
+    error(parser, "Too many global variables.");
+    return false;
+  }
+  if (tableSet(&parser->chunkGlobals, string, NIL_VAL)) {
+    addChunkGlobal(parser->chunk, string, (uint32_t)index);
+  }
+  *slot = (uint16_t)index;
+  return true;
+}
+
+/// @brief Emit a 16-bit little-endian operand
+static void emitShort(Parser *parser, uint16_t operand) {
+  emitByte(parser, (uint8_t)(operand & 0xff));
+  emitByte(parser, (uint8_t)(operand >> 8));
+}
+
+/// @brief Emit a global variable instruction with its 16-bit slot operand
+static void emitGlobal(Parser *parser, uint8_t opcode, uint16_t slot) {
+  emitOp(parser, opcode);
+  emitShort(parser, slot);
+}
+
+/**
+ * @brief The inline cache of a property instruction accessing the field
+ * named by the previous token.
+ *
+ * Every site gets its own cache while the 16-bit operand allows; past that,
+ * sites share the last cache made for the same name, which is still correct
+ * but mixes their shapes.
+ *
+ * @return false after reporting an error if no cache is left for the name.
+ */
+static bool propertyCache(Parser *parser, uint16_t *cache) {
+  ObjString *name = copyString(parser->heap, parser->previous.start,
+                               parser->previous.length);
+  if (parser->chunk->caches.count == MAX_CACHES) {
+    Value shared;
+    if (!tableGet(&parser->fieldCaches, name, &shared)) {
+      error(parser, "Too many property names in one chunk.");
+      return false;
+    }
+    *cache = (uint16_t)AS_NUMBER(shared);
+    return true;
+  }
+  size_t index = addInlineCache(parser->chunk, name);
+  tableSet(&parser->fieldCaches, name, NUMBER_VAL((double)index));
+  *cache = (uint16_t)index;
+  return true;
+}
+
+static void endCompiler(Parser *parser) {
+  emitOp(parser, OP_RETURN);
+  fuseInstructions(parser->chunk);
+  /// The chunk is complete; give back the slack left by doubling
+  shrinkChunk(parser->chunk);
+}
+
+/* ---------------------------------------------------------------------------
+ * Constant folding
+ *
+ * Folding works on code regions [start, end) of the chunk that hold exactly
+ * one operand. The folded result replaces the regions in place, so constant
+ * expressions never reach the VM.
+ * ------------------------------------------------------------------------- */
+
+/// @brief Check whether [start, end) is a single constant load of a number
+static bool numberConstantAt(Parser *parser, size_t start, size_t end,
+                             size_t *index) {
+  const uint8_t *code = (const uint8_t *)parser->chunk->code.data;
+  if (end - start == 2 && code[start] == OP_CONSTANT) {
+    *index = code[start + 1];
+  } else if (end - start == 4 && code[start] == OP_CONSTANT_LONG) {
+    *index = (size_t)code[start + 1] | ((size_t)code[start + 2] << 8) |
+             ((size_t)code[start + 3] << 16);
+  } else {
+    return false;
+  }
+
+  return IS_NUMBER(poolEntry(parser, *index));
+}
+
+static double constantNumber(Parser *parser, size_t index) {
+  return AS_NUMBER(poolEntry(parser, index));
+}
+
+/// @brief Bitwise comparison, so that 0.0 and -0.0 are told apart
+static bool isNumber(double value, double expected) {
+  return memcmp(&value, &expected, sizeof(double)) == 0;
+}
+
+/// @brief Replace everything from `start` on with one constant
+static void replaceWithConstant(Parser *parser, size_t start, double value) {
+  truncateChunk(parser->chunk, start);
+  emitConstant(parser, NUMBER_VAL(value));
+}
+
+/**
+ * @brief Check whether the instruction at `offset` always yields a number
+ *
+ * OP_ADD does not: it also concatenates strings.
+ */
+static bool yieldsNumber(Parser *parser, size_t offset) {
+  uint8_t opcode = ((const uint8_t *)parser->chunk->code.data)[offset];
+  return opcode == OP_SUBTRACT || opcode == OP_MULTIPLY ||
+         opcode == OP_DIVIDE || opcode == OP_NEGATE;
+}
+
+/**
+ * @brief Check whether `value` is an identity element of `opcode` for any
+ * number on the other side.
+ *
+ * Only identities that hold bit for bit under IEEE 754 qualify: `x * 1`,
+ * `x / 1`, `x - 0` and `x + -0`. `x + 0` does not (-0 + 0 is +0).
+ *
+ * @param rightSide true if the constant is the right operand.
+ */
+static bool isIdentity(uint8_t opcode, double value, bool rightSide) {
+  switch (opcode) {
+  case OP_ADD:
+    return isNumber(value, -0.0);
+  case OP_SUBTRACT:
+    return rightSide && isNumber(value, 0.0);
+  case OP_MULTIPLY:
+    return isNumber(value, 1.0);
+  case OP_DIVIDE:
+    return rightSide && isNumber(value, 1.0);
+  default:
+    return false;
+  }
+}
+
+/**
+ * @brief Try to fold `left opcode right` at compile time.
+ *
+ * @param leftStart Start of the left operand's code.
+ * @param leftLast Offset of the last instruction of the left operand.
+ * @param rightStart Start of the right operand's code (end of the left one).
+ *
+ * @return true if the operation was folded and must not be emitted.
+ *
+ * @note An operand can only be dropped as an identity when the other one is
+ * - known to be a number, otherwise the runtime type error would be lost.
+ */
+static bool foldBinary(Parser *parser, uint8_t opcode, size_t leftStart,
+                       size_t leftLast, size_t rightStart) {
+  if (opcode != OP_ADD && opcode != OP_SUBTRACT && opcode != OP_MULTIPLY &&
+      opcode != OP_DIVIDE) {
+    return false;
+  }
+
+  size_t end = currentOffset(parser);
+  size_t leftIndex = 0;
+  size_t rightIndex = 0;
+  bool leftConstant =
+      numberConstantAt(parser, leftStart, rightStart, &leftIndex);
+  bool rightConstant = numberConstantAt(parser, rightStart, end, &rightIndex);
+
+  if (leftConstant && rightConstant) {
+    double a = constantNumber(parser, leftIndex);
+    double b = constantNumber(parser, rightIndex);
+    double result = 0;
+    switch (opcode) {
+    case OP_ADD:
+      result = a + b;
+      break;
+    case OP_SUBTRACT:
+      result = a - b;
+      break;
+    case OP_MULTIPLY:
+      result = a * b;
+      break;
+    default:
+      result = a / b;
+      break;
+    }
+    releaseConstant(parser, rightIndex);
+    releaseConstant(parser, leftIndex);
+    replaceWithConstant(parser, leftStart, result);
+    return true;
+  }
+
+  /// x op k, with x known to be a number
+  if (rightConstant && yieldsNumber(parser, leftLast) &&
+      isIdentity(opcode, constantNumber(parser, rightIndex), true)) {
+    releaseConstant(parser, rightIndex);
+    truncateChunk(parser->chunk, rightStart);
+    parser->lastInstruction = leftLast;
+    return true;
+  }
+
+  /// k op x, with x known to be a number. Skipped when x added constants
+  /// after k, since k's pool entry could not be reclaimed.
+  if (leftConstant && canReleaseConstant(parser, leftIndex) &&
+      yieldsNumber(parser, parser->lastInstruction) &&
+      isIdentity(opcode, constantNumber(parser, leftIndex), false)) {
+    /// Slide the right operand over the constant
+    eraseChunk(parser->chunk, leftStart, rightStart - leftStart);
+    releaseConstant(parser, leftIndex);
+    parser->lastInstruction -= rightStart - leftStart;
+    return true;
+  }
+
+  return false;
+}
+
+/// @brief Fold `-k` for a numeric constant operand in [start, end)
+static bool foldNegate(Parser *parser, size_t start) {
+  size_t index = 0;
+  if (!numberConstantAt(parser, start, currentOffset(parser), &index)) {
+    return false;
+  }
+
+  double value = -constantNumber(parser, index);
+  releaseConstant(parser, index);
+  replaceWithConstant(parser, start, value);
+  return true;
+}
+
+/* ---------------------------------------------------------------------------
+ * Expressions
+ * ------------------------------------------------------------------------- */
+
+static void expression(Parser *parser);
+static const ParseRule *getRule(TokenType type);
+static void parsePrecedence(Parser *parser, Precedence precedence);
+
+/**
+ * @struct OperatorCode
+ * @brief Bytecode emitted for an operator token.
+ *
+ * `!=`, `>=` and `<=` have no instruction of their own; they are the negation
+ * of `==`, `<` and `>`.
+ */
+typedef struct OperatorCode {
+  uint8_t opcode; ///< Instruction implementing the operator
+  bool negate;    ///< Follow the instruction with OP_NOT
+} OperatorCode;
+
+/// @brief Binary operator instructions, indexed by TokenType
+static const OperatorCode binaryCodes[] = {
+    [TOKEN_BANG_EQUAL] = {OP_EQUAL, true},
+    [TOKEN_EQUAL_EQUAL] = {OP_EQUAL, false},
+    [TOKEN_GREATER] = {OP_GREATER, false},
+    [TOKEN_GREATER_EQUAL] = {OP_LESS, true},
+    [TOKEN_LESS] = {OP_LESS, false},
+    [TOKEN_LESS_EQUAL] = {OP_GREATER, true},
+    [TOKEN_PLUS] = {OP_ADD, false},
+    [TOKEN_MINUS] = {OP_SUBTRACT, false},
+    [TOKEN_STAR] = {OP_MULTIPLY, false},
+    [TOKEN_SLASH] = {OP_DIVIDE, false},
+};
+
+static void binary(Parser *parser) {
+  TokenType operatorType = parser->previous.type;
+  const ParseRule *rule = getRule(operatorType);
+  size_t leftStart = parser->exprStart;
+  size_t leftLast = parser->lastInstruction;
+  size_t rightStart = currentOffset(parser);
+
+  /// Left associative: the right operand binds one level tighter
+  parsePrecedence(parser, (Precedence)(rule->precedence + 1));
+
+  const OperatorCode *code = &binaryCodes[operatorType];
+  if (foldBinary(parser, code->opcode, leftStart, leftLast, rightStart)) {
+    return;
+  }
+  emitOp(parser, code->opcode);
+  if (code->negate) {
+    emitOp(parser, OP_NOT);
+  }
+}
+
+static void literal(Parser *parser) {
+  TokenType type = parser->previous.type;
+
+  if (type == TOKEN_FALSE) {
+    emitOp(parser, OP_FALSE);
+  } else if (type == TOKEN_TRUE) {
+    emitOp(parser, OP_TRUE);
+  } else {
+    emitOp(parser, OP_NIL);
+  }
+}
+
+static void grouping(Parser *parser) {
+  expression(parser);
+  consume(parser, TOKEN_RIGHT_PAREN, "Expect ')' after expression.");
+}
+
+static void number(Parser *parser) {
+  double value = strtod(parser->previous.start, NULL);
+  emitConstant(parser, NUMBER_VAL(value));
+}
+
+static void string(Parser *parser) {
+  /// Drop the quotes; Lox strings have no escape sequences
+  ObjString *text = copyString(parser->heap, parser->previous.start + 1,
+                               parser->previous.length - 2);
+  emitConstant(parser, OBJ_VAL(text));
+}
+
+/// @brief Compile the arguments of a call, up to and including the `)`
+static uint8_t argumentList(Parser *parser) {
+  size_t argCount = 0;
+  if (!check(parser, TOKEN_RIGHT_PAREN)) {
+    do {
+      expression(parser);
+      if (argCount == MAX_ARGUMENTS) {
+        error(parser, "Can't have more than 255 arguments.");
+      }
+      argCount++;
+    } while (match(parser, TOKEN_COMMA));
+  }
+  consume(parser, TOKEN_RIGHT_PAREN, "Expect ')' after arguments.");
+  return (uint8_t)argCount;
+}
+
+/**
+ * @brief `callee(arguments)`, with the callee already on the stack.
+ *
+ * Lox has no functions of its own yet: the callee can be a native
+ * registered by the embedder (see clox.h) or a class.
+ */
+static void call(Parser *parser) {
+  uint8_t argCount = argumentList(parser);
+  emitOp(parser, OP_CALL);
+  emitByte(parser, argCount);
+}
+
+/**
+ * @brief `object.name`, `object.name = value` or `object.name(arguments)`.
+ *
+ * Each access gets its own inline cache, so the VM can remember the field
+ * index for the shapes that site sees.
+ */
+static void dot(Parser *parser) {
+  bool canAssign = parser->canAssign;
+  consume(parser, TOKEN_IDENTIFIER, "Expect property name after '.'.");
+  uint16_t cache;
+  if (!propertyCache(parser, &cache)) {
+    return;
+  }
+
+  if (canAssign && match(parser, TOKEN_EQUAL)) {
+    expression(parser);
+    emitOp(parser, OP_SET_PROPERTY);
+    emitShort(parser, cache);
+  } else if (match(parser, TOKEN_LEFT_PAREN)) {
+    uint8_t argCount = argumentList(parser);
+    emitOp(parser, OP_INVOKE);
+    emitShort(parser, cache);
+    emitByte(parser, argCount);
+  } else {
+    emitOp(parser, OP_GET_PROPERTY);
+    emitShort(parser, cache);
+  }
+}
+
+/**
+ * @brief An identifier: a global variable read or assignment.
+ *
+ * Globals are resolved to their slot here, at compile time, whether or not
+ * they are defined yet; the VM reports undefined ones when they are used.
+ */
+static void variable(Parser *parser) {
+  uint16_t slot;
+  if (!globalSlot(parser, &parser->previous, &slot)) {
+    return;
+  }
+  if (parser->canAssign && match(parser, TOKEN_EQUAL)) {
+    expression(parser);
+    emitGlobal(parser, OP_SET_GLOBAL, slot);
+  } else {
+    emitGlobal(parser, OP_GET_GLOBAL, slot);
+  }
+}
+
+static void unary(Parser *parser) {
+  TokenType operatorType = parser->previous.type;
+  size_t operandStart = currentOffset(parser);
+
+  /// Compile the operand
+  parsePrecedence(parser, PREC_UNARY);
+
+  if (operatorType == TOKEN_BANG) {
+    emitOp(parser, OP_NOT);
+  } else if (!foldNegate(parser, operandStart)) {
+    emitOp(parser, OP_NEGATE);
+  }
+}
+
+/// @brief Pratt parser table, indexed by TokenType
+static const ParseRule rules[] = {
+    [TOKEN_LEFT_PAREN] = {grouping, call, PREC_CALL},
+    [TOKEN_RIGHT_PAREN] = {NULL, NULL, PREC_NONE},
+    [TOKEN_LEFT_BRACE] = {NULL, NULL, PREC_NONE},
+    [TOKEN_RIGHT_BRACE] = {NULL, NULL, PREC_NONE},
+    [TOKEN_COMMA] = {NULL, NULL, PREC_NONE},
+    [TOKEN_DOT] = {NULL, dot, PREC_CALL},
+    [TOKEN_MINUS] = {unary, binary, PREC_TERM},
+    [TOKEN_PLUS] = {NULL, binary, PREC_TERM},
+    [TOKEN_SEMICOLON] = {NULL, NULL, PREC_NONE},
+    [TOKEN_SLASH] = {NULL, binary, PREC_FACTOR},
+    [TOKEN_STAR] = {NULL, binary, PREC_FACTOR},
+    [TOKEN_BANG] = {unary, NULL, PREC_NONE},
+    [TOKEN_BANG_EQUAL] = {NULL, binary, PREC_EQUALITY},
+    [TOKEN_EQUAL] = {NULL, NULL, PREC_NONE},
+    [TOKEN_EQUAL_EQUAL] = {NULL, binary, PREC_EQUALITY},
+    [TOKEN_GREATER] = {NULL, binary, PREC_COMPARISON},
+    [TOKEN_GREATER_EQUAL] = {NULL, binary, PREC_COMPARISON},
+    [TOKEN_LESS] = {NULL, binary, PREC_COMPARISON},
+    [TOKEN_LESS_EQUAL] = {NULL, binary, PREC_COMPARISON},
+    [TOKEN_IDENTIFIER] = {variable, NULL, PREC_NONE},
+    [TOKEN_STRING] = {string, NULL, PREC_NONE},
+    [TOKEN_NUMBER] = {number, NULL, PREC_NONE},
+    [TOKEN_AND] = {NULL, NULL, PREC_NONE},
+    [TOKEN_CLASS] = {NULL, NULL, PREC_NONE},
+    [TOKEN_ELSE] = {NULL, NULL, PREC_NONE},
+    [TOKEN_FALSE] = {literal, NULL, PREC_NONE},
+    [TOKEN_FOR] = {NULL, NULL, PREC_NONE},
+    [TOKEN_FUN] = {NULL, NULL, PREC_NONE},
+    [TOKEN_IF] = {NULL, NULL, PREC_NONE},
+    [TOKEN_NIL] = {literal, NULL, PREC_NONE},
+    [TOKEN_OR] = {NULL, NULL, PREC_NONE},
+    [TOKEN_PRINT] = {NULL, NULL, PREC_NONE},
+    [TOKEN_RETURN] = {NULL, NULL, PREC_NONE},
+    [TOKEN_SUPER] = {NULL, NULL, PREC_NONE},
+    [TOKEN_THIS] = {NULL, NULL, PREC_NONE},
+    [TOKEN_TRUE] = {literal, NULL, PREC_NONE},
+    [TOKEN_VAR] = {NULL, NULL, PREC_NONE},
+    [TOKEN_WHILE] = {NULL, NULL, PREC_NONE},
+    [TOKEN_ERROR] = {NULL, NULL, PREC_NONE},
+    [TOKEN_EOF] = {NULL, NULL, PREC_NONE},
+};
+
+static const ParseRule *getRule(TokenType type) { return &rules[type]; }
+
+/**
+ * @brief Parse any expression whose operators bind at least as tightly as
+ * `precedence`.
+ *
+ * The first token always has a prefix rule (literal, unary, grouping...);
+ * infix rules are then applied for as long as the next operator has a high
+ * enough precedence.
+ */
+static void parsePrecedence(Parser *parser, Precedence precedence) {
+  if (parser->depth == MAX_EXPRESSION_DEPTH) {
+    /// Stop descending; the enclosing statement resynchronizes
+    errorAtCurrent(parser, "Expression nests too deeply.");
+    return;
+  }
+  parser->depth++;
+  size_t start = currentOffset(parser);
+  advanceToken(parser);
+  ParseFn prefixRule = getRule(parser->previous.type)->prefix;
+  if (prefixRule == NULL) {
+    error(parser, "Expect expression.");
+    parser->depth--;
+    return;
+  }
+
+  /// Only a prefix at assignment level can be the target of `=`; rules
+  /// read the flag before they parse any operand
+  bool canAssign = precedence <= PREC_ASSIGNMENT;
+  parser->canAssign = canAssign;
+  prefixRule(parser);
+
+  while (precedence <= getRule(parser->current.type)->precedence) {
+    advanceToken(parser);
+    ParseFn infixRule = getRule(parser->previous.type)->infix;
+    /// Everything since `start` is the left operand of the infix operator
+    parser->exprStart = start;
+    /// The operand may have parsed nested expressions and reset the flag
+    parser->canAssign = canAssign;
+    infixRule(parser);
+  }
+
+  if (canAssign && match(parser, TOKEN_EQUAL)) {
+    error(parser, "Invalid assignment target.");
+  }
+  parser->depth--;
+}
+
+static void expression(Parser *parser) {
+  parsePrecedence(parser, PREC_ASSIGNMENT);
+}
+
+/* ---------------------------------------------------------------------------
+ * Statements
+ * ------------------------------------------------------------------------- */
+
+static void printStatement(Parser *parser) {
+  expression(parser);
+  consume(parser, TOKEN_SEMICOLON, "Expect ';' after value.");
+  emitOp(parser, OP_PRINT);
+}
+
+static void expressionStatement(Parser *parser) {
+  expression(parser);
+  consume(parser, TOKEN_SEMICOLON, "Expect ';' after expression.");
+  emitOp(parser, OP_POP);
+}
+
+/// @brief Check whether a token can only start a new statement
+static bool startsStatement(TokenType type) {
+  return type == TOKEN_CLASS || type == TOKEN_FUN || type == TOKEN_VAR ||
+         type == TOKEN_FOR || type == TOKEN_IF || type == TOKEN_WHILE ||
+         type == TOKEN_PRINT || type == TOKEN_RETURN;
+}
+
+/// @brief Skip tokens until a statement boundary after a compile error
+static void synchronize(Parser *parser) {
+  parser->panicMode = false;
+
+  while (parser->current.type != TOKEN_EOF) {
+    if (parser->previous.type == TOKEN_SEMICOLON ||
+        startsStatement(parser->current.type)) {
+      return;
+    }
+    advanceToken(parser);
+  }
+}
+
+static void statement(Parser *parser) {
+  if (match(parser, TOKEN_PRINT)) {
+    printStatement(parser);
+  } else {
+    expressionStatement(parser);
+  }
+}
+
+/// @brief `var name;` or `var name = value;`, at the top level
+static void varDeclaration(Parser *parser) {
+  consume(parser, TOKEN_IDENTIFIER, "Expect variable name.");
+  uint16_t slot;
+  bool resolved = globalSlot(parser, &parser->previous, &slot);
+
+  if (match(parser, TOKEN_EQUAL)) {
+    expression(parser);
+  } else {
+    emitOp(parser, OP_NIL);
+  }
+  consume(parser, TOKEN_SEMICOLON, "Expect ';' after variable declaration.");
+
+  if (resolved) {
+    emitGlobal(parser, OP_DEFINE_GLOBAL, slot);
+  }
+}
+
+/**
+ * @brief `class Name {}`, at the top level.
+ *
+ * Classes have no methods yet; instances get their fields by assignment.
+ */
+static void classDeclaration(Parser *parser) {
+  consume(parser, TOKEN_IDENTIFIER, "Expect class name.");
+  Token name = parser->previous;
+  uint16_t slot;
+  bool resolved = globalSlot(parser, &name, &slot);
+
+  emitConstant(parser, OBJ_VAL(copyString(parser->heap, name.start,
+                                          name.length)));
+  emitOp(parser, OP_CLASS);
+  consume(parser, TOKEN_LEFT_BRACE, "Expect '{' before class body.");
+  if (!check(parser, TOKEN_RIGHT_BRACE) && !check(parser, TOKEN_EOF)) {
+    errorAtCurrent(parser, "Methods are not supported yet.");
+  }
+  consume(parser, TOKEN_RIGHT_BRACE, "Expect '}' after class body.");
+
+  if (resolved) {
+    emitGlobal(parser, OP_DEFINE_GLOBAL, slot);
+  }
+}
+
+static void declaration(Parser *parser) {
+  if (match(parser, TOKEN_CLASS)) {
+    classDeclaration(parser);
+  } else if (match(parser, TOKEN_VAR)) {
+    varDeclaration(parser);
+  } else {
+    statement(parser);
+  }
+
+  if (parser->panicMode) {
+    synchronize(parser);
+  }
+}
+
+bool compileInArena(const char *source, Chunk *chunk, Heap *heap,
+                    Globals *globals, Arena *arena) {
+  Parser parser;
+  parser.arena = arena;
+  initTokenBuffer(&parser.tokens, arena);
+  if (!scanAll(source, &parser.tokens)) {
+    fprintf(stderr, "Error: Source is too large (over 4 GiB).\n");
+    return false;
+  }
+  initTokenCursor(&parser.cursor, &parser.tokens);
+  parser.chunk = chunk;
+  parser.heap = heap;
+  parser.globals = globals;
+  initTable(&parser.chunkGlobals);
+  initTable(&parser.fieldCaches);
+  parser.hadError = false;
+  parser.panicMode = false;
+  parser.canAssign = false;
+  parser.depth = 0;
+  parser.exprStart = 0;
+  parser.lastInstruction = 0;
+  parser.constants.slots = NULL;
+  parser.constants.capacity = 0;
+  parser.constants.filled = 0;
+
+  advanceToken(&parser);
+  while (!match(&parser, TOKEN_EOF)) {
+    declaration(&parser);
+  }
+  endCompiler(&parser);
+  freeTable(&parser.chunkGlobals);
+  freeTable(&parser.fieldCaches);
+
+  return !parser.hadError;
+}
 
-void compile(const char *source) { initScanner(source); }
+bool compile(const char *source, Chunk *chunk, Heap *heap, Globals *globals) {
+  Arena arena;
+  initArena(&arena, 0, MEM_COMPILER);
+  bool compiled = compileInArena(source, chunk, heap, globals, &arena);
+  freeArena(&arena);
+  return compiled;
+}
@@ -0,0 +1,98 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "clox/compiler/peephole.h"
+#include "clox/core/chunk.h"
+#include "clox/core/value.h"
+#include "clox/utils/dynarr.h"
+#include "config.h"
+
+#ifdef CLOX_SUPERINSTRUCTIONS
+/// @brief Superinstruction for `OP_CONSTANT k; opcode`, if there is one
+static bool constantForm(uint8_t opcode, uint8_t *fused) {
+  switch (opcode) {
+  case OP_ADD:
+    *fused = OP_ADD_CONSTANT;
+    return true;
+  case OP_SUBTRACT:
+    *fused = OP_SUBTRACT_CONSTANT;
+    return true;
+  case OP_MULTIPLY:
+    *fused = OP_MULTIPLY_CONSTANT;
+    return true;
+  case OP_DIVIDE:
+    *fused = OP_DIVIDE_CONSTANT;
+    return true;
+  default:
+    return false;
+  }
+}
+
+/**
+ * @brief Check whether the OP_CONSTANT at `offset` fuses with the next
+ * instruction into an arithmetic superinstruction.
+ */
+static bool fusesWithNext(const Chunk *chunk, size_t offset,
+                          uint8_t *fused) {
+  const uint8_t *code = (const uint8_t *)chunk->code.data;
+  const Value *constants = (const Value *)chunk->constants.data;
+  size_t next = offset + 2;
+
+  /// Strings will make OP_ADD polymorphic; only numbers have a fused form
+  return code[offset] == OP_CONSTANT && next < chunk->code.count &&
+         IS_NUMBER(constants[code[offset + 1]]) &&
+         constantForm(code[next], fused);
+}
+
+void fuseInstructions(Chunk *chunk) {
+  const uint8_t *code = (const uint8_t *)chunk->code.data;
+  size_t count = chunk->code.count;
+
+  /// Code and lines are rebuilt in a scratch chunk, constants stay put
+  Chunk fused;
+  initChunk(&fused);
+  reserveDynArray(&fused.code, count);
+
+  LineIterator lines;
+  initLineIterator(&lines, chunk);
+
+  for (size_t offset = 0; offset < count;) {
+    uint8_t opcode = code[offset];
+    size_t length = instructionLength(opcode);
+    uint8_t superinstruction;
+
+    if (fusesWithNext(chunk, offset, &superinstruction)) {
+      size_t line = lineIteratorSeek(&lines, offset + 2);
+      writeChunk(&fused, superinstruction, line);
+      writeChunk(&fused, code[offset + 1], line);
+      offset += 3;
+      continue;
+    }
+
+    size_t line = lineIteratorSeek(&lines, offset);
+    if (opcode == OP_CONSTANT && offset + 2 < count &&
+        code[offset + 2] == OP_CONSTANT &&
+        !fusesWithNext(chunk, offset + 2, &superinstruction)) {
+      writeChunk(&fused, OP_CONSTANT_CONSTANT, line);
+      writeChunk(&fused, code[offset + 1], line);
+      writeChunk(&fused, code[offset + 3], line);
+      offset += 4;
+      continue;
+    }
+
+    for (size_t i = 0; i < length; ++i) {
+      writeChunk(&fused, code[offset + i], line);
+    }
+    offset += length;
+  }
+
+  freeDynArray(&chunk->code);
+  freeDynArray(&chunk->lines);
+  chunk->code = fused.code;
+  chunk->lines = fused.lines;
+  freeDynArray(&fused.constants);
+}
+#else
+void fuseInstructions(Chunk *chunk) { (void)chunk; }
+#endif
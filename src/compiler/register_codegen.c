@@ -0,0 +1,271 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "clox/compiler/register_codegen.h"
+#include "clox/core/chunk.h"
+#include "clox/core/memory.h"
+#include "clox/core/register_chunk.h"
+#include "clox/core/value.h"
+#include "clox/utils/dynarr.h"
+
+/// @brief State of one translation
+typedef struct RegGen {
+  const Chunk *chunk;  ///< Stack code being translated
+  RegChunk *out;       ///< Register code being written
+  uint32_t *operands;  ///< Slot of each value on the simulated stack
+  size_t depth;        ///< Values on the simulated stack
+  size_t capacity;     ///< Allocated length of `operands`
+  uint32_t literals[3]; ///< Slots of nil, true and false
+  bool overflow;       ///< The window outgrew REG_SLOT_MAX
+  bool unsupported;    ///< An instruction has no register form
+} RegGen;
+
+enum { LITERAL_NIL, LITERAL_TRUE, LITERAL_FALSE };
+
+static void pushOperand(RegGen *gen, uint32_t slot) {
+  if (gen->depth == gen->capacity) {
+    size_t capacity = grow_capacity(gen->capacity);
+    gen->operands = grow_array(gen->operands, gen->capacity, capacity,
+                               sizeof(uint32_t), MEM_COMPILER);
+    gen->capacity = capacity;
+  }
+  gen->operands[gen->depth++] = slot;
+}
+
+static uint32_t popOperand(RegGen *gen) {
+  return gen->operands[--gen->depth];
+}
+
+/// @brief Temporary register for the value about to be pushed
+static uint32_t nextTemporary(RegGen *gen) {
+  size_t slot = gen->out->constants.count + gen->depth;
+  if (slot > REG_SLOT_MAX) {
+    gen->overflow = true;
+    return 0;
+  }
+  if (slot + 1 > gen->out->slotCount) {
+    gen->out->slotCount = slot + 1;
+  }
+  return (uint32_t)slot;
+}
+
+static void emitUnary(RegGen *gen, RegOpCode op, size_t line) {
+  uint32_t operand = popOperand(gen);
+  uint32_t dest = nextTemporary(gen);
+  writeRegChunk(gen->out, makeRegInstruction(op, dest, operand, 0), line);
+  pushOperand(gen, dest);
+}
+
+static void emitBinary(RegGen *gen, RegOpCode op, uint32_t right,
+                       size_t line) {
+  uint32_t left = popOperand(gen);
+  uint32_t dest = nextTemporary(gen);
+  writeRegChunk(gen->out, makeRegInstruction(op, dest, left, right), line);
+  pushOperand(gen, dest);
+}
+
+/// @brief The 16-bit global slot operand of the instruction at `offset`
+static uint32_t readSlot(const uint8_t *code, size_t offset) {
+  return (uint32_t)code[offset + 1] | ((uint32_t)code[offset + 2] << 8);
+}
+
+/// @brief Register form of a stack instruction consuming two operands
+static bool binaryForm(uint8_t opcode, RegOpCode *op) {
+  switch (opcode) {
+  case OP_ADD:
+  case OP_ADD_CONSTANT:
+    *op = REG_ADD;
+    return true;
+  case OP_SUBTRACT:
+  case OP_SUBTRACT_CONSTANT:
+    *op = REG_SUBTRACT;
+    return true;
+  case OP_MULTIPLY:
+  case OP_MULTIPLY_CONSTANT:
+    *op = REG_MULTIPLY;
+    return true;
+  case OP_DIVIDE:
+  case OP_DIVIDE_CONSTANT:
+    *op = REG_DIVIDE;
+    return true;
+  case OP_EQUAL:
+    *op = REG_EQUAL;
+    return true;
+  case OP_GREATER:
+    *op = REG_GREATER;
+    return true;
+  case OP_LESS:
+    *op = REG_LESS;
+    return true;
+  default:
+    return false;
+  }
+}
+
+/// @brief The comparison with its result negated, for a following OP_NOT
+static bool negatedForm(RegOpCode op, RegOpCode *negated) {
+  if (op == REG_EQUAL) {
+    *negated = REG_NOT_EQUAL;
+  } else if (op == REG_GREATER) {
+    *negated = REG_NOT_GREATER;
+  } else if (op == REG_LESS) {
+    *negated = REG_NOT_LESS;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/// @brief Slot of nil/true/false, appended to the constants on first use
+static uint32_t literalSlot(RegGen *gen, int literal, Value value) {
+  if (gen->literals[literal] == UINT32_MAX) {
+    gen->literals[literal] = (uint32_t)gen->out->constants.count;
+    pushValueDynArray(&gen->out->constants, value);
+  }
+  return gen->literals[literal];
+}
+
+/**
+ * @brief Copy the constant pool and add the literals the code uses.
+ *
+ * Temporaries are numbered after the constants, so every constant has to be
+ * known before the first instruction is translated.
+ */
+static void collectConstants(RegGen *gen) {
+  const Chunk *chunk = gen->chunk;
+  pushManyDynArray(&gen->out->constants, chunk->constants.data,
+                   chunk->constants.count);
+
+  const uint8_t *code = (const uint8_t *)chunk->code.data;
+  for (size_t offset = 0; offset < chunk->code.count;
+       offset += instructionLength(code[offset])) {
+    if (code[offset] == OP_NIL) {
+      literalSlot(gen, LITERAL_NIL, NIL_VAL);
+    } else if (code[offset] == OP_TRUE) {
+      literalSlot(gen, LITERAL_TRUE, BOOL_VAL(true));
+    } else if (code[offset] == OP_FALSE) {
+      literalSlot(gen, LITERAL_FALSE, BOOL_VAL(false));
+    }
+  }
+}
+
+bool generateRegisterCode(const Chunk *chunk, RegChunk *out) {
+  RegGen gen = {.chunk = chunk,
+                .out = out,
+                .literals = {UINT32_MAX, UINT32_MAX, UINT32_MAX}};
+  collectConstants(&gen);
+  if (out->constants.count > REG_SLOT_MAX) {
+    return false;
+  }
+  out->slotCount = out->constants.count;
+
+  const uint8_t *code = (const uint8_t *)chunk->code.data;
+  LineIterator lines;
+  initLineIterator(&lines, chunk);
+
+  for (size_t offset = 0;
+       offset < chunk->code.count && !gen.overflow && !gen.unsupported;) {
+    uint8_t opcode = code[offset];
+    size_t length = instructionLength(opcode);
+    size_t line = lineIteratorSeek(&lines, offset);
+    RegOpCode op;
+
+    switch (opcode) {
+    case OP_CONSTANT:
+      pushOperand(&gen, code[offset + 1]);
+      break;
+    case OP_CONSTANT_LONG:
+      pushOperand(&gen, (uint32_t)code[offset + 1] |
+                            ((uint32_t)code[offset + 2] << 8) |
+                            ((uint32_t)code[offset + 3] << 16));
+      break;
+    case OP_CONSTANT_CONSTANT:
+      pushOperand(&gen, code[offset + 1]);
+      pushOperand(&gen, code[offset + 2]);
+      break;
+    case OP_NIL:
+      pushOperand(&gen, gen.literals[LITERAL_NIL]);
+      break;
+    case OP_TRUE:
+      pushOperand(&gen, gen.literals[LITERAL_TRUE]);
+      break;
+    case OP_FALSE:
+      pushOperand(&gen, gen.literals[LITERAL_FALSE]);
+      break;
+    case OP_POP:
+      (void)popOperand(&gen);
+      break;
+    case OP_ADD_CONSTANT:
+    case OP_SUBTRACT_CONSTANT:
+    case OP_MULTIPLY_CONSTANT:
+    case OP_DIVIDE_CONSTANT:
+      (void)binaryForm(opcode, &op);
+      emitBinary(&gen, op, code[offset + 1], line);
+      break;
+    case OP_NOT:
+      emitUnary(&gen, REG_NOT, line);
+      break;
+    case OP_NEGATE:
+      emitUnary(&gen, REG_NEGATE, line);
+      break;
+    case OP_PRINT:
+      writeRegChunk(out, makeRegInstruction(REG_PRINT, popOperand(&gen), 0, 0),
+                    line);
+      break;
+    case OP_RETURN:
+      writeRegChunk(out, makeRegInstruction(REG_RETURN, 0, 0, 0), line);
+      break;
+    case OP_DEFINE_GLOBAL:
+      writeRegChunk(out,
+                    makeRegInstruction(REG_DEFINE_GLOBAL,
+                                       readSlot(code, offset),
+                                       popOperand(&gen), 0),
+                    line);
+      break;
+    case OP_GET_GLOBAL: {
+      /// Into a temporary: a later assignment must not change the value
+      uint32_t dest = nextTemporary(&gen);
+      writeRegChunk(out,
+                    makeRegInstruction(REG_GET_GLOBAL, dest,
+                                       readSlot(code, offset), 0),
+                    line);
+      pushOperand(&gen, dest);
+      break;
+    }
+    case OP_SET_GLOBAL:
+      /// The assigned value stays on the stack as the expression's result
+      writeRegChunk(out,
+                    makeRegInstruction(REG_SET_GLOBAL, readSlot(code, offset),
+                                       gen.operands[gen.depth - 1], 0),
+                    line);
+      break;
+    case OP_CALL:
+    case OP_CLASS:
+    case OP_GET_PROPERTY:
+    case OP_SET_PROPERTY:
+    case OP_INVOKE:
+      /// Calls and objects run on the VM stack
+      gen.unsupported = true;
+      break;
+    default:
+      if (binaryForm(opcode, &op)) {
+        /// `a >= b` compiles to OP_LESS, OP_NOT: fold the negation in
+        RegOpCode negated;
+        size_t next = offset + length;
+        if (next < chunk->code.count && code[next] == OP_NOT &&
+            negatedForm(op, &negated)) {
+          op = negated;
+          length++;
+        }
+        emitBinary(&gen, op, popOperand(&gen), line);
+      }
+      break;
+    }
+    offset += length;
+  }
+
+  gen.operands = free_array(gen.operands, gen.capacity, sizeof(uint32_t),
+                            MEM_COMPILER);
+  return !gen.overflow && !gen.unsupported;
+}
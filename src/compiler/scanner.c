@@ -1,10 +1,55 @@
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "clox/compiler/scanner.h"
 
+#define CA CHAR_ALPHA
+#define CD CHAR_DIGIT
+#define CB CHAR_BLANK
+#define CO CHAR_OPERATOR
+#define CE CHAR_EQUALS
+
+/// @brief CharClass bits of every byte; bytes >= 0x80 belong to no class
+const uint8_t scannerCharClass[256] = {
+     0,  0,  0,  0,  0,  0,  0,  0,  0, CB, CB,  0,  0, CB,  0,  0, /* 0x00 */
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, /* 0x10 */
+    CB, CE,  0,  0,  0,  0,  0,  0, CO, CO, CO, CO, CO, CO, CO, CO, /* 0x20 */
+    CD, CD, CD, CD, CD, CD, CD, CD, CD, CD,  0, CO, CE, CE, CE,  0, /* 0x30 */
+     0, CA, CA, CA, CA, CA, CA, CA, CA, CA, CA, CA, CA, CA, CA, CA, /* 0x40 */
+    CA, CA, CA, CA, CA, CA, CA, CA, CA, CA, CA,  0,  0,  0,  0, CA, /* 0x50 */
+     0, CA, CA, CA, CA, CA, CA, CA, CA, CA, CA, CA, CA, CA, CA, CA, /* 0x60 */
+    CA, CA, CA, CA, CA, CA, CA, CA, CA, CA, CA, CO,  0, CO,  0,  0, /* 0x70 */
+};
+
+#undef CA
+#undef CD
+#undef CB
+#undef CO
+#undef CE
+
+/// @brief Token of a CHAR_OPERATOR or CHAR_EQUALS character on its own
+static const uint8_t operatorToken[128] = {
+    ['('] = TOKEN_LEFT_PAREN, [')'] = TOKEN_RIGHT_PAREN,
+    ['{'] = TOKEN_LEFT_BRACE, ['}'] = TOKEN_RIGHT_BRACE,
+    [';'] = TOKEN_SEMICOLON,  [','] = TOKEN_COMMA,
+    ['.'] = TOKEN_DOT,        ['-'] = TOKEN_MINUS,
+    ['+'] = TOKEN_PLUS,       ['*'] = TOKEN_STAR,
+    ['/'] = TOKEN_SLASH,      ['!'] = TOKEN_BANG,
+    ['='] = TOKEN_EQUAL,      ['<'] = TOKEN_LESS,
+    ['>'] = TOKEN_GREATER,
+};
+
+/// @brief Token of a CHAR_EQUALS character followed by '='
+static const uint8_t equalsToken[128] = {
+    ['!'] = TOKEN_BANG_EQUAL,
+    ['='] = TOKEN_EQUAL_EQUAL,
+    ['<'] = TOKEN_LESS_EQUAL,
+    ['>'] = TOKEN_GREATER_EQUAL,
+};
+
 static Token makeToken(Scanner *scanner, TokenType type) {
   Token token;
   token.type = type;
@@ -25,18 +70,39 @@ static Token errorToken(Scanner *scanner, const char *message) {
   return token;
 }
 
+/**
+ * @brief Skip whitespace, newlines and `//` line comments.
+ *
+ * Newlines bump `scanner->line`. A comment runs up to (but not including) the
+ * next newline, so the newline is still counted on the next iteration.
+ *
+ * Runs of blanks and comment bodies go through the vectorized kernels; a
+ * single space between two tokens, by far the most common case, is skipped
+ * inline.
+ */
 static void skipWhitespace(Scanner *scanner) {
   for (;;) {
     char currentChar = peekChar(scanner);
 
-    switch (currentChar) {
-    case ' ':
-    case '\r':
-    case '\t':
-      advance(scanner);
-    default:
-      return; /// Not whitespace
+    if (isBlank(currentChar)) {
+      if (currentChar == ' ' && !isBlank(peekNextChar(scanner))) {
+        scanner->current++;
+        continue;
+      }
+      size_t newlines = 0;
+      scanner->current =
+          scanner->kernels->skipBlanks(scanner->current, &newlines);
+      scanner->line += newlines;
+      continue;
     }
+
+    if (currentChar == '/' && peekNextChar(scanner) == '/') {
+      /// Skip this line
+      scanner->current = scanner->kernels->findLineEnd(scanner->current + 2);
+      continue;
+    }
+
+    return; /// Not whitespace, or a lone '/' (the division operator)
   }
 }
 
@@ -61,115 +127,75 @@ static bool matchNext(Scanner *scanner, char expected) {
   }
 
   if (*scanner->current != expected) {
-    return true;
+    return false;
   }
 
   scanner->current++;
   return true;
 }
 
+/// @brief Slots in the keyword table, a power of two
+#define KEYWORD_SLOTS 32
+#define KEYWORD_MAX_LENGTH 6
+
 /**
- * @brief Check if the scanned token matches a keyword.
- *
- * This function compares the current token in the scanner with a specific
- * keyword. If it matches, the corresponding token type is returned;
- * otherwise, TOKEN_IDENTIFIER is returned.
- *
- * @param scanner The scanner instance containing the current token.
- * @param start The start index in the token to check.
- * @param length The length of the remaining part of the keyword to match.
- * @param rest Pointer to the string representing the remaining characters of
- *             the keyword.
- * @param type The token type to return if the keyword matches.
- *
- * @return The corresponding token type if matched, otherwise TOKEN_IDENTIFIER.
+ * @brief Perfect hash of a keyword from its first two characters and length.
  *
- * @example
- * // Check the keyword "and" when scanning the letter 'a'
- * checkKeyword(scanner, 1, 2, "nd", TOKEN_AND);
- *
- * // Check the keyword "fun" when scanning letters 'f' and 'u'
- * checkKeyword(scanner, 2, 1, "n", TOKEN_FUN);
- *
- * @note Implementation details:
- * - The length of the current token is calculated as scanner->current -
- * scanner->start
- * - The keyword length to compare is start + length
- * - Uses memcmp to compare the remaining characters
+ * The multipliers were picked so that the 16 keywords land in distinct slots.
+ * A new keyword that collides is caught at compile time: the two KEYWORD()
+ * entries initialize the same slot, which -Woverride-init reports.
  */
-static TokenType checkKeyword(Scanner *scanner, size_t start, size_t length,
-                              const char *rest, TokenType type) {
-  if ((size_t)(scanner->current - scanner->start) == (start + length) &&
-      memcmp(scanner->start + start, rest, length) == 0) {
-    return type;
-  }
-
-  return TOKEN_IDENTIFIER;
-}
+#define KEYWORD_HASH(first, second, length)                                    \
+  (((unsigned)(uint8_t)(first) + 2u * (unsigned)(uint8_t)(second) +            \
+    10u * (unsigned)(length)) &                                                \
+   (KEYWORD_SLOTS - 1))
+
+typedef struct Keyword {
+  const char *text; ///< Spelling
+  uint8_t length;   ///< strlen(text), 0 for an empty slot
+  uint8_t type;     ///< TokenType
+} Keyword;
+
+#define KEYWORD(first, second, word, tokenType)                                \
+  [KEYWORD_HASH(first, second, sizeof(word) - 1)] = {                          \
+      word, sizeof(word) - 1, tokenType}
+
+static const Keyword keywords[KEYWORD_SLOTS] = {
+    KEYWORD('a', 'n', "and", TOKEN_AND),
+    KEYWORD('c', 'l', "class", TOKEN_CLASS),
+    KEYWORD('e', 'l', "else", TOKEN_ELSE),
+    KEYWORD('f', 'a', "false", TOKEN_FALSE),
+    KEYWORD('f', 'o', "for", TOKEN_FOR),
+    KEYWORD('f', 'u', "fun", TOKEN_FUN),
+    KEYWORD('i', 'f', "if", TOKEN_IF),
+    KEYWORD('n', 'i', "nil", TOKEN_NIL),
+    KEYWORD('o', 'r', "or", TOKEN_OR),
+    KEYWORD('p', 'r', "print", TOKEN_PRINT),
+    KEYWORD('r', 'e', "return", TOKEN_RETURN),
+    KEYWORD('s', 'u', "super", TOKEN_SUPER),
+    KEYWORD('t', 'h', "this", TOKEN_THIS),
+    KEYWORD('t', 'r', "true", TOKEN_TRUE),
+    KEYWORD('v', 'a', "var", TOKEN_VAR),
+    KEYWORD('w', 'h', "while", TOKEN_WHILE),
+};
+
+#undef KEYWORD
 
 /**
- * @brief Determines the type of an identifier based on its starting character.
- * @param scanner the scanner instance
- * @note Using `default` in inner switches silences warnings,
- *  - but may hide missing keyword cases if new ones are added.
+ * @brief Keyword type of an identifier, or TOKEN_IDENTIFIER.
+ *
+ * One hash, one length check and one memcmp against the only candidate.
  */
-static TokenType resolveIdentifierType(Scanner *scanner) {
-  switch (scanner->start[0]) {
-  case 'a':
-    return checkKeyword(scanner, 1, 2, "nd", TOKEN_AND);
-  case 'c':
-    return checkKeyword(scanner, 1, 4, "less", TOKEN_CLASS);
-  case 'e':
-    return checkKeyword(scanner, 1, 3, "lse", TOKEN_ELSE);
-  case 'f': {
-    if (scanner->current - scanner->start > 1) {
-      switch (scanner->start[1]) {
-      case 'a':
-        return checkKeyword(scanner, 2, 3, "lse", TOKEN_FALSE);
-      case 'o':
-        return checkKeyword(scanner, 2, 1, "r", TOKEN_FOR);
-      case 'u':
-        return checkKeyword(scanner, 2, 1, "n", TOKEN_FUN);
-      default:
-        return TOKEN_IDENTIFIER;
-      }
-    }
-    break;
-  }
-  case 'i':
-    return checkKeyword(scanner, 1, 1, "f", TOKEN_IF);
-  case 'n':
-    return checkKeyword(scanner, 1, 2, "il", TOKEN_NIL);
-  case 'o':
-    return checkKeyword(scanner, 1, 1, "r", TOKEN_OR);
-  case 'p':
-    /// [WARN|INFO] into std
-    return checkKeyword(scanner, 1, 4, "rint", TOKEN_PRINT);
-  case 'r':
-    return checkKeyword(scanner, 1, 5, "eturn", TOKEN_RETURN);
-  case 's':
-    return checkKeyword(scanner, 1, 4, "uper", TOKEN_SUPER);
-  case 't': {
-    if (scanner->current - scanner->start > 1) {
-      switch (scanner->start[1]) {
-      case 'h':
-        return checkKeyword(scanner, 2, 2, "is", TOKEN_THIS);
-      case 'r':
-        return checkKeyword(scanner, 2, 2, "ue", TOKEN_TRUE);
-      default:
-        return TOKEN_IDENTIFIER;
-      }
-    }
-    break;
-  }
-  case 'v':
-    return checkKeyword(scanner, 1, 2, "ar", TOKEN_VAR);
-  case 'w':
-    return checkKeyword(scanner, 1, 4, "hile", TOKEN_WHILE);
-  default:
+TokenType identifierType(const char *start, size_t length) {
+  if (length < 2 || length > KEYWORD_MAX_LENGTH) {
     return TOKEN_IDENTIFIER;
   }
 
+  const Keyword *keyword = &keywords[KEYWORD_HASH(start[0], start[1], length)];
+  if (keyword->length == length &&
+      memcmp(keyword->text, start, length) == 0) {
+    return (TokenType)keyword->type;
+  }
   return TOKEN_IDENTIFIER;
 }
 
@@ -196,26 +222,26 @@ static TokenType resolveIdentifierType(Scanner *scanner) {
  * - consumed.
  */
 static Token scanIdentifier(Scanner *scanner) {
-  while (isLetter(scanner, peekChar(scanner)) ||
-         isNumberChar(scanner, peekChar(scanner))) {
+  while (hasCharClass(peekChar(scanner), CHAR_ALPHA | CHAR_DIGIT)) {
     /// include all chars, maybe is keyword or variable
     (void)advance(scanner);
   }
 
-  return makeToken(scanner, resolveIdentifierType(scanner));
+  size_t length = (size_t)(scanner->current - scanner->start);
+  return makeToken(scanner, identifierType(scanner->start, length));
 }
 
 static Token scanNumber(Scanner *scanner) {
-  while (isNumberChar(scanner, peekChar(scanner))) {
+  while (isNumberChar(peekChar(scanner))) {
     (void)advance(scanner);
   }
 
   /// Look for a fractional part
   if (peekChar(scanner) == '.' &&
-      isNumberChar(scanner, peekNextChar(scanner))) {
+      isNumberChar(peekNextChar(scanner))) {
     (void)advance(scanner);
 
-    while (isNumberChar(scanner, peekChar(scanner))) {
+    while (isNumberChar(peekChar(scanner))) {
       (void)advance(scanner);
     }
   }
@@ -224,13 +250,11 @@ static Token scanNumber(Scanner *scanner) {
 }
 
 static Token scanString(Scanner *scanner) {
-  /// Jump to the end of string
-  while (peekChar(scanner) != '"' && !isAtEnd(scanner)) {
-    if (peekChar(scanner) == '\n') {
-      scanner->line++;
-    }
-    (void)advance(scanner);
-  }
+  /// Jump to the end of string, counting the newlines inside it
+  size_t newlines = 0;
+  scanner->current =
+      scanner->kernels->findStringEnd(scanner->current, &newlines);
+  scanner->line += newlines;
 
   if (isAtEnd(scanner)) {
     return errorToken(scanner, "Unterminated string.");
@@ -246,6 +270,7 @@ void initScanner(Scanner *scanner, const char *source) {
   scanner->start = source;
   scanner->current = source;
   scanner->line = 1;
+  scanner->kernels = getScanKernels(bestScanKernel());
 }
 
 Token scanToken(Scanner *scanner) {
@@ -259,66 +284,27 @@ Token scanToken(Scanner *scanner) {
   }
 
   char currentChar = advance(scanner);
+  uint8_t charClass = scannerCharClass[(uint8_t)currentChar];
 
-  /// is....
-  if (isLetter(scanner, currentChar)) {
+  if (charClass & CHAR_ALPHA) {
     return scanIdentifier(scanner);
   }
-
-  /// is number?
-  if (isNumberChar(scanner, currentChar)) {
+  if (charClass & CHAR_DIGIT) {
     return scanNumber(scanner);
   }
-
-  switch (currentChar) {
-  case '(':
-    return makeToken(scanner, TOKEN_LEFT_PAREN);
-  case ')':
-    return makeToken(scanner, TOKEN_RIGHT_PAREN);
-  case '{':
-    return makeToken(scanner, TOKEN_LEFT_BRACE);
-  case '}':
-    return makeToken(scanner, TOKEN_RIGHT_BRACE);
-  case ';':
-    return makeToken(scanner, TOKEN_SEMICOLON);
-  case ',':
-    return makeToken(scanner, TOKEN_COMMA);
-  case '.':
-    return makeToken(scanner, TOKEN_DOT);
-  case '-':
-    return makeToken(scanner, TOKEN_MINUS);
-  case '+':
-    return makeToken(scanner, TOKEN_PLUS);
-  case '*':
-    return makeToken(scanner, TOKEN_STAR);
-  case '!':
-    return makeToken(scanner,
-                     matchNext(scanner, '=') ? TOKEN_BANG_EQUAL : TOKEN_BANG);
-  case '=':
-    return makeToken(scanner,
-                     matchNext(scanner, '=') ? TOKEN_EQUAL_EQUAL : TOKEN_EQUAL);
-  case '<':
-    return makeToken(scanner,
-                     matchNext(scanner, '=') ? TOKEN_LESS : TOKEN_LESS_EQUAL);
-  case '>':
-    return makeToken(scanner, matchNext(scanner, '=') ? TOKEN_GREATER
-                                                      : TOKEN_GREATER_EQUAL);
-  case '/': {
-    if (peekNextChar(scanner) == '/') {
-      /// Skip this line
-      while (peekChar(scanner) != '\n' && !isAtEnd(scanner)) {
-        /// Just advance
-        (void)advance(scanner);
-      }
-    } else {
-      return makeToken(scanner, TOKEN_SLASH);
-    }
-    break;
+  /// `//` comments were already consumed by skipWhitespace(), so '/' is an
+  /// operator here
+  if (charClass & CHAR_OPERATOR) {
+    return makeToken(scanner, (TokenType)operatorToken[(uint8_t)currentChar]);
+  }
+  if (charClass & CHAR_EQUALS) {
+    uint8_t type = matchNext(scanner, '=')
+                       ? equalsToken[(uint8_t)currentChar]
+                       : operatorToken[(uint8_t)currentChar];
+    return makeToken(scanner, (TokenType)type);
   }
-  case '"':
+  if (currentChar == '"') {
     return scanString(scanner);
-  default:
-    return errorToken(scanner, "Unexpected character.");
   }
 
   return errorToken(scanner, "Unexpected character.");
@@ -0,0 +1,171 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "clox/compiler/scanner_simd.h"
+#include "config.h"
+
+#if defined(CLOX_SCANNER_SIMD) && defined(__SSE2__)
+#define CLOX_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+static const char *skipBlanksScalar(const char *current, size_t *newlines) {
+  for (;; ++current) {
+    char c = *current;
+    if (c == '\n') {
+      (*newlines)++;
+    } else if (c != ' ' && c != '\t' && c != '\r') {
+      return current;
+    }
+  }
+}
+
+static const char *findLineEndScalar(const char *current) {
+  while (*current != '\n' && *current != '\0') {
+    current++;
+  }
+  return current;
+}
+
+static const char *findStringEndScalar(const char *current, size_t *newlines) {
+  for (;; ++current) {
+    char c = *current;
+    if (c == '"' || c == '\0') {
+      return current;
+    }
+    if (c == '\n') {
+      (*newlines)++;
+    }
+  }
+}
+
+#ifdef CLOX_SCAN_X86
+
+/**
+ * @brief Define the three kernels for one instruction set.
+ *
+ * `eqMask(block, c)` returns a bitmask with bit i set when `block[i] == c`,
+ * for a `width`-byte block. Scanning starts at the aligned block containing
+ * `current`; the bits for bytes before `current` are masked off with `before`.
+ * Aligned loads may read past the terminating '\0', but never past its page,
+ * hence no_sanitize_address.
+ */
+#define DEFINE_SCAN_KERNELS(isa, width, isaTarget, eqMask)                     \
+  __attribute__((isaTarget, no_sanitize_address)) static const char            \
+      *skipBlanks##isa(const char *current, size_t *newlines) {                \
+    size_t misalign = (uintptr_t)current % (width);                            \
+    const char *block = current - misalign;                                    \
+    uint64_t before = ((uint64_t)1 << misalign) - 1;                           \
+    for (;; block += (width), before = 0) {                                    \
+      uint64_t lines = eqMask(block, '\n') & ~before;                          \
+      uint64_t blank = eqMask(block, ' ') | eqMask(block, '\t') |              \
+                       eqMask(block, '\r') | lines | before;                   \
+      uint64_t stop = ~blank & (((uint64_t)1 << (width)) - 1);                 \
+      if (stop != 0) {                                                         \
+        uint64_t skipped = (stop & -stop) - 1;                                 \
+        *newlines += (size_t)__builtin_popcountll(lines & skipped);            \
+        return block + __builtin_ctzll(stop);                                  \
+      }                                                                        \
+      *newlines += (size_t)__builtin_popcountll(lines);                        \
+    }                                                                          \
+  }                                                                            \
+                                                                               \
+  __attribute__((isaTarget, no_sanitize_address)) static const char            \
+      *findLineEnd##isa(const char *current) {                                 \
+    size_t misalign = (uintptr_t)current % (width);                            \
+    const char *block = current - misalign;                                    \
+    uint64_t before = ((uint64_t)1 << misalign) - 1;                           \
+    for (;; block += (width), before = 0) {                                    \
+      uint64_t stop = (eqMask(block, '\n') | eqMask(block, '\0')) & ~before;   \
+      if (stop != 0) {                                                         \
+        return block + __builtin_ctzll(stop);                                  \
+      }                                                                        \
+    }                                                                          \
+  }                                                                            \
+                                                                               \
+  __attribute__((isaTarget, no_sanitize_address)) static const char            \
+      *findStringEnd##isa(const char *current, size_t *newlines) {             \
+    size_t misalign = (uintptr_t)current % (width);                            \
+    const char *block = current - misalign;                                    \
+    uint64_t before = ((uint64_t)1 << misalign) - 1;                           \
+    for (;; block += (width), before = 0) {                                    \
+      uint64_t lines = eqMask(block, '\n') & ~before;                          \
+      uint64_t stop = (eqMask(block, '"') | eqMask(block, '\0')) & ~before;    \
+      if (stop != 0) {                                                         \
+        uint64_t skipped = (stop & -stop) - 1;                                 \
+        *newlines += (size_t)__builtin_popcountll(lines & skipped);            \
+        return block + __builtin_ctzll(stop);                                  \
+      }                                                                        \
+      *newlines += (size_t)__builtin_popcountll(lines);                        \
+    }                                                                          \
+  }
+
+__attribute__((target("sse2"), always_inline)) static inline uint64_t
+eqMaskSSE2(const char *block, char c) {
+  __m128i bytes = _mm_load_si128((const __m128i *)(const void *)block);
+  __m128i hits = _mm_cmpeq_epi8(bytes, _mm_set1_epi8(c));
+  return (uint64_t)(uint32_t)_mm_movemask_epi8(hits);
+}
+
+__attribute__((target("avx2,popcnt"), always_inline)) static inline uint64_t
+eqMaskAVX2(const char *block, char c) {
+  __m256i bytes = _mm256_load_si256((const __m256i *)(const void *)block);
+  __m256i hits = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(c));
+  return (uint64_t)(uint32_t)_mm256_movemask_epi8(hits);
+}
+
+DEFINE_SCAN_KERNELS(SSE2, 16, target("sse2"), eqMaskSSE2)
+DEFINE_SCAN_KERNELS(AVX2, 32, target("avx2,popcnt"), eqMaskAVX2)
+
+#endif
+
+static const ScanKernels kernelTable[SCAN_KERNEL_COUNT] = {
+    [SCAN_KERNEL_SCALAR] = {skipBlanksScalar, findLineEndScalar,
+                            findStringEndScalar},
+#ifdef CLOX_SCAN_X86
+    [SCAN_KERNEL_SSE2] = {skipBlanksSSE2, findLineEndSSE2, findStringEndSSE2},
+    [SCAN_KERNEL_AVX2] = {skipBlanksAVX2, findLineEndAVX2, findStringEndAVX2},
+#endif
+};
+
+static const char *const kernelNames[SCAN_KERNEL_COUNT] = {
+    [SCAN_KERNEL_SCALAR] = "scalar",
+    [SCAN_KERNEL_SSE2] = "sse2",
+    [SCAN_KERNEL_AVX2] = "avx2",
+};
+
+bool scanKernelSupported(ScanKernel kernel) {
+  if (kernel == SCAN_KERNEL_SCALAR) {
+    return true;
+  }
+#ifdef CLOX_SCAN_X86
+  /// SSE2 is part of the x86-64 baseline (and of __SSE2__ builds)
+  if (kernel == SCAN_KERNEL_SSE2) {
+    return true;
+  }
+  if (kernel == SCAN_KERNEL_AVX2) {
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+  }
+#endif
+  return false;
+}
+
+const char *scanKernelName(ScanKernel kernel) {
+  return kernel < SCAN_KERNEL_COUNT ? kernelNames[kernel] : "unknown";
+}
+
+ScanKernel bestScanKernel(void) {
+  for (int kernel = SCAN_KERNEL_COUNT - 1; kernel > SCAN_KERNEL_SCALAR;
+       --kernel) {
+    if (scanKernelSupported((ScanKernel)kernel)) {
+      return (ScanKernel)kernel;
+    }
+  }
+  return SCAN_KERNEL_SCALAR;
+}
+
+const ScanKernels *getScanKernels(ScanKernel kernel) {
+  return &kernelTable[scanKernelSupported(kernel) ? kernel
+                                                  : SCAN_KERNEL_SCALAR];
+}
@@ -0,0 +1,207 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "clox/compiler/scanner.h"
+#include "clox/compiler/token_buffer.h"
+#include "clox/core/memory.h"
+
+#define TOKEN_BYTES_ESTIMATE 4 ///< Source bytes per token when presizing
+
+void initTokenBuffer(TokenBuffer *buffer, Arena *arena) {
+  buffer->source = NULL;
+  buffer->arena = arena;
+  buffer->count = 0;
+  buffer->capacity = 0;
+  buffer->types = NULL;
+  buffer->offsets = NULL;
+  buffer->lengths = NULL;
+  buffer->lines = NULL;
+  buffer->lineCount = 0;
+  buffer->lineCapacity = 0;
+  buffer->errors = NULL;
+  buffer->errorCount = 0;
+  buffer->errorCapacity = 0;
+}
+
+void freeTokenBuffer(TokenBuffer *buffer) {
+  if (buffer->arena == NULL) {
+    free_array(buffer->types, buffer->capacity, sizeof(uint8_t), MEM_COMPILER);
+    free_array(buffer->offsets, buffer->capacity, sizeof(uint32_t),
+               MEM_COMPILER);
+    free_array(buffer->lengths, buffer->capacity, sizeof(uint32_t),
+               MEM_COMPILER);
+    free_array(buffer->lines, buffer->lineCapacity, sizeof(TokenLine),
+               MEM_COMPILER);
+    free_array(buffer->errors, buffer->errorCapacity, sizeof(TokenError),
+               MEM_COMPILER);
+  }
+  initTokenBuffer(buffer, buffer->arena);
+}
+
+static void *growTokenArray(TokenBuffer *buffer, void *pointer,
+                            size_t oldCount, size_t newCount,
+                            size_t elemSize) {
+  if (buffer->arena != NULL) {
+    return arenaGrowArray(buffer->arena, pointer, oldCount, newCount,
+                          elemSize);
+  }
+  return grow_array(pointer, oldCount, newCount, elemSize, MEM_COMPILER);
+}
+
+/// @brief Grow the three token arrays together to at least `capacity`
+static void reserveTokenBuffer(TokenBuffer *buffer, size_t capacity) {
+  if (capacity <= buffer->capacity) {
+    return;
+  }
+  size_t oldCapacity = buffer->capacity;
+  buffer->capacity = capacity;
+  buffer->types = growTokenArray(buffer, buffer->types, oldCapacity,
+                                 capacity, sizeof(uint8_t));
+  buffer->offsets = growTokenArray(buffer, buffer->offsets, oldCapacity,
+                                   capacity, sizeof(uint32_t));
+  buffer->lengths = growTokenArray(buffer, buffer->lengths, oldCapacity,
+                                   capacity, sizeof(uint32_t));
+}
+
+static void pushTokenLine(TokenBuffer *buffer, TokenLine line) {
+  if (buffer->lineCount == buffer->lineCapacity) {
+    size_t capacity = grow_capacity(buffer->lineCapacity);
+    buffer->lines = growTokenArray(buffer, buffer->lines,
+                                   buffer->lineCapacity, capacity,
+                                   sizeof(TokenLine));
+    buffer->lineCapacity = capacity;
+  }
+  buffer->lines[buffer->lineCount++] = line;
+}
+
+static void pushTokenError(TokenBuffer *buffer, TokenError error) {
+  if (buffer->errorCount == buffer->errorCapacity) {
+    size_t capacity = grow_capacity(buffer->errorCapacity);
+    buffer->errors = growTokenArray(buffer, buffer->errors,
+                                    buffer->errorCapacity, capacity,
+                                    sizeof(TokenError));
+    buffer->errorCapacity = capacity;
+  }
+  buffer->errors[buffer->errorCount++] = error;
+}
+
+bool scanAll(const char *source, TokenBuffer *buffer) {
+  Scanner scanner;
+  initScanner(&scanner, source);
+  buffer->source = source;
+
+  /// Typical code has a token every few bytes; start near that, grow after
+  reserveTokenBuffer(buffer, strlen(source) / TOKEN_BYTES_ESTIMATE + 1);
+
+  size_t lastLine = 0;
+  for (;;) {
+    Token token = scanToken(&scanner);
+
+    /// Error tokens point at their message, the lexeme starts at scanner.start
+    size_t offset = (size_t)(scanner.start - source);
+    size_t length = token.type == TOKEN_ERROR ? 0 : token.length;
+    if (offset + length > UINT32_MAX || token.line > UINT32_MAX) {
+      return false;
+    }
+
+    if (buffer->count == buffer->capacity) {
+      reserveTokenBuffer(buffer, grow_capacity(buffer->capacity));
+    }
+    uint32_t index = (uint32_t)buffer->count++;
+    buffer->types[index] = (uint8_t)token.type;
+    buffer->offsets[index] = (uint32_t)offset;
+    buffer->lengths[index] = (uint32_t)length;
+
+    if (token.line != lastLine) {
+      TokenLine line = {.token = index, .line = (uint32_t)token.line};
+      pushTokenLine(buffer, line);
+      lastLine = token.line;
+    }
+    if (token.type == TOKEN_ERROR) {
+      TokenError error = {.token = index, .message = token.start};
+      pushTokenError(buffer, error);
+    }
+    if (token.type == TOKEN_EOF) {
+      return true;
+    }
+  }
+}
+
+/// @brief Index of the last TokenLine at or before token `index`
+static size_t findTokenLine(const TokenBuffer *buffer, size_t index) {
+  const TokenLine *lines = buffer->lines;
+  size_t low = 0;
+  size_t high = buffer->lineCount;
+
+  while (high - low > 1) {
+    size_t mid = low + (high - low) / 2;
+    if (lines[mid].token <= index) {
+      low = mid;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+static const char *tokenError(const TokenBuffer *buffer, size_t index) {
+  const TokenError *errors = buffer->errors;
+  size_t low = 0;
+  size_t high = buffer->errorCount;
+
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (errors[mid].token < index) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return errors[low].message;
+}
+
+static Token makeBufferedToken(const TokenBuffer *buffer, size_t index,
+                               size_t line) {
+  Token token;
+  token.type = (TokenType)buffer->types[index];
+  token.line = line;
+
+  if (token.type == TOKEN_ERROR) {
+    token.start = tokenError(buffer, index);
+    token.length = strlen(token.start);
+  } else {
+    token.start = buffer->source + buffer->offsets[index];
+    token.length = buffer->lengths[index];
+  }
+  return token;
+}
+
+Token tokenAt(const TokenBuffer *buffer, size_t index) {
+  return makeBufferedToken(buffer, index,
+                           buffer->lines[findTokenLine(buffer, index)].line);
+}
+
+void initTokenCursor(TokenCursor *cursor, const TokenBuffer *buffer) {
+  cursor->buffer = buffer;
+  cursor->index = 0;
+  cursor->lineRecord = 0;
+}
+
+Token nextToken(TokenCursor *cursor) {
+  const TokenBuffer *buffer = cursor->buffer;
+  const TokenLine *lines = buffer->lines;
+
+  /// Stay on the final TOKEN_EOF
+  size_t index = cursor->index;
+  if (index + 1 < buffer->count) {
+    cursor->index++;
+  }
+
+  while (cursor->lineRecord + 1 < buffer->lineCount &&
+         lines[cursor->lineRecord + 1].token <= index) {
+    cursor->lineRecord++;
+  }
+  return makeBufferedToken(buffer, index, lines[cursor->lineRecord].line);
+}
@@ -0,0 +1,605 @@
+/// mmap(), open() and friends are POSIX, not C11
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "clox/core/cache.h"
+#include "clox/core/chunk.h"
+#include "clox/core/globals.h"
+#include "clox/core/object.h"
+#include "clox/core/value.h"
+#include "config.h"
+
+#define CACHE_BYTE_ORDER 0x0102
+#define CACHE_ALIGNMENT 8
+
+_Static_assert(sizeof(CLOX_VERSION) <= CACHE_VERSION_SIZE,
+               "CLOX_VERSION does not fit in the cache header");
+
+/// @brief 64-bit FNV-1a
+static uint64_t hashBytes(const uint8_t *bytes, size_t length) {
+  uint64_t hash = 14695981039346656037u;
+  for (size_t i = 0; i < length; ++i) {
+    hash ^= bytes[i];
+    hash *= 1099511628211u;
+  }
+  return hash;
+}
+
+uint64_t hashSource(const char *source, size_t length) {
+  return hashBytes((const uint8_t *)source, length);
+}
+
+/// @brief Cache file path for a script, to be released with free()
+char *cachePathFor(const char *scriptPath) {
+  size_t length = strlen(scriptPath);
+  size_t extension = sizeof(CACHE_EXTENSION); /// Includes the NUL
+  char *path = malloc(length + extension);
+  if (path == NULL) {
+    return NULL;
+  }
+  memcpy(path, scriptPath, length);
+  memcpy(path + length, CACHE_EXTENSION, extension);
+  return path;
+}
+
+static uint64_t alignOffset(uint64_t offset) {
+  return (offset + CACHE_ALIGNMENT - 1) & ~(uint64_t)(CACHE_ALIGNMENT - 1);
+}
+
+/// @brief Header fields that identify the producer and the source
+static void fillHeaderKey(CacheHeader *header, const char *source,
+                          size_t length) {
+  memcpy(header->magic, CACHE_MAGIC, sizeof(header->magic));
+  header->formatVersion = CACHE_FORMAT_VERSION;
+  header->byteOrder = CACHE_BYTE_ORDER;
+  memset(header->version, 0, sizeof(header->version));
+  memcpy(header->version, CLOX_VERSION, sizeof(CLOX_VERSION));
+  header->sourceHash = hashSource(source, length);
+  header->sourceLength = length;
+}
+
+/// @brief Whether [offset, offset + count * size) lies inside the file
+static bool sectionInBounds(uint64_t offset, uint64_t count, uint64_t size,
+                            size_t fileSize) {
+  if (offset % CACHE_ALIGNMENT != 0 || offset > fileSize) {
+    return false;
+  }
+  return count <= (fileSize - offset) / size;
+}
+
+/// @brief Values the instruction at `code` pops and pushes
+static void stackEffect(const uint8_t *code, size_t *pops, size_t *pushes) {
+  switch (code[0]) {
+  case OP_CONSTANT:
+  case OP_CONSTANT_LONG:
+  case OP_NIL:
+  case OP_TRUE:
+  case OP_FALSE:
+    *pops = 0;
+    *pushes = 1;
+    return;
+  case OP_CONSTANT_CONSTANT:
+    *pops = 0;
+    *pushes = 2;
+    return;
+  case OP_GET_GLOBAL:
+    *pops = 0;
+    *pushes = 1;
+    return;
+  case OP_CLASS:
+  case OP_GET_PROPERTY:
+    *pops = 1;
+    *pushes = 1;
+    return;
+  case OP_SET_PROPERTY:
+    *pops = 2;
+    *pushes = 1;
+    return;
+  case OP_POP:
+  case OP_PRINT:
+  case OP_DEFINE_GLOBAL:
+    *pops = 1;
+    *pushes = 0;
+    return;
+  case OP_NOT:
+  case OP_NEGATE:
+  case OP_SET_GLOBAL:
+  case OP_ADD_CONSTANT:
+  case OP_SUBTRACT_CONSTANT:
+  case OP_MULTIPLY_CONSTANT:
+  case OP_DIVIDE_CONSTANT:
+    *pops = 1;
+    *pushes = 1;
+    return;
+  case OP_EQUAL:
+  case OP_GREATER:
+  case OP_LESS:
+  case OP_ADD:
+  case OP_SUBTRACT:
+  case OP_MULTIPLY:
+  case OP_DIVIDE:
+    *pops = 2;
+    *pushes = 1;
+    return;
+  case OP_CALL:
+    *pops = (size_t)code[1] + 1; /// The arguments and the callee
+    *pushes = 1;
+    return;
+  case OP_INVOKE:
+    *pops = (size_t)code[3] + 1; /// The arguments and the receiver
+    *pushes = 1;
+    return;
+  default:
+    *pops = 0;
+    *pushes = 0;
+    return;
+  }
+}
+
+/// @brief The 16-bit little-endian operand of the instruction at `code`
+static size_t shortOperand(const uint8_t *code) {
+  return (size_t)code[1] | ((size_t)code[2] << 8);
+}
+
+/**
+ * @brief Every instruction must be known, its operands in range and the
+ * stack must never underflow.
+ *
+ * The VM trusts the compiler never to pop an empty stack, so code from disk
+ * has to be checked for it. Without jumps, one linear pass is exact. Global
+ * slots must be below `globalsLimit`, which the chunk's globals guarantee to
+ * exist once they are resolved, and cache operands below `cachesCount`.
+ */
+static bool validCode(const uint8_t *code, size_t count,
+                      size_t constantsCount, size_t cachesCount,
+                      size_t globalsLimit) {
+  size_t offset = 0;
+  size_t depth = 0;
+  uint8_t last = OP_RETURN;
+
+  while (offset < count) {
+    uint8_t instruction = code[offset];
+    size_t length = instructionLength(instruction);
+    if (length == 0 || length > count - offset) {
+      return false;
+    }
+
+    /// Apart from OP_CONSTANT_LONG's, global slots, cache indices and
+    /// argument counts, every operand is an 8-bit pool index
+    if (instruction == OP_CALL) {
+      /// Any argument count, the stack check below bounds it
+    } else if (instruction == OP_DEFINE_GLOBAL ||
+               instruction == OP_GET_GLOBAL ||
+               instruction == OP_SET_GLOBAL) {
+      if (shortOperand(code + offset) >= globalsLimit) {
+        return false;
+      }
+    } else if (instruction == OP_GET_PROPERTY ||
+               instruction == OP_SET_PROPERTY || instruction == OP_INVOKE) {
+      if (shortOperand(code + offset) >= cachesCount) {
+        return false;
+      }
+    } else if (instruction != OP_CONSTANT_LONG) {
+      for (size_t i = 1; i < length; ++i) {
+        if (code[offset + i] >= constantsCount) {
+          return false;
+        }
+      }
+    } else {
+      size_t constant = (size_t)code[offset + 1] |
+                        ((size_t)code[offset + 2] << 8) |
+                        ((size_t)code[offset + 3] << 16);
+      if (constant >= constantsCount) {
+        return false;
+      }
+    }
+
+    size_t pops, pushes;
+    stackEffect(code + offset, &pops, &pushes);
+    if (pops > depth) {
+      return false;
+    }
+    depth = depth - pops + pushes;
+
+    last = instruction;
+    offset += length;
+  }
+
+  /// The VM has no end-of-code check, it stops at OP_RETURN
+  return count > 0 && last == OP_RETURN;
+}
+
+/// @brief Line runs must start at 0 and be strictly increasing
+static bool validLines(const CacheLine *lines, size_t count, size_t codeCount) {
+  if (count == 0 || lines[0].start != 0) {
+    return false;
+  }
+  for (size_t i = 1; i < count; ++i) {
+    if (lines[i].start <= lines[i - 1].start || lines[i].start >= codeCount) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// @brief One past the largest slot of the global records, 0 if invalid
+static size_t globalsLimit(const uint8_t *base, const CacheHeader *header) {
+  const CacheGlobal *globals =
+      (const CacheGlobal *)(const void *)(base + header->globalsOffset);
+  size_t limit = 0;
+  for (size_t i = 0; i < header->globalsCount; ++i) {
+    if (globals[i].slot >= GLOBALS_MAX) {
+      return 0;
+    }
+    if (globals[i].slot >= limit) {
+      limit = (size_t)globals[i].slot + 1;
+    }
+  }
+  return limit;
+}
+
+/// @brief The string bytes of a validated mapping
+typedef struct CacheStrings {
+  const char *chars;
+  size_t count;
+} CacheStrings;
+
+/// @brief Intern the string a CACHE_STRING payload points at, if in bounds
+static bool decodeString(uint64_t payload, const CacheStrings *strings,
+                         Heap *heap, Value *out) {
+  uint64_t start = payload & UINT32_MAX;
+  uint64_t length = payload >> 32;
+  if (start > strings->count || length > strings->count - start) {
+    return false;
+  }
+  *out = OBJ_VAL(copyString(heap, strings->chars + start, (size_t)length));
+  return true;
+}
+
+static bool decodeConstant(const CacheConstant *constant,
+                           const CacheStrings *strings, Heap *heap,
+                           Value *out) {
+  double number;
+
+  if (constant->type == CACHE_STRING) {
+    return decodeString(constant->payload, strings, heap, out);
+  } else if (constant->type == CACHE_NIL) {
+    *out = NIL_VAL;
+  } else if (constant->type == CACHE_BOOL) {
+    *out = BOOL_VAL(constant->payload != 0);
+  } else if (constant->type == CACHE_NUMBER) {
+    memcpy(&number, &constant->payload, sizeof(number));
+    *out = NUMBER_VAL(number);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Serialize `value`, appending string characters at `*stringsCount`.
+ *
+ * With `strings` NULL only `*stringsCount` advances, to size the section.
+ */
+static bool encodeConstant(Value value, CacheConstant *out, uint8_t *strings,
+                           size_t *stringsCount) {
+  double number;
+
+  memset(out, 0, sizeof(*out));
+  if (IS_STRING(value)) {
+    const ObjString *string = AS_STRING(value);
+    if (*stringsCount > UINT32_MAX || string->length > UINT32_MAX) {
+      return false; /// Does not fit the payload
+    }
+    out->type = CACHE_STRING;
+    out->payload = (uint64_t)string->length << 32 | *stringsCount;
+    if (strings != NULL) {
+      memcpy(strings + *stringsCount, string->chars, string->length);
+    }
+    *stringsCount += string->length;
+  } else if (IS_NIL(value)) {
+    out->type = CACHE_NIL;
+  } else if (IS_BOOL(value)) {
+    out->type = CACHE_BOOL;
+    out->payload = AS_BOOL(value) ? 1 : 0;
+  } else if (IS_NUMBER(value)) {
+    out->type = CACHE_NUMBER;
+    number = AS_NUMBER(value);
+    memcpy(&out->payload, &number, sizeof(number));
+  } else {
+    return false; /// No other object appears in chunks
+  }
+  return true;
+}
+
+/**
+ * @brief Decode the sections of a validated mapping into `chunk`.
+ *
+ * Fails if a global does not resolve to its recorded slot in `globals`.
+ */
+static bool decodeChunk(const uint8_t *base, const CacheHeader *header,
+                        Heap *heap, Globals *globals, Chunk *chunk) {
+  initChunk(chunk);
+  CacheStrings strings = {
+      .chars = (const char *)(base + header->stringsOffset),
+      .count = header->stringsCount,
+  };
+
+  const CacheConstant *constants =
+      (const CacheConstant *)(const void *)(base + header->constantsOffset);
+  reserveDynArray(&chunk->constants, header->constantsCount);
+  for (size_t i = 0; i < header->constantsCount; ++i) {
+    Value value;
+    if (!decodeConstant(&constants[i], &strings, heap, &value)) {
+      return false;
+    }
+    pushValueDynArray(&chunk->constants, value);
+  }
+
+  const CacheLine *lines =
+      (const CacheLine *)(const void *)(base + header->linesOffset);
+  reserveDynArray(&chunk->lines, header->linesCount);
+  for (size_t i = 0; i < header->linesCount; ++i) {
+    LineRecord record = {.line = lines[i].line, .start = lines[i].start};
+    pushLineDynArray(&chunk->lines, record);
+  }
+
+  const CacheConstant *caches =
+      (const CacheConstant *)(const void *)(base + header->cachesOffset);
+  reserveDynArray(&chunk->caches, header->cachesCount);
+  for (size_t i = 0; i < header->cachesCount; ++i) {
+    Value name;
+    if (caches[i].type != CACHE_STRING ||
+        !decodeString(caches[i].payload, &strings, heap, &name)) {
+      return false;
+    }
+    (void)addInlineCache(chunk, AS_STRING(name));
+  }
+
+  const CacheGlobal *records =
+      (const CacheGlobal *)(const void *)(base + header->globalsOffset);
+  reserveDynArray(&chunk->globals, header->globalsCount);
+  for (size_t i = 0; i < header->globalsCount; ++i) {
+    Value name;
+    if (!decodeString(records[i].name, &strings, heap, &name) ||
+        resolveGlobal(globals, AS_STRING(name)) != records[i].slot) {
+      return false;
+    }
+    addChunkGlobal(chunk, AS_STRING(name), (uint32_t)records[i].slot);
+  }
+
+  /// Borrow the code straight from the mapping
+  chunk->code.data = (void *)(uintptr_t)(base + header->codeOffset);
+  chunk->code.count = header->codeCount;
+  chunk->code.capacity = 0;
+  return true;
+}
+
+static bool validHeader(const CacheHeader *header, const char *source,
+                        size_t length, size_t fileSize) {
+  CacheHeader expected;
+  fillHeaderKey(&expected, source, length);
+
+  if (memcmp(header->magic, expected.magic, sizeof(header->magic)) != 0 ||
+      header->formatVersion != expected.formatVersion ||
+      header->byteOrder != expected.byteOrder ||
+      memcmp(header->version, expected.version, sizeof(header->version)) !=
+          0 ||
+      header->sourceLength != expected.sourceLength ||
+      header->sourceHash != expected.sourceHash) {
+    return false; /// Foreign or stale
+  }
+
+  return sectionInBounds(header->codeOffset, header->codeCount, 1, fileSize) &&
+         sectionInBounds(header->constantsOffset, header->constantsCount,
+                         sizeof(CacheConstant), fileSize) &&
+         sectionInBounds(header->linesOffset, header->linesCount,
+                         sizeof(CacheLine), fileSize) &&
+         sectionInBounds(header->cachesOffset, header->cachesCount,
+                         sizeof(CacheConstant), fileSize) &&
+         sectionInBounds(header->globalsOffset, header->globalsCount,
+                         sizeof(CacheGlobal), fileSize) &&
+         sectionInBounds(header->stringsOffset, header->stringsCount, 1,
+                         fileSize);
+}
+
+/// @brief Catch bit flips that still decode to plausible bytecode
+static bool validPayload(const uint8_t *base, const CacheHeader *header,
+                         size_t fileSize) {
+  return hashBytes(base + sizeof(CacheHeader),
+                   fileSize - sizeof(CacheHeader)) == header->payloadHash;
+}
+
+bool loadCachedChunk(const char *cachePath, const char *source, size_t length,
+                     Heap *heap, Globals *globals, CachedChunk *out) {
+  int fd = open(cachePath, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(CacheHeader)) {
+    close(fd);
+    return false;
+  }
+
+  size_t fileSize = (size_t)info.st_size;
+  void *mapping = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  /// The mapping keeps the file alive on its own
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    return false;
+  }
+
+  const uint8_t *base = (const uint8_t *)mapping;
+  const CacheHeader *header = (const CacheHeader *)mapping;
+
+  if (!validHeader(header, source, length, fileSize) ||
+      !validPayload(base, header, fileSize) ||
+      !validCode(base + header->codeOffset, header->codeCount,
+                 header->constantsCount, header->cachesCount,
+                 globalsLimit(base, header)) ||
+      !validLines((const CacheLine *)(const void *)(base + header->linesOffset),
+                  header->linesCount, header->codeCount)) {
+    munmap(mapping, fileSize);
+    return false;
+  }
+
+  out->mapping = mapping;
+  out->mappingSize = fileSize;
+  if (!decodeChunk(base, header, heap, globals, &out->chunk)) {
+    freeCachedChunk(out);
+    return false;
+  }
+  return true;
+}
+
+void freeCachedChunk(CachedChunk *cached) {
+  /// Only the decoded sections are owned, the code belongs to the mapping
+  freeDynArray(&cached->chunk.constants);
+  freeDynArray(&cached->chunk.lines);
+  freeDynArray(&cached->chunk.globals);
+  freeDynArray(&cached->chunk.caches);
+  initDynArray(&cached->chunk.code, sizeof(uint8_t), MEM_CHUNK_CODE);
+
+  if (cached->mapping != NULL) {
+    munmap(cached->mapping, cached->mappingSize);
+  }
+  cached->mapping = NULL;
+  cached->mappingSize = 0;
+}
+
+/**
+ * @brief Encode every constant, global and inline cache name of `chunk`.
+ *
+ * With `buffer` NULL nothing is written: this only checks that the chunk can
+ * be cached and counts the string bytes into `header->stringsCount`.
+ */
+static bool encodeConstants(uint8_t *buffer, CacheHeader *header,
+                            const Chunk *chunk) {
+  uint8_t *strings = buffer != NULL ? buffer + header->stringsOffset : NULL;
+  size_t stringsCount = 0;
+  CacheConstant constant;
+
+  const Value *values = (const Value *)chunk->constants.data;
+  for (size_t i = 0; i < chunk->constants.count; ++i) {
+    if (!encodeConstant(values[i], &constant, strings, &stringsCount)) {
+      return false;
+    }
+    if (buffer != NULL) {
+      memcpy(buffer + header->constantsOffset + i * sizeof(constant),
+             &constant, sizeof(constant));
+    }
+  }
+
+  for (size_t i = 0; i < chunk->caches.count; ++i) {
+    if (!encodeConstant(OBJ_VAL(chunkCache(chunk, i)->name), &constant,
+                        strings, &stringsCount)) {
+      return false;
+    }
+    if (buffer != NULL) {
+      memcpy(buffer + header->cachesOffset + i * sizeof(constant), &constant,
+             sizeof(constant));
+    }
+  }
+
+  for (size_t i = 0; i < chunk->globals.count; ++i) {
+    const ChunkGlobal *global = chunkGlobal(chunk, i);
+    if (!encodeConstant(OBJ_VAL(global->name), &constant, strings,
+                        &stringsCount)) {
+      return false;
+    }
+    if (buffer != NULL) {
+      CacheGlobal record = {.name = constant.payload, .slot = global->slot};
+      memcpy(buffer + header->globalsOffset + i * sizeof(record), &record,
+             sizeof(record));
+    }
+  }
+
+  header->stringsCount = stringsCount;
+  return true;
+}
+
+/// @brief Lay out the whole cache file in `buffer` (zero-initialized)
+static void serializeChunk(uint8_t *buffer, CacheHeader *header,
+                           const Chunk *chunk) {
+  memcpy(buffer + header->codeOffset, chunk->code.data, chunk->code.count);
+  /// Already checked by the sizing pass
+  encodeConstants(buffer, header, chunk);
+
+  const LineRecord *records = (const LineRecord *)chunk->lines.data;
+  uint8_t *lines = buffer + header->linesOffset;
+  for (size_t i = 0; i < chunk->lines.count; ++i) {
+    CacheLine line = {.line = records[i].line, .start = records[i].start};
+    memcpy(lines + i * sizeof(line), &line, sizeof(line));
+  }
+
+  size_t fileSize = header->stringsOffset + header->stringsCount;
+  header->payloadHash = hashBytes(buffer + sizeof(CacheHeader),
+                                  fileSize - sizeof(CacheHeader));
+  memcpy(buffer, header, sizeof(*header));
+}
+
+bool saveCachedChunk(const char *cachePath, const Chunk *chunk,
+                     const char *source, size_t length) {
+  CacheHeader header;
+  fillHeaderKey(&header, source, length);
+  header.codeOffset = sizeof(CacheHeader);
+  header.codeCount = chunk->code.count;
+  header.constantsOffset = alignOffset(header.codeOffset + header.codeCount);
+  header.constantsCount = chunk->constants.count;
+  header.linesOffset =
+      header.constantsOffset + header.constantsCount * sizeof(CacheConstant);
+  header.linesCount = chunk->lines.count;
+  header.cachesOffset =
+      header.linesOffset + header.linesCount * sizeof(CacheLine);
+  header.cachesCount = chunk->caches.count;
+  header.globalsOffset =
+      header.cachesOffset + header.cachesCount * sizeof(CacheConstant);
+  header.globalsCount = chunk->globals.count;
+  header.stringsOffset =
+      header.globalsOffset + header.globalsCount * sizeof(CacheGlobal);
+  if (!encodeConstants(NULL, &header, chunk)) {
+    return false;
+  }
+
+  size_t fileSize = header.stringsOffset + header.stringsCount;
+  uint8_t *buffer = calloc(fileSize, 1);
+  if (buffer == NULL) {
+    return false;
+  }
+  serializeChunk(buffer, &header, chunk);
+
+  /// Unique per process, so concurrent writers never share a temporary
+  size_t tempSize = strlen(cachePath) + 32;
+  char *tempPath = malloc(tempSize);
+  if (tempPath == NULL) {
+    free(buffer);
+    return false;
+  }
+  snprintf(tempPath, tempSize, "%s.%ld.tmp", cachePath, (long)getpid());
+
+  FILE *file = fopen(tempPath, "wb");
+  bool written = file != NULL && fwrite(buffer, 1, fileSize, file) == fileSize;
+  if (file != NULL) {
+    written = (fclose(file) == 0) && written;
+  }
+  if (!written || rename(tempPath, cachePath) != 0) {
+    remove(tempPath);
+    written = false;
+  }
+
+  free(tempPath);
+  free(buffer);
+  return written;
+}
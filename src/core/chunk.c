@@ -2,52 +2,239 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "clox/core/chunk.h"
+#include "clox/core/inline_cache.h"
 #include "clox/core/value.h"
 #include "clox/utils/dynarr.h"
 
 void initChunk(Chunk *chunk) {
-  initDynArray(&chunk->code, sizeof(uint8_t));
-  initDynArray(&chunk->lines, sizeof(LineRecord));
-  initDynArray(&chunk->constants, sizeof(Value));
+  initDynArray(&chunk->code, sizeof(uint8_t), MEM_CHUNK_CODE);
+  initDynArray(&chunk->lines, sizeof(LineRecord), MEM_CHUNK_LINES);
+  initDynArray(&chunk->constants, sizeof(Value), MEM_CHUNK_CONSTANTS);
+  initDynArray(&chunk->globals, sizeof(ChunkGlobal), MEM_CHUNK_GLOBALS);
+  initDynArray(&chunk->caches, sizeof(InlineCache), MEM_CHUNK_CACHES);
+  chunk->tenured = false;
+  chunk->markedCycle = 0;
 }
 
 void writeChunk(Chunk *chunk, uint8_t byte, size_t line) {
-  pushDynArray(&chunk->code, &byte);
+  pushByteDynArray(&chunk->code, byte);
 
   LineRecord *lines = (LineRecord *)chunk->lines.data;
 
-  if (chunk->lines.count > 0 && lines[chunk->lines.count - 1].line == line) {
-    lines[chunk->lines.count - 1].count++;
-  } else {
-    LineRecord rec = {.line = line, .count = 1};
-    pushDynArray(&chunk->lines, &rec);
+  /// Only a change of line starts a new run
+  if (chunk->lines.count == 0 || lines[chunk->lines.count - 1].line != line) {
+    LineRecord rec = {.line = line, .start = chunk->code.count - 1};
+    pushLineDynArray(&chunk->lines, rec);
   }
 }
 
 /// @brief Return the index of constants in the constant pool
 size_t addConstant(Chunk *chunk, Value value) {
-  pushDynArray(&chunk->constants, &value);
+  pushValueDynArray(&chunk->constants, value);
+  chunk->tenured = false;
+  chunk->markedCycle = 0;
   return chunk->constants.count - 1;
 }
 
+/// @note The compiler deduplicates, a chunk can use thousands of globals
+void addChunkGlobal(Chunk *chunk, ObjString *name, uint32_t slot) {
+  ChunkGlobal global = {.name = name, .slot = slot};
+  pushDynArray(&chunk->globals, &global);
+  chunk->tenured = false;
+  chunk->markedCycle = 0;
+}
+
+/// @note Never shared: each site learns the shapes it sees by itself
+size_t addInlineCache(Chunk *chunk, ObjString *name) {
+  InlineCache cache;
+  initInlineCache(&cache, name);
+  pushDynArray(&chunk->caches, &cache);
+  chunk->tenured = false;
+  chunk->markedCycle = 0;
+  return chunk->caches.count - 1;
+}
+
+/// @brief Index of the run containing `instructionsIndex` (binary search)
+static size_t findLineRecord(const Chunk *chunk, size_t instructionsIndex) {
+  const LineRecord *lines = (const LineRecord *)chunk->lines.data;
+  size_t low = 0;
+  size_t high = chunk->lines.count;
+
+  /// Find the last run with start <= instructionsIndex
+  while (high - low > 1) {
+    size_t mid = low + (high - low) / 2;
+    if (lines[mid].start <= instructionsIndex) {
+      low = mid;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+/**
+ * @brief Remove `count` bytes of code starting at `start`, keeping the line
+ * table in sync.
+ *
+ * Used by the compiler to rewrite instructions it has just emitted. Runs that
+ * become empty are dropped and neighbours on the same line are merged, so the
+ * table stays run-length encoded and sorted. Only runs from the one containing
+ * `start` onwards are touched, so erasing near the end is cheap.
+ */
+void eraseChunk(Chunk *chunk, size_t start, size_t count) {
+  if (start >= chunk->code.count || count == 0) {
+    return;
+  }
+  if (count > chunk->code.count - start) {
+    count = chunk->code.count - start;
+  }
+
+  uint8_t *code = (uint8_t *)chunk->code.data;
+  memmove(code + start, code + start + count,
+          chunk->code.count - start - count);
+  chunk->code.count -= count;
+
+  /// Shift run starts past the erased range; runs inside it collapse onto
+  /// `start` and are then dropped in favour of the run that follows them.
+  LineRecord *lines = (LineRecord *)chunk->lines.data;
+  size_t end = start + count;
+  size_t first = findLineRecord(chunk, start);
+  size_t kept = first;
+
+  for (size_t i = first; i < chunk->lines.count; ++i) {
+    LineRecord rec = lines[i];
+    if (rec.start >= end) {
+      rec.start -= count;
+    } else if (rec.start > start) {
+      rec.start = start;
+    }
+
+    if (rec.start >= chunk->code.count) {
+      break; /// Nothing of this run is left
+    }
+    if (kept > 0 && lines[kept - 1].start == rec.start) {
+      kept--; /// The previous run became empty
+    }
+    if (kept > 0 && lines[kept - 1].line == rec.line) {
+      continue; /// Same line as the previous run, merge
+    }
+    lines[kept++] = rec;
+  }
+  chunk->lines.count = kept;
+}
+
+/// @brief Drop every byte of code from `count` on
+void truncateChunk(Chunk *chunk, size_t count) {
+  if (count < chunk->code.count) {
+    eraseChunk(chunk, count, chunk->code.count - count);
+  }
+}
+
+void shrinkChunk(Chunk *chunk) {
+  shrinkToFitDynArray(&chunk->code);
+  shrinkToFitDynArray(&chunk->constants);
+  shrinkToFitDynArray(&chunk->lines);
+  shrinkToFitDynArray(&chunk->globals);
+  shrinkToFitDynArray(&chunk->caches);
+}
+
 void freeChunk(Chunk *chunk) {
   freeDynArray(&chunk->code);
   freeDynArray(&chunk->constants);
   freeDynArray(&chunk->lines);
+  freeDynArray(&chunk->globals);
+  freeDynArray(&chunk->caches);
+}
+
+/**
+ * @brief Size in bytes of an instruction (opcode plus operands).
+ *
+ * @return 0 if `instruction` is not a known opcode.
+ */
+size_t instructionLength(uint8_t instruction) {
+  switch (instruction) {
+  case OP_CONSTANT:
+  case OP_CALL:
+  case OP_ADD_CONSTANT:
+  case OP_SUBTRACT_CONSTANT:
+  case OP_MULTIPLY_CONSTANT:
+  case OP_DIVIDE_CONSTANT:
+    return 2;
+  case OP_CONSTANT_CONSTANT:
+  case OP_DEFINE_GLOBAL:
+  case OP_GET_GLOBAL:
+  case OP_SET_GLOBAL:
+  case OP_GET_PROPERTY:
+  case OP_SET_PROPERTY:
+    return 3;
+  case OP_CONSTANT_LONG:
+  case OP_INVOKE:
+    return 4;
+  case OP_NIL:
+  case OP_TRUE:
+  case OP_FALSE:
+  case OP_POP:
+  case OP_EQUAL:
+  case OP_GREATER:
+  case OP_LESS:
+  case OP_ADD:
+  case OP_SUBTRACT:
+  case OP_MULTIPLY:
+  case OP_DIVIDE:
+  case OP_NOT:
+  case OP_NEGATE:
+  case OP_PRINT:
+  case OP_RETURN:
+  case OP_CLASS:
+    return 1;
+  default:
+    return 0;
+  }
 }
 
+/// @brief Source line of the instruction at `instructionsIndex`, O(log n)
 size_t getLine(const Chunk *chunk, size_t instructionsIndex) {
-  LineRecord *lines = (LineRecord *)chunk->lines.data;
-  size_t offset = 0;
+  if (chunk->lines.count == 0 || instructionsIndex >= chunk->code.count) {
+    return 0;
+  }
+
+  const LineRecord *lines = (const LineRecord *)chunk->lines.data;
+  return lines[findLineRecord(chunk, instructionsIndex)].line;
+}
+
+void initLineIterator(LineIterator *iterator, const Chunk *chunk) {
+  iterator->chunk = chunk;
+  iterator->record = 0;
+}
+
+/**
+ * @brief Move the iterator to `instructionsIndex` and return its line.
+ *
+ * O(1) when the offset is in the current or the next run, which is always the
+ * case when walking the code in order.
+ */
+size_t lineIteratorSeek(LineIterator *iterator, size_t instructionsIndex) {
+  const Chunk *chunk = iterator->chunk;
+  if (chunk->lines.count == 0 || instructionsIndex >= chunk->code.count) {
+    return 0;
+  }
+
+  const LineRecord *lines = (const LineRecord *)chunk->lines.data;
+  size_t record = iterator->record;
+  size_t last = chunk->lines.count - 1;
 
-  for (size_t i = 0; i < chunk->lines.count; ++i) {
-    offset += lines[i].count;
-    if (instructionsIndex < offset) {
-      return lines[i].line;
+  if (record > last || instructionsIndex < lines[record].start) {
+    record = findLineRecord(chunk, instructionsIndex);
+  } else if (record < last && instructionsIndex >= lines[record + 1].start) {
+    record++;
+    if (record < last && instructionsIndex >= lines[record + 1].start) {
+      record = findLineRecord(chunk, instructionsIndex);
     }
   }
 
-  return 0;
+  iterator->record = record;
+  return lines[record].line;
 }
@@ -0,0 +1,38 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#include "clox/core/chunk.h"
+#include "clox/core/globals.h"
+#include "clox/core/memory.h"
+#include "clox/core/table.h"
+#include "clox/core/value.h"
+#include "clox/utils/dynarr.h"
+
+void initGlobals(Globals *globals) {
+  initTable(&globals->slots);
+  initDynArray(&globals->names, sizeof(ObjString *), MEM_GLOBALS);
+  initDynArray(&globals->values, sizeof(Value), MEM_GLOBALS);
+  globals->tenuredNames = 0;
+}
+
+void freeGlobals(Globals *globals) {
+  freeTable(&globals->slots);
+  freeDynArray(&globals->names);
+  freeDynArray(&globals->values);
+}
+
+size_t resolveGlobal(Globals *globals, ObjString *name) {
+  Value slot;
+  if (tableGet(&globals->slots, name, &slot)) {
+    return (size_t)AS_NUMBER(slot);
+  }
+  if (globals->names.count == GLOBALS_MAX) {
+    return GLOBALS_MAX;
+  }
+
+  size_t index = globals->names.count;
+  tableSet(&globals->slots, name, NUMBER_VAL((double)index));
+  pushDynArray(&globals->names, &name);
+  pushValueDynArray(&globals->values, UNDEFINED_VAL);
+  return index;
+}
@@ -0,0 +1,32 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#include "clox/core/inline_cache.h"
+#include "clox/core/object.h"
+
+void initInlineCache(InlineCache *cache, ObjString *name) {
+  cache->name = name;
+  for (size_t i = 0; i < IC_WAYS; ++i) {
+    cache->entries[i].shape = NULL;
+    cache->entries[i].next = NULL;
+    cache->entries[i].field = 0;
+  }
+  cache->count = 0;
+  cache->hits = 0;
+  cache->misses = 0;
+}
+
+void updateInlineCache(Heap *heap, InlineCache *cache, ObjShape *shape,
+                       ObjShape *next, uint32_t field) {
+  if (cache->count >= IC_WAYS) {
+    /// Keep the entries: the shapes already seen still hit
+    cache->count = IC_MEGAMORPHIC;
+    return;
+  }
+  ICEntry *entry = &cache->entries[cache->count++];
+  entry->shape = shape;
+  entry->next = next;
+  entry->field = field;
+  markingBarrier(heap, &shape->obj);
+  markingBarrier(heap, &next->obj);
+}
@@ -1,10 +1,25 @@
+/// mmap(), read() and fstat() are POSIX, MAP_ANONYMOUS is a common extension
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include "clox/compiler/compiler.h"
+#include "clox/core/cache.h"
 #include "clox/core/io.h"
 #include "clox/utils/error.h"
 #include "clox/vm/vm.h"
+#include "config.h"
 
 static char *readLine(void) {
   size_t capacity = INITIAL_LINE_CAPACITY;
@@ -43,44 +58,124 @@ static char *readLine(void) {
   return buffer;
 }
 
-static char *readFile(const char *path) {
-  /// "rb" => read binary
-  /// Read binary do't care UTF-XX or ASCII even 1000101001010
-  FILE *file = fopen(path, "rb");
-  if (file == NULL) {
-    fatalError(ERR_IO, "Cound not open file \"%s\".\n ", path);
+/**
+ * @brief Map a regular file followed by a NUL sentinel, without copying it.
+ *
+ * An anonymous zero-filled region one byte larger than the file is reserved
+ * first and the file is mapped over its start with MAP_FIXED. The byte after
+ * the file therefore always reads as '\0', even when the file size is an exact
+ * multiple of the page size.
+ */
+static bool mapSource(int fd, size_t size, Source *source) {
+  size_t mappingSize = size + 1;
+  void *region = mmap(NULL, mappingSize, PROT_READ,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (region == MAP_FAILED) {
+    return false;
   }
 
-  /// Move file pointer to file end, is file size
-  fseek(file, 0L, SEEK_END);
-  /// Return pointer position
-  long pos = ftell(file);
-  if (pos < 0) {
-    fclose(file);
-    fatalError(ERR_IO, "ftell failed on \"%s\".\n", path);
-  }
-  size_t fileSize = (size_t)pos;
-  /// Move pointer back to file begin
-  if (fseek(file, 0L, SEEK_SET) != 0) {
-    fclose(file);
-    fatalError(ERR_IO, "I/O error: failed to rewind file \"%s\".\n", path);
+  void *file = mmap(region, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0);
+  if (file == MAP_FAILED) {
+    munmap(region, mappingSize);
+    return false;
   }
 
-  /// Malloc buffer
-  char *buffer = (char *)malloc(fileSize + 1);
+  source->text = (const char *)region;
+  source->length = size;
+  source->mappingSize = mappingSize;
+  source->regularFile = true;
+  return true;
+}
+
+/**
+ * @brief Read `fd` to EOF into a single growing buffer.
+ *
+ * Used for pipes, terminals and other files that cannot be mapped. read(2)
+ * fills the buffer directly, so the data is not staged in a stdio buffer
+ * first. `sizeHint` is the expected size, or 0 if unknown.
+ */
+static bool readSource(int fd, size_t sizeHint, Source *source) {
+  size_t capacity = sizeHint + 1 > INITIAL_SOURCE_CAPACITY
+                        ? sizeHint + 1
+                        : INITIAL_SOURCE_CAPACITY;
+  size_t length = 0;
+  char *buffer = malloc(capacity);
   if (buffer == NULL) {
-    fatalError(ERR_OS, "Not enough memory to read \"%s\".\n", path);
+    return false;
   }
-  /// Read the content
-  size_t bytesRead = fread(buffer, sizeof(char), fileSize, file);
-  if (bytesRead < fileSize) {
-    fatalError(ERR_IO, "Could not read file \"%s\".\n", path);
+
+  for (;;) {
+    /// Keep one byte for the terminator
+    if (length + 1 >= capacity) {
+      capacity *= 2;
+      char *newBuf = realloc(buffer, capacity);
+      if (newBuf == NULL) {
+        free(buffer);
+        return false;
+      }
+      buffer = newBuf;
+    }
+
+    ssize_t bytesRead = read(fd, buffer + length, capacity - length - 1);
+    if (bytesRead == 0) {
+      break;
+    }
+    if (bytesRead < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      free(buffer);
+      return false;
+    }
+    length += (size_t)bytesRead;
   }
-  /// Add a terminator
-  buffer[bytesRead] = '\0';
 
-  fclose(file);
-  return buffer;
+  buffer[length] = '\0';
+  source->text = buffer;
+  source->length = length;
+  source->mappingSize = 0;
+  source->regularFile = false;
+  return true;
+}
+
+bool loadSource(const char *path, Source *source) {
+  if (strcmp(path, STDIN_PATH) == 0) {
+    return readSource(STDIN_FILENO, 0, source);
+  }
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat info;
+  bool loaded = false;
+  if (fstat(fd, &info) == 0) {
+    /// Empty files cannot be mapped
+    if (S_ISREG(info.st_mode) && info.st_size > 0) {
+      loaded = mapSource(fd, (size_t)info.st_size, source);
+    }
+    if (!loaded) {
+      size_t sizeHint = S_ISREG(info.st_mode) ? (size_t)info.st_size : 0;
+      loaded = readSource(fd, sizeHint, source);
+      source->regularFile = loaded && S_ISREG(info.st_mode);
+    }
+  }
+
+  /// A mapping stays valid after its descriptor is closed
+  close(fd);
+  return loaded;
+}
+
+void freeSource(Source *source) {
+  if (source->mappingSize > 0) {
+    munmap((void *)(uintptr_t)source->text, source->mappingSize);
+  } else {
+    free((void *)(uintptr_t)source->text);
+  }
+  source->text = NULL;
+  source->length = 0;
+  source->mappingSize = 0;
 }
 
 void runREPL(VM *vm) {
@@ -95,15 +190,71 @@ void runREPL(VM *vm) {
       break;
     }
 
-    /// interpret(vm, line);
+    /// Errors are already reported, keep the session going
+    (void)interpret(vm, line);
     free(line);
   }
 }
 
+#ifdef CLOX_BYTECODE_CACHE
+/**
+ * @brief interpret() through the `.loxc` cache next to `path`.
+ *
+ * A valid cache skips the compiler entirely; a missing, stale or corrupt one
+ * is replaced after a successful compile. Failing to write the cache (e.g. a
+ * read-only directory) is not an error.
+ */
+static InterpretResult interpretCached(VM *vm, const char *path,
+                                       const Source *script) {
+  const char *source = script->text;
+  size_t length = script->length;
+
+  /// Pipes and stdin have no stable place to keep a cache
+  if (!script->regularFile) {
+    return interpret(vm, source);
+  }
+  char *cachePath = cachePathFor(path);
+  if (cachePath == NULL) {
+    return interpret(vm, source);
+  }
+
+  InterpretResult result;
+  CachedChunk cached;
+  if (loadCachedChunk(cachePath, source, length, &vm->heap,
+                      &vm->globals, &cached)) {
+    result = interpretChunk(vm, &cached.chunk);
+    freeCachedChunk(&cached);
+  } else {
+    Chunk chunk;
+    initChunk(&chunk);
+    if (compile(source, &chunk, &vm->heap, &vm->globals)) {
+      (void)saveCachedChunk(cachePath, &chunk, source, length);
+      result = interpretChunk(vm, &chunk);
+    } else {
+      result = INTERPRET_COMPILE_ERROR;
+    }
+    freeChunk(&chunk);
+  }
+
+  vm->chunk = NULL;
+  vm->ip = NULL;
+  free(cachePath);
+  return result;
+}
+#endif
+
 void executeFile(VM *vm, const char *path) {
-  char *source = readFile(path);
-  InterpretResult result = interpret(vm, source);
-  free(source);
+  Source source;
+  if (!loadSource(path, &source)) {
+    fatalError(ERR_IO, "Could not read file \"%s\".\n", path);
+  }
+
+#ifdef CLOX_BYTECODE_CACHE
+  InterpretResult result = interpretCached(vm, path, &source);
+#else
+  InterpretResult result = interpret(vm, source.text);
+#endif
+  freeSource(&source);
 
   if (result == INTERPRET_COMPILE_ERROR) {
     fatalError(ERR_COMPILE, "Compilation failed. See above for details.\n");
@@ -1,15 +1,91 @@
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "clox/core/memory.h"
 #include "clox/utils/error.h"
 
+/// Totals per thread, what `--mem-stats` prints; VMs keep their own
+static _Thread_local MemoryStats memoryStats;
+
+static const char *const memoryTagNames[MEM_TAG_COUNT] = {
+    [MEM_OTHER] = "other",
+    [MEM_CHUNK_CODE] = "chunk code",
+    [MEM_CHUNK_CONSTANTS] = "chunk constants",
+    [MEM_CHUNK_LINES] = "chunk lines",
+    [MEM_CHUNK_GLOBALS] = "chunk globals",
+    [MEM_CHUNK_CACHES] = "chunk caches",
+    [MEM_VM_STACK] = "vm stack",
+    [MEM_GLOBALS] = "globals",
+    [MEM_COMPILER] = "compiler",
+    [MEM_STRING] = "strings",
+    [MEM_OBJECT] = "objects",
+    [MEM_TABLE] = "tables",
+    [MEM_PROFILER] = "profiler",
+    [MEM_GC] = "gc",
+};
+
+static const char *const gcKindNames[GC_KIND_COUNT] = {
+    [GC_MINOR] = "minor",
+    [GC_MAJOR] = "major",
+};
+
+static size_t sizeBucket(size_t size) {
+  size_t bucket = 0;
+  while (size > 1 && bucket < MEM_SIZE_BUCKETS - 1) {
+    size >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+static void countChange(MemoryTagStats *stats, const void *pointer,
+                        size_t oldSize, size_t newSize) {
+  stats->liveBytes = stats->liveBytes - oldSize + newSize;
+  if (stats->liveBytes > stats->peakBytes) {
+    stats->peakBytes = stats->liveBytes;
+  }
+
+  if (newSize == 0) {
+    stats->frees++;
+  } else if (pointer == NULL) {
+    stats->allocations++;
+  } else {
+    stats->reallocations++;
+  }
+}
+
 /*
  * @note This reallocate() function is the single function
  * - we’ll use for all dynamic memory management in clox—allocating memory,
  * - note freeing it, and changing the size of an existing allocation.
  */
-void *reallocate(void *pointer, size_t oldSize, size_t newSize) {
+static void countAllocation(MemoryStats *stats, const void *pointer,
+                            size_t oldSize, size_t newSize, MemoryTag tag) {
+  countChange(&stats->total, pointer, oldSize, newSize);
+  countChange(&stats->tags[tag], pointer, oldSize, newSize);
+  if (newSize != 0) {
+    stats->sizeHistogram[sizeBucket(newSize)]++;
+  }
+}
+
+void *reallocate(void *pointer, size_t oldSize, size_t newSize,
+                 MemoryTag tag) {
+  return reallocateOwned(NULL, pointer, oldSize, newSize, tag);
+}
+
+void *reallocateOwned(MemoryStats *owner, void *pointer, size_t oldSize,
+                      size_t newSize, MemoryTag tag) {
+  /// free(NULL) is not a release; it happens for never-grown arrays
+  if (pointer != NULL || newSize != 0) {
+    countAllocation(&memoryStats, pointer, oldSize, newSize, tag);
+    if (owner != NULL) {
+      countAllocation(owner, pointer, oldSize, newSize, tag);
+    }
+  }
+
   if (newSize == 0) {
     free(pointer);
     return NULL;
@@ -21,3 +97,287 @@ void *reallocate(void *pointer, size_t oldSize, size_t newSize) {
   }
   return result;
 }
+
+const MemoryStats *getMemoryStats(void) { return &memoryStats; }
+
+static void resetTagStats(MemoryTagStats *stats) {
+  *stats = (MemoryTagStats){.liveBytes = stats->liveBytes,
+                            .peakBytes = stats->liveBytes};
+}
+
+void resetMemoryStats(MemoryStats *stats) {
+  resetTagStats(&stats->total);
+  for (int tag = 0; tag < MEM_TAG_COUNT; ++tag) {
+    resetTagStats(&stats->tags[tag]);
+  }
+  memset(stats->sizeHistogram, 0, sizeof(stats->sizeHistogram));
+  memset(stats->gc, 0, sizeof(stats->gc));
+}
+
+const char *memoryTagName(MemoryTag tag) { return memoryTagNames[tag]; }
+
+static void countCollection(GcKindStats *stats, size_t bytes) {
+  stats->collections++;
+  stats->bytes += bytes;
+}
+
+void recordCollection(MemoryStats *owner, GcKind kind, size_t bytes) {
+  countCollection(&memoryStats.gc[kind], bytes);
+  countCollection(&owner->gc[kind], bytes);
+}
+
+/// @brief Histogram bucket of a pause, see GcKindStats
+static size_t pauseBucket(uint64_t ns) {
+  if (ns < 4) {
+    return (size_t)ns;
+  }
+  unsigned log = 2;
+  while ((ns >> (log + 1)) != 0) {
+    log++;
+  }
+  size_t bucket = 4 * (size_t)(log - 1) + (size_t)((ns >> (log - 2)) & 3u);
+  return bucket < GC_PAUSE_BUCKETS ? bucket : GC_PAUSE_BUCKETS - 1;
+}
+
+/// @brief Longest pause that falls into `bucket`
+static uint64_t pauseBucketLimit(size_t bucket) {
+  if (bucket < 4) {
+    return bucket;
+  }
+  unsigned shift = (unsigned)(bucket / 4) - 1;
+  uint64_t lower = (uint64_t)(4 + bucket % 4) << shift;
+  return lower + ((uint64_t)1 << shift) - 1;
+}
+
+static void countPause(GcKindStats *stats, uint64_t pauseNs) {
+  stats->pauses++;
+  stats->pauseNs += pauseNs;
+  if (pauseNs > stats->maxPauseNs) {
+    stats->maxPauseNs = pauseNs;
+  }
+  stats->pauseHistogram[pauseBucket(pauseNs)]++;
+}
+
+void recordGcPause(MemoryStats *owner, GcKind kind, uint64_t pauseNs) {
+  countPause(&memoryStats.gc[kind], pauseNs);
+  countPause(&owner->gc[kind], pauseNs);
+}
+
+uint64_t gcPausePercentile(const GcKindStats *stats, double percentile) {
+  if (stats->pauses == 0) {
+    return 0;
+  }
+  /// Rank of the pause sought, counting from 1
+  double rank = percentile / 100.0 * (double)stats->pauses;
+  size_t seen = 0;
+  for (size_t bucket = 0; bucket < GC_PAUSE_BUCKETS; ++bucket) {
+    seen += stats->pauseHistogram[bucket];
+    if (seen > 0 && (double)seen >= rank) {
+      uint64_t limit = pauseBucketLimit(bucket);
+      return limit < stats->maxPauseNs ? limit : stats->maxPauseNs;
+    }
+  }
+  return stats->maxPauseNs;
+}
+
+static void printTagStats(FILE *out, const char *name,
+                          const MemoryTagStats *stats) {
+  fprintf(out, "  %-16s %12zu %12zu %9zu %9zu %9zu\n", name,
+          stats->liveBytes, stats->peakBytes, stats->allocations,
+          stats->reallocations, stats->frees);
+}
+
+void printMemoryStats(FILE *out, const MemoryStats *stats) {
+  fprintf(out, "  %-16s %12s %12s %9s %9s %9s\n", "memory", "live", "peak",
+          "allocs", "resizes", "frees");
+  for (int tag = 0; tag < MEM_TAG_COUNT; ++tag) {
+    const MemoryTagStats *tagStats = &stats->tags[tag];
+    if (tagStats->peakBytes != 0 || tagStats->frees != 0) {
+      printTagStats(out, memoryTagName((MemoryTag)tag), tagStats);
+    }
+  }
+  printTagStats(out, "total", &stats->total);
+
+  fprintf(out, "  %-16s %12s\n", "request size", "count");
+  for (size_t bucket = 0; bucket < MEM_SIZE_BUCKETS; ++bucket) {
+    size_t count = stats->sizeHistogram[bucket];
+    if (count == 0) {
+      continue;
+    }
+    char range[32];
+    if (bucket == MEM_SIZE_BUCKETS - 1) {
+      snprintf(range, sizeof(range), ">= %zu", (size_t)1 << bucket);
+    } else {
+      snprintf(range, sizeof(range), "%zu-%zu", (size_t)1 << bucket,
+               ((size_t)2 << bucket) - 1);
+    }
+    fprintf(out, "  %-16s %12zu\n", range, count);
+  }
+
+  /// Minor collections may run inside major pauses, major ones never
+  /// complete without a pause
+  if (stats->gc[GC_MINOR].collections == 0 &&
+      stats->gc[GC_MAJOR].pauses == 0) {
+    return;
+  }
+  /// Bytes are promoted by minor collections and freed by major ones
+  fprintf(out, "  %-16s %12s %8s %8s %8s %8s %8s\n", "collections", "bytes",
+          "count", "pauses", "p50 us", "p99 us", "max us");
+  for (int kind = 0; kind < GC_KIND_COUNT; ++kind) {
+    const GcKindStats *gc = &stats->gc[kind];
+    if (gc->pauses == 0 && gc->collections == 0) {
+      continue;
+    }
+    fprintf(out, "  %-16s %12zu %8zu %8zu %8.1f %8.1f %8.1f\n",
+            gcKindNames[kind], gc->bytes, gc->collections, gc->pauses,
+            (double)gcPausePercentile(gc, 50.0) / 1e3,
+            (double)gcPausePercentile(gc, 99.0) / 1e3,
+            (double)gc->maxPauseNs / 1e3);
+  }
+}
+
+struct ArenaBlock {
+  ArenaBlock *next; ///< Previously filled block
+  size_t size;      ///< Usable bytes in `data`
+  size_t used;      ///< Bytes handed out from `data`
+  max_align_t data[];
+};
+
+#define ARENA_ALIGNMENT (sizeof(max_align_t))
+
+static size_t alignArenaSize(size_t size) {
+  return (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+}
+
+static ArenaBlock *newArenaBlock(Arena *arena, size_t size) {
+  ArenaBlock *block = reallocate(NULL, 0, sizeof(ArenaBlock) + size,
+                                 arena->tag);
+  block->next = NULL;
+  block->size = size;
+  block->used = 0;
+  arena->stats.blocks++;
+  arena->stats.bytesHeld += size;
+  return block;
+}
+
+static void freeArenaBlock(Arena *arena, ArenaBlock *block) {
+  arena->stats.blocks--;
+  arena->stats.bytesHeld -= block->size;
+  reallocate(block, sizeof(ArenaBlock) + block->size, 0, arena->tag);
+}
+
+void initArena(Arena *arena, size_t blockSize, MemoryTag tag) {
+  arena->head = NULL;
+  arena->last = NULL;
+  arena->blockSize = alignArenaSize(blockSize == 0 ? ARENA_DEFAULT_BLOCK_SIZE
+                                                   : blockSize);
+  arena->tag = tag;
+  arena->stats = (ArenaStats){0};
+}
+
+void *arenaAlloc(Arena *arena, size_t size) {
+  if (size > SIZE_MAX - ARENA_ALIGNMENT - sizeof(ArenaBlock)) {
+    fatalError(ERR_FAILURE, "Arena allocation too large");
+  }
+  size = alignArenaSize(size == 0 ? 1 : size);
+
+  ArenaBlock *block = arena->head;
+  if (block == NULL || block->size - block->used < size) {
+    if (size > arena->blockSize / 4) {
+      /// Oversized: a block of its own behind the head, which stays current
+      block = newArenaBlock(arena, size);
+      if (arena->head != NULL) {
+        block->next = arena->head->next;
+        arena->head->next = block;
+      } else {
+        arena->head = block;
+      }
+    } else {
+      block = newArenaBlock(arena, arena->blockSize);
+      block->next = arena->head;
+      arena->head = block;
+    }
+  }
+
+  void *result = (char *)block->data + block->used;
+  block->used += size;
+  arena->last = result;
+
+  arena->stats.bytesUsed += size;
+  arena->stats.allocations++;
+  if (arena->stats.bytesUsed > arena->stats.highWater) {
+    arena->stats.highWater = arena->stats.bytesUsed;
+  }
+  return result;
+}
+
+void *arenaGrowArray(Arena *arena, void *pointer, size_t oldCount,
+                     size_t newCount, size_t elemSize) {
+  if (elemSize != 0 && newCount > SIZE_MAX / elemSize) {
+    fatalError(ERR_FAILURE, "Arena allocation too large");
+  }
+  size_t oldSize = alignArenaSize(oldCount * elemSize);
+  size_t newSize = alignArenaSize(newCount * elemSize);
+  if (pointer != NULL && newSize <= oldSize) {
+    return pointer;
+  }
+
+  /// The last allocation of the head block can simply be extended
+  ArenaBlock *block = arena->head;
+  if (pointer != NULL && pointer == arena->last &&
+      (char *)pointer + oldSize == (char *)block->data + block->used &&
+      block->size - block->used >= newSize - oldSize) {
+    block->used += newSize - oldSize;
+    arena->stats.bytesUsed += newSize - oldSize;
+    if (arena->stats.bytesUsed > arena->stats.highWater) {
+      arena->stats.highWater = arena->stats.bytesUsed;
+    }
+    return pointer;
+  }
+
+  void *result = arenaAlloc(arena, newSize);
+  if (pointer != NULL) {
+    memcpy(result, pointer, oldCount * elemSize);
+  }
+  return result;
+}
+
+void resetArena(Arena *arena) {
+  ArenaBlock *kept = NULL;
+  ArenaBlock *block = arena->head;
+  while (block != NULL) {
+    ArenaBlock *next = block->next;
+    if (kept == NULL && block->size == arena->blockSize) {
+      kept = block;
+    } else {
+      freeArenaBlock(arena, block);
+    }
+    block = next;
+  }
+
+  if (kept != NULL) {
+    kept->next = NULL;
+    kept->used = 0;
+  }
+  arena->head = kept;
+  arena->last = NULL;
+  arena->stats.bytesUsed = 0;
+  arena->stats.allocations = 0;
+}
+
+void freeArena(Arena *arena) {
+  resetArena(arena);
+  if (arena->head != NULL) {
+    freeArenaBlock(arena, arena->head);
+    arena->head = NULL;
+  }
+}
+
+void printArenaStats(FILE *out, const char *name, const Arena *arena) {
+  const ArenaStats *stats = &arena->stats;
+  fprintf(out,
+          "%s: %zu bytes in %zu allocations, %zu blocks holding %zu bytes, "
+          "high water %zu bytes\n",
+          name, stats->bytesUsed, stats->allocations, stats->blocks,
+          stats->bytesHeld, stats->highWater);
+}
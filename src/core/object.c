@@ -0,0 +1,502 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "clox/core/memory.h"
+#include "clox/core/object.h"
+#include "clox/core/table.h"
+#include "clox/core/value.h"
+
+/// @brief Alignment of nursery objects; no field needs more than 8 bytes
+#define NURSERY_ALIGNMENT ((size_t)8)
+
+/// @brief Objects larger than this fraction of a block start old
+#define NURSERY_LARGE_FRACTION 8
+
+struct NurseryBlock {
+  NurseryBlock *next; ///< Block filled before this one
+  size_t size;        ///< Usable bytes in `data`
+  max_align_t data[];
+};
+
+void initHeap(Heap *heap) {
+  heap->objects = NULL;
+  initTable(&heap->strings);
+  heap->nursery = NULL;
+  heap->nurseryTop = NULL;
+  heap->nurseryEnd = NULL;
+  heap->nurserySize = NURSERY_SIZE;
+  initDynArray(&heap->youngStrings, sizeof(ObjString *), MEM_GC);
+  initDynArray(&heap->youngOwners, sizeof(Obj *), MEM_GC);
+  initDynArray(&heap->remembered, sizeof(Obj *), MEM_GC);
+  initDynArray(&heap->survivors, sizeof(Obj *), MEM_GC);
+  initDynArray(&heap->gray, sizeof(Obj *), MEM_GC);
+  heap->sweeping = NULL;
+  heap->oldBytes = 0;
+  heap->nextMajor = HEAP_MIN_OLD_BYTES;
+  heap->sliceBudget = GC_SLICE_BUDGET;
+  heap->freedBytes = 0;
+  heap->phase = GC_IDLE;
+  heap->cycle = 0;
+  heap->markSense = 0;
+  heap->nurseryFull = false;
+  heap->collectRequested = false;
+  heap->stats = (MemoryStats){0};
+}
+
+static size_t stringSize(size_t length) {
+  return sizeof(ObjString) + length + 1;
+}
+
+static size_t alignNursery(size_t size) {
+  return (size + NURSERY_ALIGNMENT - 1) & ~(NURSERY_ALIGNMENT - 1);
+}
+
+static uint8_t *blockData(NurseryBlock *block) {
+  return (uint8_t *)block->data;
+}
+
+static MemoryTag objectTag(ObjType type) {
+  return type == OBJ_STRING ? MEM_STRING : MEM_OBJECT;
+}
+
+size_t objectSize(const Obj *object) {
+  switch ((int)object->type) {
+  case OBJ_STRING:
+    return stringSize(((const ObjString *)object)->length);
+  case OBJ_NATIVE:
+    return sizeof(ObjNative);
+  case OBJ_CLASS:
+    return sizeof(ObjClass);
+  case OBJ_INSTANCE:
+    return sizeof(ObjInstance);
+  case OBJ_SHAPE:
+    return sizeof(ObjShape);
+  default:
+    return sizeof(Obj);
+  }
+}
+
+void freeObject(Heap *heap, Obj *object) {
+  switch ((int)object->type) {
+  case OBJ_INSTANCE:
+    if ((object->flags & OBJ_NURSERY_FIELDS) == 0) {
+      ObjInstance *instance = (ObjInstance *)object;
+      free_owned_array(&heap->stats, instance->fields, instance->capacity,
+                       sizeof(Value), MEM_OBJECT);
+    }
+    break;
+  case OBJ_SHAPE:
+    freeTable(&((ObjShape *)object)->transitions);
+    break;
+  default:
+    break;
+  }
+  if ((object->flags & OBJ_YOUNG) == 0) {
+    size_t size = objectSize(object);
+    heap->oldBytes -= size;
+    reallocateOwned(&heap->stats, object, size, 0, objectTag(object->type));
+  }
+}
+
+/// @brief Start bumping into a new block, in front of the current one
+static void pushNurseryBlock(Heap *heap) {
+  NurseryBlock *block =
+      reallocateOwned(&heap->stats, NULL, 0,
+                      sizeof(NurseryBlock) + heap->nurserySize, MEM_GC);
+  block->next = heap->nursery;
+  block->size = heap->nurserySize;
+  heap->nursery = block;
+  heap->nurseryTop = blockData(block);
+  heap->nurseryEnd = heap->nurseryTop + block->size;
+}
+
+static void freeNurseryBlock(Heap *heap, NurseryBlock *block) {
+  reallocateOwned(&heap->stats, block, sizeof(NurseryBlock) + block->size, 0,
+                  MEM_GC);
+}
+
+/// @brief Whether an allocation of `aligned` bytes goes in the nursery
+static bool fitsNursery(const Heap *heap, size_t aligned) {
+  return heap->nurserySize != 0 &&
+         aligned <= heap->nurserySize / NURSERY_LARGE_FRACTION;
+}
+
+/**
+ * @brief Bump `aligned` bytes out of the nursery, starting a new block if
+ * the current one is full.
+ *
+ * Only asks for a collection: the caller may hold pointers the collector
+ * does not know about.
+ */
+static void *bumpNursery(Heap *heap, size_t aligned) {
+  if (heap->nursery == NULL) {
+    pushNurseryBlock(heap);
+  } else if ((size_t)(heap->nurseryEnd - heap->nurseryTop) < aligned) {
+    /// Keep going in another block until the VM reaches a safe point
+    heap->nurseryFull = true;
+    heap->collectRequested = true;
+    pushNurseryBlock(heap);
+  }
+  void *result = heap->nurseryTop;
+  heap->nurseryTop += aligned;
+  return result;
+}
+
+void resetNursery(Heap *heap) {
+  /// The rest of the garbage goes with the blocks
+  Obj **owners = (Obj **)heap->youngOwners.data;
+  for (size_t i = 0; i < heap->youngOwners.count; ++i) {
+    if ((owners[i]->flags & OBJ_FORWARDED) == 0) {
+      freeObject(heap, owners[i]);
+    }
+  }
+  heap->youngOwners.count = 0;
+  heap->youngStrings.count = 0;
+  heap->nurseryFull = false;
+
+  NurseryBlock *kept = NULL;
+  NurseryBlock *block = heap->nursery;
+  while (block != NULL) {
+    NurseryBlock *next = block->next;
+    if (kept == NULL && block->size == heap->nurserySize) {
+      kept = block;
+    } else {
+      freeNurseryBlock(heap, block);
+    }
+    block = next;
+  }
+
+  heap->nursery = kept;
+  if (kept != NULL) {
+    kept->next = NULL;
+    heap->nurseryTop = blockData(kept);
+    heap->nurseryEnd = heap->nurseryTop + kept->size;
+  } else {
+    heap->nurseryTop = NULL;
+    heap->nurseryEnd = NULL;
+  }
+}
+
+static void freeObjects(Heap *heap, Obj *object) {
+  while (object != NULL) {
+    Obj *next = object->next;
+    freeObject(heap, object);
+    object = next;
+  }
+}
+
+void freeHeap(Heap *heap) {
+  freeObjects(heap, heap->objects);
+  freeObjects(heap, heap->sweeping);
+  heap->objects = NULL;
+  heap->sweeping = NULL;
+  resetNursery(heap);
+  if (heap->nursery != NULL) {
+    freeNurseryBlock(heap, heap->nursery);
+    heap->nursery = NULL;
+  }
+  freeTable(&heap->strings);
+  freeDynArray(&heap->youngStrings);
+  freeDynArray(&heap->youngOwners);
+  freeDynArray(&heap->remembered);
+  freeDynArray(&heap->survivors);
+  freeDynArray(&heap->gray);
+}
+
+/**
+ * @brief Link new old `object` into the old generation, marked: a major
+ * collection only frees objects that existed when it started. While
+ * marking, its children have yet to be marked, so it is also gray.
+ */
+static void addOldObject(Heap *heap, Obj *object, size_t size) {
+  object->flags = heap->markSense;
+  object->next = heap->objects;
+  heap->objects = object;
+  heap->oldBytes += size;
+  if (heap->phase == GC_MARKING && object->type != OBJ_STRING) {
+    pushObjectDynArray(&heap->gray, object);
+  }
+}
+
+Obj *promoteObject(Heap *heap, Obj *object) {
+  size_t size = objectSize(object);
+  Obj *copy = grow_owned_array(&heap->stats, NULL, 0, size, 1,
+                               objectTag(object->type));
+  memcpy(copy, object, size);
+  addOldObject(heap, copy, size);
+
+  /// Old instances keep their fields in a separate allocation
+  if ((object->flags & OBJ_NURSERY_FIELDS) != 0) {
+    ObjInstance *instance = (ObjInstance *)copy;
+    Value *fields = grow_owned_array(&heap->stats, NULL, 0, instance->capacity,
+                                     sizeof(Value), MEM_OBJECT);
+    memcpy(fields, instance->fields, instance->capacity * sizeof(Value));
+    instance->fields = fields;
+  }
+  object->flags |= OBJ_FORWARDED;
+  object->next = copy;
+  return copy;
+}
+
+void rememberObject(Heap *heap, Obj *object) {
+  object->flags |= OBJ_REMEMBERED;
+  pushObjectDynArray(&heap->remembered, object);
+}
+
+void shadeObject(Heap *heap, Obj *object) {
+  object->flags = (uint8_t)((object->flags & ~OBJ_MARKED) | heap->markSense);
+  /// Strings point to nothing
+  if (object->type != OBJ_STRING) {
+    pushObjectDynArray(&heap->gray, object);
+  }
+}
+
+uint32_t hashString(const char *chars, size_t length) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; ++i) {
+    hash ^= (uint8_t)chars[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/// @brief A new object of `size` bytes in the old generation
+static Obj *allocateOldObject(Heap *heap, size_t size, ObjType type) {
+  Obj *object = grow_owned_array(&heap->stats, NULL, 0, size, 1,
+                                 objectTag(type));
+  object->type = type;
+  addOldObject(heap, object, size);
+  if (heap->oldBytes > heap->nextMajor) {
+    heap->collectRequested = true;
+  }
+  /// The caller fills in the fields, which may point into the nursery
+  if (heap->nurserySize != 0 && type != OBJ_STRING) {
+    rememberObject(heap, object);
+  }
+  return object;
+}
+
+/// @brief A new object of `size` bytes, young unless it is large
+static Obj *allocateObject(Heap *heap, size_t size, ObjType type) {
+  size_t aligned = alignNursery(size);
+  if (!fitsNursery(heap, aligned)) {
+    return allocateOldObject(heap, size, type);
+  }
+  Obj *object = bumpNursery(heap, aligned);
+  object->type = type;
+  object->flags = OBJ_YOUNG;
+  object->next = NULL;
+  return object;
+}
+
+/**
+ * @brief Take back `object`, the last object allocated, which nothing
+ * points to yet.
+ */
+static void freeNewestObject(Heap *heap, Obj *object) {
+  if ((object->flags & OBJ_YOUNG) != 0) {
+    heap->nurseryTop = (uint8_t *)object;
+    return;
+  }
+  heap->objects = object->next;
+  freeObject(heap, object);
+}
+
+/// @brief A string of `length` characters, filled in by the caller
+static ObjString *allocateString(Heap *heap, size_t length) {
+  ObjString *string = (ObjString *)allocateObject(heap, stringSize(length),
+                                                  OBJ_STRING);
+  string->length = length;
+  string->chars[length] = '\0';
+  return string;
+}
+
+/**
+ * @brief `string`, just found in the intern set, kept alive by the running
+ * major collection: the sweep would free it if it was unmarked.
+ */
+static ObjString *reviveString(Heap *heap, ObjString *string) {
+  Obj *object = &string->obj;
+  if (heap->phase != GC_IDLE && (object->flags & OBJ_YOUNG) == 0 &&
+      !isMarked(heap, object)) {
+    shadeObject(heap, object);
+  }
+  return string;
+}
+
+/// @brief Add a new, hashed string to the intern set
+static ObjString *internString(Heap *heap, ObjString *string) {
+  tableSet(&heap->strings, string, NIL_VAL);
+  if ((string->obj.flags & OBJ_YOUNG) != 0) {
+    pushDynArray(&heap->youngStrings, &string);
+  }
+  return string;
+}
+
+ObjString *copyString(Heap *heap, const char *chars, size_t length) {
+  uint32_t hash = hashString(chars, length);
+  ObjString *interned = tableFindString(&heap->strings, chars, length, hash);
+  if (interned != NULL) {
+    return reviveString(heap, interned);
+  }
+
+  ObjString *string = allocateString(heap, length);
+  memcpy(string->chars, chars, length);
+  string->hash = hash;
+  return internString(heap, string);
+}
+
+ObjString *concatenateStrings(Heap *heap, const ObjString *a,
+                              const ObjString *b) {
+  size_t length = a->length + b->length;
+  ObjString *string = allocateString(heap, length);
+  memcpy(string->chars, a->chars, a->length);
+  memcpy(string->chars + a->length, b->chars, b->length);
+  string->hash = hashString(string->chars, length);
+
+  /// The result is often new, so build it in place and drop it if not
+  ObjString *interned =
+      tableFindString(&heap->strings, string->chars, length, string->hash);
+  if (interned != NULL) {
+    freeNewestObject(heap, &string->obj);
+    return reviveString(heap, interned);
+  }
+  return internString(heap, string);
+}
+
+ObjNative *newNative(Heap *heap, ObjString *name, CloxNativeFn function,
+                     int arity) {
+  ObjNative *native =
+      (ObjNative *)allocateObject(heap, sizeof(ObjNative), OBJ_NATIVE);
+  native->name = name;
+  native->function = function;
+  native->arity = arity;
+  return native;
+}
+
+/// @note Shapes live as long as their class, so they start old
+static ObjShape *newShape(Heap *heap, ObjShape *parent, ObjString *key) {
+  ObjShape *shape =
+      (ObjShape *)allocateOldObject(heap, sizeof(ObjShape), OBJ_SHAPE);
+  shape->parent = parent;
+  shape->key = key;
+  shape->fieldCount = parent == NULL ? 0 : parent->fieldCount + 1;
+  initTable(&shape->transitions);
+  return shape;
+}
+
+ObjClass *newClass(Heap *heap, ObjString *name) {
+  ObjShape *root = newShape(heap, NULL, NULL);
+  ObjClass *klass =
+      (ObjClass *)allocateObject(heap, sizeof(ObjClass), OBJ_CLASS);
+  klass->name = name;
+  klass->rootShape = root;
+  return klass;
+}
+
+ObjInstance *newInstance(Heap *heap, ObjClass *klass) {
+  ObjInstance *instance =
+      (ObjInstance *)allocateObject(heap, sizeof(ObjInstance), OBJ_INSTANCE);
+  instance->klass = klass;
+  instance->shape = klass->rootShape;
+  instance->fields = NULL;
+  instance->capacity = 0;
+  return instance;
+}
+
+/// @note Linear in the number of fields, which inline caches make rare
+uint32_t shapeFieldIndex(const ObjShape *shape, const ObjString *name) {
+  for (; shape->key != NULL; shape = shape->parent) {
+    if (shape->key == name) {
+      return shape->fieldCount - 1;
+    }
+  }
+  return SHAPE_NO_FIELD;
+}
+
+ObjShape *shapeTransition(Heap *heap, ObjShape *shape, ObjString *name) {
+  Value child;
+  if (tableGet(&shape->transitions, name, &child)) {
+    return (ObjShape *)AS_OBJ(child);
+  }
+  ObjShape *next = newShape(heap, shape, name);
+  tableSet(&shape->transitions, name, OBJ_VAL(next));
+  writeBarrier(heap, &shape->obj, &name->obj);
+  writeBarrier(heap, &shape->obj, &next->obj);
+  return next;
+}
+
+/**
+ * @brief Move the fields of `instance` to an array of `capacity` values.
+ *
+ * A young instance's array is bumped into the nursery too, unless it is
+ * too large, so that dead instances need no freeing.
+ */
+static void growFields(Heap *heap, ObjInstance *instance, uint32_t capacity) {
+  Obj *object = &instance->obj;
+  size_t size = (size_t)capacity * sizeof(Value);
+  size_t used = (size_t)instance->capacity * sizeof(Value);
+  Value *fields;
+  if ((object->flags & OBJ_YOUNG) != 0 &&
+      ((object->flags & OBJ_NURSERY_FIELDS) != 0 || instance->capacity == 0)) {
+    if (fitsNursery(heap, alignNursery(size))) {
+      fields = bumpNursery(heap, alignNursery(size));
+      object->flags |= OBJ_NURSERY_FIELDS;
+    } else {
+      fields = grow_owned_array(&heap->stats, NULL, 0, capacity,
+                                sizeof(Value), MEM_OBJECT);
+      object->flags &= (uint8_t)~OBJ_NURSERY_FIELDS;
+      pushObjectDynArray(&heap->youngOwners, object);
+    }
+    if (used != 0) {
+      memcpy(fields, instance->fields, used);
+    }
+  } else {
+    fields = grow_owned_array(&heap->stats, instance->fields,
+                              instance->capacity, capacity, sizeof(Value),
+                              MEM_OBJECT);
+  }
+  instance->fields = fields;
+  instance->capacity = capacity;
+}
+
+void setInstanceShape(Heap *heap, ObjInstance *instance, ObjShape *shape) {
+  uint32_t count = shape->fieldCount;
+  if (count > instance->capacity) {
+    uint32_t capacity = (uint32_t)grow_capacity(instance->capacity);
+    while (capacity < count) {
+      capacity *= 2;
+    }
+    growFields(heap, instance, capacity);
+  }
+  for (uint32_t i = instance->shape->fieldCount; i < count; ++i) {
+    instance->fields[i] = NIL_VAL;
+  }
+  instance->shape = shape;
+  writeBarrier(heap, &instance->obj, &shape->obj);
+}
+
+void printObject(Value value) {
+  switch ((int)OBJ_TYPE(value)) {
+  case OBJ_STRING: {
+    ObjString *string = AS_STRING(value);
+    fwrite(string->chars, 1, string->length, stdout);
+    break;
+  }
+  case OBJ_NATIVE:
+    printf("<native fn %s>", AS_NATIVE(value)->name->chars);
+    break;
+  case OBJ_CLASS:
+    printf("%s", AS_CLASS(value)->name->chars);
+    break;
+  case OBJ_INSTANCE:
+    printf("%s instance", AS_INSTANCE(value)->klass->name->chars);
+    break;
+  default:
+    printf("<shape>");
+    break;
+  }
+}
@@ -0,0 +1,52 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#include "clox/core/chunk.h"
+#include "clox/core/register_chunk.h"
+#include "clox/core/value.h"
+#include "clox/utils/dynarr.h"
+
+DEFINE_DYNARRAY_PUSH(pushRegInstruction, RegInstruction)
+
+void initRegChunk(RegChunk *chunk) {
+  initDynArray(&chunk->code, sizeof(RegInstruction), MEM_CHUNK_CODE);
+  initDynArray(&chunk->constants, sizeof(Value), MEM_CHUNK_CONSTANTS);
+  initDynArray(&chunk->lines, sizeof(LineRecord), MEM_CHUNK_LINES);
+  chunk->slotCount = 0;
+}
+
+void writeRegChunk(RegChunk *chunk, RegInstruction instruction, size_t line) {
+  pushRegInstruction(&chunk->code, instruction);
+
+  const LineRecord *lines = (const LineRecord *)chunk->lines.data;
+  if (chunk->lines.count == 0 || lines[chunk->lines.count - 1].line != line) {
+    LineRecord record = {.line = line, .start = chunk->code.count - 1};
+    pushLineDynArray(&chunk->lines, record);
+  }
+}
+
+void freeRegChunk(RegChunk *chunk) {
+  freeDynArray(&chunk->code);
+  freeDynArray(&chunk->constants);
+  freeDynArray(&chunk->lines);
+  chunk->slotCount = 0;
+}
+
+size_t getRegLine(const RegChunk *chunk, size_t index) {
+  if (chunk->lines.count == 0 || index >= chunk->code.count) {
+    return 0;
+  }
+
+  const LineRecord *lines = (const LineRecord *)chunk->lines.data;
+  size_t low = 0;
+  size_t high = chunk->lines.count;
+  while (high - low > 1) {
+    size_t mid = low + (high - low) / 2;
+    if (lines[mid].start <= index) {
+      low = mid;
+    } else {
+      high = mid;
+    }
+  }
+  return lines[low].line;
+}
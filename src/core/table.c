@@ -0,0 +1,176 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "clox/core/memory.h"
+#include "clox/core/object.h"
+#include "clox/core/table.h"
+#include "clox/core/value.h"
+
+void initTable(Table *table) {
+  table->count = 0;
+  table->capacity = 0;
+  table->entries = NULL;
+}
+
+void freeTable(Table *table) {
+  free_array(table->entries, table->capacity, sizeof(Entry), MEM_TABLE);
+  initTable(table);
+}
+
+static bool isTombstone(const Entry *entry) {
+  return entry->key == NULL && !IS_NIL(entry->value);
+}
+
+/**
+ * @brief Find the entry of `key`, or the slot where it should go.
+ *
+ * @return The matching entry, otherwise the first tombstone or empty slot on
+ * the probe sequence.
+ */
+static Entry *findEntry(Entry *entries, size_t capacity,
+                        const ObjString *key) {
+  size_t mask = capacity - 1;
+  Entry *tombstone = NULL;
+
+  for (size_t i = key->hash & mask;; i = (i + 1) & mask) {
+    Entry *entry = &entries[i];
+    if (entry->key == key) {
+      return entry;
+    }
+    if (entry->key == NULL) {
+      if (!isTombstone(entry)) {
+        return tombstone != NULL ? tombstone : entry;
+      }
+      if (tombstone == NULL) {
+        tombstone = entry;
+      }
+    }
+  }
+}
+
+/// @brief Rehash into `capacity` slots; tombstones are dropped
+static void adjustCapacity(Table *table, size_t capacity) {
+  Entry *entries = grow_array(NULL, 0, capacity, sizeof(Entry), MEM_TABLE);
+  for (size_t i = 0; i < capacity; ++i) {
+    entries[i].key = NULL;
+    entries[i].value = NIL_VAL;
+  }
+
+  table->count = 0;
+  for (size_t i = 0; i < table->capacity; ++i) {
+    const Entry *old = &table->entries[i];
+    if (old->key == NULL) {
+      continue;
+    }
+    *findEntry(entries, capacity, old->key) = *old;
+    table->count++;
+  }
+
+  free_array(table->entries, table->capacity, sizeof(Entry), MEM_TABLE);
+  table->entries = entries;
+  table->capacity = capacity;
+}
+
+/// @brief Capacity to rehash into: double it, unless tombstones (strings
+/// dropped by the collector, say) make up most of the load
+static size_t rehashCapacity(const Table *table) {
+  size_t live = 0;
+  for (size_t i = 0; i < table->capacity; ++i) {
+    if (table->entries[i].key != NULL) {
+      live++;
+    }
+  }
+  if ((double)(live + 1) <= (double)table->capacity * TABLE_MAX_LOAD / 2) {
+    return table->capacity;
+  }
+  return grow_capacity(table->capacity);
+}
+
+bool tableGet(const Table *table, const ObjString *key, Value *value) {
+  if (table->count == 0) {
+    return false;
+  }
+
+  const Entry *entry = findEntry(table->entries, table->capacity, key);
+  if (entry->key == NULL) {
+    return false;
+  }
+  *value = entry->value;
+  return true;
+}
+
+bool tableSet(Table *table, ObjString *key, Value value) {
+  if ((double)(table->count + 1) > (double)table->capacity * TABLE_MAX_LOAD) {
+    adjustCapacity(table, rehashCapacity(table));
+  }
+
+  Entry *entry = findEntry(table->entries, table->capacity, key);
+  bool isNewKey = entry->key == NULL;
+  /// A reused tombstone is already counted
+  if (isNewKey && !isTombstone(entry)) {
+    table->count++;
+  }
+
+  entry->key = key;
+  entry->value = value;
+  return isNewKey;
+}
+
+bool tableDelete(Table *table, const ObjString *key) {
+  if (table->count == 0) {
+    return false;
+  }
+
+  Entry *entry = findEntry(table->entries, table->capacity, key);
+  if (entry->key == NULL) {
+    return false;
+  }
+  entry->key = NULL;
+  entry->value = BOOL_VAL(true);
+  return true;
+}
+
+bool tableReplaceKey(Table *table, const ObjString *key,
+                     ObjString *replacement) {
+  if (table->count == 0) {
+    return false;
+  }
+
+  Entry *entry = findEntry(table->entries, table->capacity, key);
+  if (entry->key == NULL) {
+    return false;
+  }
+  entry->key = replacement;
+  return true;
+}
+
+void tableAddAll(const Table *from, Table *to) {
+  for (size_t i = 0; i < from->capacity; ++i) {
+    const Entry *entry = &from->entries[i];
+    if (entry->key != NULL) {
+      tableSet(to, entry->key, entry->value);
+    }
+  }
+}
+
+ObjString *tableFindString(const Table *table, const char *chars,
+                           size_t length, uint32_t hash) {
+  if (table->count == 0) {
+    return NULL;
+  }
+
+  size_t mask = table->capacity - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    const Entry *entry = &table->entries[i];
+    if (entry->key == NULL) {
+      if (!isTombstone(entry)) {
+        return NULL;
+      }
+    } else if (entry->key->hash == hash && entry->key->length == length &&
+               memcmp(entry->key->chars, chars, length) == 0) {
+      return entry->key;
+    }
+  }
+}
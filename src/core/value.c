@@ -1,6 +1,53 @@
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
 
+#include "clox/core/object.h"
 #include "clox/core/value.h"
 
-void printValue(Value value) { printf("%g", value); }
+/// Lox `==` on numbers is IEEE equality (NaN != NaN), so the float compare
+/// is intended here.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wfloat-equal"
+
+bool valuesEqual(Value a, Value b) {
+#ifdef CLOX_NAN_BOXING
+  if (IS_NUMBER(a) && IS_NUMBER(b)) {
+    return AS_NUMBER(a) == AS_NUMBER(b);
+  }
+  /// nil, booleans and objects are singletons per bit pattern
+  return a == b;
+#else
+  if (a.type != b.type) {
+    return false;
+  }
+
+  switch (a.type) {
+  case VAL_BOOL:
+    return AS_BOOL(a) == AS_BOOL(b);
+  case VAL_NIL:
+  case VAL_UNDEFINED:
+    return true;
+  case VAL_NUMBER:
+    return AS_NUMBER(a) == AS_NUMBER(b);
+  case VAL_OBJ:
+    return AS_OBJ(a) == AS_OBJ(b);
+  default:
+    return false;
+  }
+#endif
+}
+
+#pragma GCC diagnostic pop
+
+void printValue(Value value) {
+  if (IS_BOOL(value)) {
+    printf(AS_BOOL(value) ? "true" : "false");
+  } else if (IS_NIL(value)) {
+    printf("nil");
+  } else if (IS_NUMBER(value)) {
+    printf("%g", AS_NUMBER(value));
+  } else if (IS_OBJ(value)) {
+    printObject(value);
+  }
+}
@@ -1,22 +1,121 @@
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
+#include "clox/clox.h"
 #include "clox/core/io.h"
+#include "clox/core/memory.h"
 #include "clox/utils/error.h"
+#include "clox/vm/profiler.h"
 #include "clox/vm/vm.h"
 
+#define USAGE                                                                  \
+  "Usage: clox [--mem-stats] [--ic-stats] [--register-vm]"                     \
+  " [--register-stats] [--profile] [--profile-sample]"                         \
+  " [--profile-folded=FILE] [path | -]\n"
+
+static Profiler profiler;
+static const char *foldedPath = NULL; ///< --profile-folded output
+static const char *scriptName = "repl"; ///< Root frame of folded stacks
+
+/// @brief Runs at exit, so error exits are reported too
+static void reportMemoryStats(void) {
+  printMemoryStats(stderr, getMemoryStats());
+}
+
+/// @brief Runs at exit like reportMemoryStats(), registered after it
+static void reportProfile(void) {
+  stopProfiler(&profiler);
+  printProfile(stderr, &profiler);
+  if (foldedPath != NULL) {
+    FILE *folded = fopen(foldedPath, "w");
+    if (folded == NULL) {
+      fprintf(stderr, "Could not write \"%s\".\n", foldedPath);
+    } else {
+      writeFoldedStacks(folded, &profiler, scriptName);
+      fclose(folded);
+    }
+  }
+  freeProfiler(&profiler);
+}
+
+/// @brief `clock()`: processor time used so far, in seconds
+static bool clockNative(CloxVM *vm, int argCount, const CloxValue *args,
+                        CloxValue *result) {
+  (void)vm;
+  (void)argCount;
+  (void)args;
+  *result = cloxNumber((double)clock() / CLOCKS_PER_SEC);
+  return true;
+}
+
 int main(int argc, char *argv[]) {
+  (void)argc;
+  bool memStats = false;
+  bool icStats = false;
+  bool registerStats = false;
+  VMBackend backend = VM_BACKEND_STACK;
+  unsigned profileMode = 0;
+
+  /// argv ends with a NULL pointer; options come before the path
+  char **args = argv + 1;
+  for (; *args != NULL && strncmp(*args, "--", 2) == 0; ++args) {
+    if (strcmp(*args, "--mem-stats") == 0) {
+      memStats = true;
+    } else if (strcmp(*args, "--ic-stats") == 0) {
+      icStats = true;
+    } else if (strcmp(*args, "--register-vm") == 0) {
+      backend = VM_BACKEND_REGISTER;
+    } else if (strcmp(*args, "--register-stats") == 0) {
+      registerStats = true;
+    } else if (strcmp(*args, "--profile") == 0) {
+      profileMode |= PROFILE_COUNT;
+    } else if (strcmp(*args, "--profile-sample") == 0) {
+      profileMode |= PROFILE_SAMPLE;
+    } else if (strncmp(*args, "--profile-folded=", 17) == 0) {
+      foldedPath = *args + 17;
+    } else {
+      break;
+    }
+  }
+  if (*args != NULL && (strncmp(*args, "--", 2) == 0 || args[1] != NULL)) {
+    fatalError(ERR_USAGE, USAGE);
+  }
+  /// Flame graphs are normally drawn from samples
+  if (foldedPath != NULL && profileMode == 0) {
+    profileMode = PROFILE_SAMPLE;
+  }
+  if (profileMode != 0 && backend == VM_BACKEND_REGISTER) {
+    fatalError(ERR_USAGE, "The profiler only supports the stack VM.\n");
+  }
+  if (memStats) {
+    atexit(reportMemoryStats);
+  }
+
   VM vm;
   initVM(&vm);
+  vm.backend = backend;
+  vm.icStats = icStats;
+  vm.registerStats = registerStats;
+  (void)defineNative(&vm, "clock", 0, clockNative);
+  if (profileMode != 0) {
+    if (*args != NULL) {
+      scriptName = strcmp(*args, "-") == 0 ? "stdin" : *args;
+    }
+    initProfiler(&profiler, profileMode, PROFILE_DEFAULT_INTERVAL);
+    vm.profiler = &profiler;
+    atexit(reportProfile);
+    startProfiler(&profiler);
+  }
 
-  if (argc == 1) {
+  if (*args == NULL) {
     runREPL(&vm);
-  } else if (argc == 2) {
-    executeFile(&vm, argv[1]);
   } else {
-    fatalError(ERR_USAGE, "Usage: clox [path]\n");
+    executeFile(&vm, *args);
   }
   freeVM(&vm);
 
@@ -1,11 +1,51 @@
+#include <inttypes.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 
 #include "clox/core/chunk.h"
+#include "clox/core/inline_cache.h"
+#include "clox/core/object.h"
 #include "clox/core/value.h"
 #include "clox/utils/debug.h"
 
+static const char *const opcodeNames[UINT8_MAX + 1] = {
+    [OP_CONSTANT] = "OP_CONSTANT",
+    [OP_CONSTANT_LONG] = "OP_CONSTANT_LONG",
+    [OP_NIL] = "OP_NIL",
+    [OP_TRUE] = "OP_TRUE",
+    [OP_FALSE] = "OP_FALSE",
+    [OP_POP] = "OP_POP",
+    [OP_EQUAL] = "OP_EQUAL",
+    [OP_GREATER] = "OP_GREATER",
+    [OP_LESS] = "OP_LESS",
+    [OP_ADD] = "OP_ADD",
+    [OP_SUBTRACT] = "OP_SUBTRACT",
+    [OP_MULTIPLY] = "OP_MULTIPLY",
+    [OP_DIVIDE] = "OP_DIVIDE",
+    [OP_NOT] = "OP_NOT",
+    [OP_NEGATE] = "OP_NEGATE",
+    [OP_PRINT] = "OP_PRINT",
+    [OP_RETURN] = "OP_RETURN",
+    [OP_DEFINE_GLOBAL] = "OP_DEFINE_GLOBAL",
+    [OP_GET_GLOBAL] = "OP_GET_GLOBAL",
+    [OP_SET_GLOBAL] = "OP_SET_GLOBAL",
+    [OP_CALL] = "OP_CALL",
+    [OP_CLASS] = "OP_CLASS",
+    [OP_GET_PROPERTY] = "OP_GET_PROPERTY",
+    [OP_SET_PROPERTY] = "OP_SET_PROPERTY",
+    [OP_INVOKE] = "OP_INVOKE",
+    [OP_ADD_CONSTANT] = "OP_ADD_CONSTANT",
+    [OP_SUBTRACT_CONSTANT] = "OP_SUBTRACT_CONSTANT",
+    [OP_MULTIPLY_CONSTANT] = "OP_MULTIPLY_CONSTANT",
+    [OP_DIVIDE_CONSTANT] = "OP_DIVIDE_CONSTANT",
+    [OP_CONSTANT_CONSTANT] = "OP_CONSTANT_CONSTANT",
+};
+
+const char *opcodeName(uint8_t instruction) {
+  return opcodeNames[instruction];
+}
+
 static size_t constantInstruction(const char *name, Chunk *chunk,
                                   size_t offset) {
   uint8_t *codes = (uint8_t *)chunk->code.data;
@@ -18,32 +58,147 @@ static size_t constantInstruction(const char *name, Chunk *chunk,
   return offset + 2;
 }
 
+static size_t constantLongInstruction(const char *name, Chunk *chunk,
+                                      size_t offset) {
+  uint8_t *codes = (uint8_t *)chunk->code.data;
+  Value *values = (Value *)chunk->constants.data;
+  size_t constant_index = (size_t)codes[offset + 1] |
+                          ((size_t)codes[offset + 2] << 8) |
+                          ((size_t)codes[offset + 3] << 16);
+
+  printf("%-16s %4zu '", name, constant_index);
+  printValue(values[constant_index]);
+  printf("'\n");
+  return offset + 4;
+}
+
+static size_t constantPairInstruction(const char *name, Chunk *chunk,
+                                      size_t offset) {
+  uint8_t *codes = (uint8_t *)chunk->code.data;
+  Value *values = (Value *)chunk->constants.data;
+  uint8_t first = codes[offset + 1];
+  uint8_t second = codes[offset + 2];
+
+  printf("%-16s %4d '", name, first);
+  printValue(values[first]);
+  printf("' %d '", second);
+  printValue(values[second]);
+  printf("'\n");
+  return offset + 3;
+}
+
+static size_t byteInstruction(const char *name, Chunk *chunk, size_t offset) {
+  uint8_t *codes = (uint8_t *)chunk->code.data;
+  printf("%-16s %4d\n", name, codes[offset + 1]);
+  return offset + 2;
+}
+
+/// @brief The cache index, field name and (for OP_INVOKE) argument count
+static size_t propertyInstruction(const char *name, Chunk *chunk,
+                                  size_t offset) {
+  uint8_t *codes = (uint8_t *)chunk->code.data;
+  uint32_t cache = (uint32_t)(codes[offset + 1] | (codes[offset + 2] << 8));
+
+  printf("%-16s %4u '%s'", name, cache, chunkCache(chunk, cache)->name->chars);
+  if (codes[offset] == OP_INVOKE) {
+    printf(" (%d args)\n", codes[offset + 3]);
+    return offset + 4;
+  }
+  printf("\n");
+  return offset + 3;
+}
+
+static size_t globalInstruction(const char *name, Chunk *chunk,
+                                size_t offset) {
+  uint8_t *codes = (uint8_t *)chunk->code.data;
+  uint32_t slot = (uint32_t)(codes[offset + 1] | (codes[offset + 2] << 8));
+
+  /// Slots belong to the VM; the chunk's global list has their names
+  const char *global = "?";
+  for (size_t i = 0; i < chunk->globals.count; ++i) {
+    if (chunkGlobal(chunk, i)->slot == slot) {
+      global = chunkGlobal(chunk, i)->name->chars;
+      break;
+    }
+  }
+  printf("%-16s %4u '%s'\n", name, slot, global);
+  return offset + 3;
+}
+
 static size_t simpleInstruction(const char *name, size_t offset) {
   printf("%s\n", name);
   return offset + 1;
 }
 
-size_t disassembleInstruction(Chunk *chunk, size_t offset) {
-  printf("%04zu %04zu ", offset, getLine(chunk, offset));
+/// @brief Print one instruction whose source line is already known
+static size_t printInstruction(Chunk *chunk, size_t offset, size_t line) {
+  printf("%04zu %04zu ", offset, line);
 
   uint8_t *codes = (uint8_t *)chunk->code.data;
   uint8_t instruction = codes[offset];
+  const char *name = opcodeName(instruction);
 
   switch (instruction) {
   case OP_CONSTANT:
-    return constantInstruction("OP_CONSTANT", chunk, offset);
+    return constantInstruction(name, chunk, offset);
+  case OP_CONSTANT_LONG:
+    return constantLongInstruction(name, chunk, offset);
+  case OP_NIL:
+    return simpleInstruction(name, offset);
+  case OP_TRUE:
+    return simpleInstruction(name, offset);
+  case OP_FALSE:
+    return simpleInstruction(name, offset);
+  case OP_POP:
+    return simpleInstruction(name, offset);
+  case OP_EQUAL:
+    return simpleInstruction(name, offset);
+  case OP_GREATER:
+    return simpleInstruction(name, offset);
+  case OP_LESS:
+    return simpleInstruction(name, offset);
   case OP_ADD:
-    return simpleInstruction("OP_ADD", offset);
+    return simpleInstruction(name, offset);
   case OP_SUBTRACT:
-    return simpleInstruction("OP_SUBTRACT", offset);
+    return simpleInstruction(name, offset);
   case OP_MULTIPLY:
-    return simpleInstruction("OP_MULTIPLY", offset);
+    return simpleInstruction(name, offset);
   case OP_DIVIDE:
-    return simpleInstruction("OP_DIVIDE", offset);
+    return simpleInstruction(name, offset);
+  case OP_NOT:
+    return simpleInstruction(name, offset);
   case OP_NEGATE:
-    return simpleInstruction("OP_NEGATE", offset);
+    return simpleInstruction(name, offset);
+  case OP_PRINT:
+    return simpleInstruction(name, offset);
   case OP_RETURN:
-    return simpleInstruction("OP_RETURN", offset);
+    return simpleInstruction(name, offset);
+  case OP_DEFINE_GLOBAL:
+    return globalInstruction(name, chunk, offset);
+  case OP_GET_GLOBAL:
+    return globalInstruction(name, chunk, offset);
+  case OP_SET_GLOBAL:
+    return globalInstruction(name, chunk, offset);
+  case OP_CALL:
+    return byteInstruction(name, chunk, offset);
+  case OP_CLASS:
+    return simpleInstruction(name, offset);
+  case OP_GET_PROPERTY:
+    return propertyInstruction(name, chunk, offset);
+  case OP_SET_PROPERTY:
+    return propertyInstruction(name, chunk, offset);
+  case OP_INVOKE:
+    return propertyInstruction(name, chunk, offset);
+  case OP_ADD_CONSTANT:
+    return constantInstruction(name, chunk, offset);
+  case OP_SUBTRACT_CONSTANT:
+    return constantInstruction(name, chunk, offset);
+  case OP_MULTIPLY_CONSTANT:
+    return constantInstruction(name, chunk, offset);
+  case OP_DIVIDE_CONSTANT:
+    return constantInstruction(name, chunk, offset);
+  case OP_CONSTANT_CONSTANT:
+    return constantPairInstruction(name, chunk, offset);
   default:
     printf("%-16s %4s %s\n", "UNKNOWN", "-", "opcode");
     printf("     (raw byte = %d)\n", instruction);
@@ -51,12 +206,169 @@ size_t disassembleInstruction(Chunk *chunk, size_t offset) {
   }
 }
 
+size_t disassembleInstruction(Chunk *chunk, size_t offset) {
+  return printInstruction(chunk, offset, getLine(chunk, offset));
+}
+
+/// @brief Same as disassembleInstruction(), resolving the line via `lines`
+size_t disassembleInstructionAt(Chunk *chunk, size_t offset,
+                                LineIterator *lines) {
+  return printInstruction(chunk, offset, lineIteratorSeek(lines, offset));
+}
+
 void disassembleChunk(Chunk *chunk, const char *name) {
   printf("== %s ==\n", name);
   printf("%-4s %-4s %-16s %-4s %s\n", "Code", "Line", "OpCode", "Slot",
          "Value");
 
+  LineIterator lines;
+  initLineIterator(&lines, chunk);
   for (size_t offset = 0; offset < chunk->code.count;) {
-    offset = disassembleInstruction(chunk, offset);
+    offset = disassembleInstructionAt(chunk, offset, &lines);
+  }
+}
+
+static const char *inlineCacheState(const InlineCache *cache) {
+  if (cache->count == 0) {
+    return "uninitialized";
+  }
+  if (cache->count == 1) {
+    return "monomorphic";
+  }
+  return cache->count <= IC_WAYS ? "polymorphic" : "megamorphic";
+}
+
+void printInlineCaches(FILE *out, const Chunk *chunk) {
+  if (chunk->caches.count == 0) {
+    return;
+  }
+  fprintf(out, "== inline caches ==\n");
+  fprintf(out, "%-4s %-4s %-16s %-16s %-13s %12s %12s\n", "Code", "Line",
+          "OpCode", "Name", "State", "Hits", "Misses");
+
+  /// Caches are indexed from the code, so walk it to find each site
+  const uint8_t *code = (const uint8_t *)chunk->code.data;
+  LineIterator lines;
+  initLineIterator(&lines, chunk);
+  for (size_t offset = 0; offset < chunk->code.count;) {
+    uint8_t instruction = code[offset];
+    size_t length = instructionLength(instruction);
+    if (length == 0) {
+      break;
+    }
+    if (instruction == OP_GET_PROPERTY || instruction == OP_SET_PROPERTY ||
+        instruction == OP_INVOKE) {
+      const InlineCache *cache = chunkCache(
+          chunk, (size_t)(code[offset + 1] | (code[offset + 2] << 8)));
+      fprintf(out, "%04zu %04zu %-16s %-16s %-13s %12" PRIu64 " %12" PRIu64
+                   "\n",
+              offset, lineIteratorSeek(&lines, offset),
+              opcodeName(instruction), cache->name->chars,
+              inlineCacheState(cache), cache->hits, cache->misses);
+    }
+    offset += length;
+  }
+
+  /// Sum per cache: past 65536 sites, sites share caches (see compiler.c)
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  for (size_t i = 0; i < chunk->caches.count; ++i) {
+    hits += chunkCache(chunk, i)->hits;
+    misses += chunkCache(chunk, i)->misses;
+  }
+  uint64_t lookups = hits + misses;
+  fprintf(out, "%zu caches, %" PRIu64 " hits, %" PRIu64 " misses",
+          chunk->caches.count, hits, misses);
+  if (lookups > 0) {
+    fprintf(out, " (%.1f%% hit rate)", 100.0 * (double)hits / (double)lookups);
+  }
+  fprintf(out, "\n");
+}
+
+void printRegisterStats(FILE *out, const RegChunk *chunk) {
+  if (chunk == NULL) {
+    fprintf(out, "register vm: not translated, run on the stack VM\n");
+    return;
+  }
+  fprintf(out, "register vm: translated, %zu instructions, %zu slots\n",
+          chunk->code.count, chunk->slotCount);
+}
+
+/// @brief Mnemonics and number of source operands, indexed by RegOpCode
+static const struct {
+  const char *name;
+  int sources;
+} regOpInfo[REG_OP_COUNT] = {
+    [REG_ADD] = {"REG_ADD", 2},
+    [REG_SUBTRACT] = {"REG_SUBTRACT", 2},
+    [REG_MULTIPLY] = {"REG_MULTIPLY", 2},
+    [REG_DIVIDE] = {"REG_DIVIDE", 2},
+    [REG_EQUAL] = {"REG_EQUAL", 2},
+    [REG_GREATER] = {"REG_GREATER", 2},
+    [REG_LESS] = {"REG_LESS", 2},
+    [REG_NOT_EQUAL] = {"REG_NOT_EQUAL", 2},
+    [REG_NOT_GREATER] = {"REG_NOT_GREATER", 2},
+    [REG_NOT_LESS] = {"REG_NOT_LESS", 2},
+    [REG_NOT] = {"REG_NOT", 1},
+    [REG_NEGATE] = {"REG_NEGATE", 1},
+    [REG_GET_GLOBAL] = {"REG_GET_GLOBAL", 1},
+    [REG_SET_GLOBAL] = {"REG_SET_GLOBAL", 1},
+    [REG_DEFINE_GLOBAL] = {"REG_DEFINE_GLOBAL", 1},
+    [REG_PRINT] = {"REG_PRINT", 0},
+    [REG_RETURN] = {"REG_RETURN", -1},
+};
+
+/// @brief Print a slot as `k<n> 'value'` (constant) or `r<n>` (temporary)
+static void printRegSlot(const RegChunk *chunk, uint32_t slot,
+                         const Value *slots) {
+  const Value *constants = (const Value *)chunk->constants.data;
+  if (slot < chunk->constants.count) {
+    printf(" k%u '", slot);
+    printValue(constants[slot]);
+    printf("'");
+  } else if (slots != NULL) {
+    printf(" r%u [", slot);
+    printValue(slots[slot]);
+    printf("]");
+  } else {
+    printf(" r%u", slot);
+  }
+}
+
+void disassembleRegInstruction(const RegChunk *chunk, size_t index,
+                               const Value *slots) {
+  RegInstruction instruction =
+      ((const RegInstruction *)chunk->code.data)[index];
+  uint8_t op = regOp(instruction);
+  printf("%04zu %04zu ", index, getRegLine(chunk, index));
+
+  if (op >= REG_OP_COUNT) {
+    printf("%-16s %4s %s\n", "UNKNOWN", "-", "opcode");
+    return;
+  }
+  printf("%-16s", regOpInfo[op].name);
+  if (op == REG_GET_GLOBAL) {
+    /// Global slots are printed as `g<n>`
+    printf(" r%u <- g%u", regA(instruction), regB(instruction));
+  } else if (op == REG_SET_GLOBAL || op == REG_DEFINE_GLOBAL) {
+    printf(" g%u <-", regA(instruction));
+    printRegSlot(chunk, regB(instruction), slots);
+  } else if (regOpInfo[op].sources == 0) {
+    printRegSlot(chunk, regA(instruction), slots);
+  } else if (regOpInfo[op].sources > 0) {
+    printf(" r%u <-", regA(instruction));
+    printRegSlot(chunk, regB(instruction), slots);
+    if (regOpInfo[op].sources > 1) {
+      printRegSlot(chunk, regC(instruction), slots);
+    }
+  }
+  printf("\n");
+}
+
+void disassembleRegChunk(const RegChunk *chunk, const char *name) {
+  printf("== %s (%zu slots, %zu constants) ==\n", name, chunk->slotCount,
+         chunk->constants.count);
+  for (size_t index = 0; index < chunk->code.count; ++index) {
+    disassembleRegInstruction(chunk, index, NULL);
   }
 }
@@ -1,22 +1,47 @@
 #include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 
 #include "clox/core/memory.h"
 #include "clox/utils/dynarr.h"
+#include "clox/utils/error.h"
 
-void initDynArray(DynArray *array, size_t elemSize) {
+void initDynArray(DynArray *array, size_t elemSize, MemoryTag tag) {
   array->count = 0;
   array->capacity = 0;
   array->elemSize = elemSize;
+  array->tag = tag;
   array->data = NULL;
 }
 
-void pushDynArray(DynArray *array, void *element) {
-  if (array->capacity < array->count + 1) {
-    size_t oldSize = array->capacity;
-    array->capacity = grow_capacity(oldSize);
-    array->data = grow_array(array->data, oldSize, array->capacity,
-                             sizeof(array->elemSize));
+/// @brief Reallocate to exactly `capacity` elements, refusing size overflow
+static void resizeDynArray(DynArray *array, size_t capacity) {
+  if (capacity > SIZE_MAX / array->elemSize) {
+    fatalError(ERR_FAILURE, "Dynamic array too large (%zu x %zu bytes)",
+               capacity, array->elemSize);
+  }
+  array->data = grow_array(array->data, array->capacity, capacity,
+                           array->elemSize, array->tag);
+  array->capacity = capacity;
+}
+
+void growDynArray(DynArray *array) {
+  if (array->capacity > SIZE_MAX / 2) {
+    fatalError(ERR_FAILURE, "Dynamic array too large (%zu elements)",
+               array->capacity);
+  }
+  resizeDynArray(array, grow_capacity(array->capacity));
+}
+
+void reserveDynArray(DynArray *array, size_t capacity) {
+  if (capacity > array->capacity) {
+    resizeDynArray(array, capacity);
+  }
+}
+
+void pushDynArray(DynArray *array, const void *element) {
+  if (array->count == array->capacity) {
+    growDynArray(array);
   }
 
   memcpy((char *)array->data + (array->count * array->elemSize), element,
@@ -25,7 +50,43 @@ void pushDynArray(DynArray *array, void *element) {
   array->count++;
 }
 
+void pushManyDynArray(DynArray *array, const void *elements, size_t count) {
+  if (count == 0) {
+    return;
+  }
+  if (count > SIZE_MAX - array->count) {
+    fatalError(ERR_FAILURE, "Dynamic array too large (%zu + %zu elements)",
+               array->count, count);
+  }
+
+  size_t needed = array->count + count;
+  if (needed > array->capacity) {
+    /// Keep growth geometric so repeated bulk appends stay amortized O(1)
+    size_t doubled = array->capacity > SIZE_MAX / 2
+                         ? needed
+                         : grow_capacity(array->capacity);
+    resizeDynArray(array, needed > doubled ? needed : doubled);
+  }
+
+  memcpy((char *)array->data + (array->count * array->elemSize), elements,
+         count * array->elemSize);
+  array->count = needed;
+}
+
+void shrinkToFitDynArray(DynArray *array) {
+  /// A capacity below the count marks borrowed storage (see cache.c)
+  if (array->capacity <= array->count) {
+    return;
+  }
+  if (array->count == 0) {
+    freeDynArray(array);
+    return;
+  }
+  resizeDynArray(array, array->count);
+}
+
 void freeDynArray(DynArray *array) {
-  array->data = free_array(array->data, array->capacity, array->elemSize);
-  initDynArray(array, array->elemSize);
+  array->data = free_array(array->data, array->capacity, array->elemSize,
+                           array->tag);
+  initDynArray(array, array->elemSize, array->tag);
 }
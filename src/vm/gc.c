@@ -0,0 +1,373 @@
+/// clock_gettime() is POSIX
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "clox/core/chunk.h"
+#include "clox/core/globals.h"
+#include "clox/core/inline_cache.h"
+#include "clox/core/memory.h"
+#include "clox/core/object.h"
+#include "clox/core/table.h"
+#include "clox/core/value.h"
+#include "clox/utils/dynarr.h"
+#include "clox/vm/gc.h"
+#include "clox/vm/vm.h"
+
+/// @brief State of one collection, or of one slice of a major one
+typedef struct Collector {
+  Heap *heap;
+  bool minor;      ///< Promoting the nursery, otherwise marking
+  size_t promoted; ///< Bytes copied out of the nursery
+  size_t work;     ///< References visited, see Heap.sliceBudget
+} Collector;
+
+static uint64_t nowNs(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * @brief Reach `object`: promote it in a minor collection, shade it in a
+ * major one.
+ *
+ * Marking leaves the nursery to minor collections, which promote every
+ * young object still alive before the marking ends.
+ *
+ * @return Where `object` lives now, to store back into the reference.
+ */
+static Obj *visitObject(Collector *gc, Obj *object) {
+  gc->work++;
+  if (object == NULL) {
+    return NULL;
+  }
+  if (!gc->minor) {
+    if ((object->flags & OBJ_YOUNG) == 0 && !isMarked(gc->heap, object)) {
+      shadeObject(gc->heap, object);
+    }
+    return object;
+  }
+  if ((object->flags & OBJ_YOUNG) == 0) {
+    return object;
+  }
+  if ((object->flags & OBJ_FORWARDED) != 0) {
+    return object->next;
+  }
+  object = promoteObject(gc->heap, object);
+  gc->promoted += objectSize(object);
+  /// Strings point to nothing
+  if (object->type != OBJ_STRING) {
+    pushObjectDynArray(&gc->heap->survivors, object);
+  }
+  return object;
+}
+
+static void visitValue(Collector *gc, Value *slot) {
+  if (IS_OBJ(*slot)) {
+    *slot = OBJ_VAL(visitObject(gc, AS_OBJ(*slot)));
+  }
+}
+
+static void visitString(Collector *gc, ObjString **slot) {
+  *slot = (ObjString *)visitObject(gc, (Obj *)*slot);
+}
+
+static void visitShape(Collector *gc, ObjShape **slot) {
+  *slot = (ObjShape *)visitObject(gc, (Obj *)*slot);
+}
+
+/// @note A moved key hashes the same, so its entry stays valid
+static void visitTable(Collector *gc, Table *table) {
+  for (size_t i = 0; i < table->capacity; ++i) {
+    Entry *entry = &table->entries[i];
+    if (entry->key != NULL) {
+      visitString(gc, &entry->key);
+      visitValue(gc, &entry->value);
+    }
+  }
+}
+
+/// @brief Visit the objects `object` points to
+static void traceObject(Collector *gc, Obj *object) {
+  switch ((int)object->type) {
+  case OBJ_NATIVE:
+    visitString(gc, &((ObjNative *)object)->name);
+    break;
+  case OBJ_CLASS: {
+    ObjClass *klass = (ObjClass *)object;
+    visitString(gc, &klass->name);
+    visitShape(gc, &klass->rootShape);
+    break;
+  }
+  case OBJ_SHAPE: {
+    ObjShape *shape = (ObjShape *)object;
+    visitShape(gc, &shape->parent);
+    visitString(gc, &shape->key);
+    visitTable(gc, &shape->transitions);
+    break;
+  }
+  case OBJ_INSTANCE: {
+    ObjInstance *instance = (ObjInstance *)object;
+    instance->klass = (ObjClass *)visitObject(gc, &instance->klass->obj);
+    visitShape(gc, &instance->shape);
+    for (uint32_t i = 0; i < instance->shape->fieldCount; ++i) {
+      visitValue(gc, &instance->fields[i]);
+    }
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+/// @brief Trace the objects a minor collection promoted, transitively
+static void traceSurvivors(Collector *gc) {
+  DynArray *survivors = &gc->heap->survivors;
+  while (survivors->count > 0) {
+    traceObject(gc, ((Obj **)survivors->data)[--survivors->count]);
+  }
+}
+
+/// @brief Trace gray objects until none is left or the budget is spent
+static void traceGray(Collector *gc) {
+  DynArray *gray = &gc->heap->gray;
+  while (gray->count > 0 && gc->work < gc->heap->sliceBudget) {
+    traceObject(gc, ((Obj **)gray->data)[--gray->count]);
+  }
+}
+
+/**
+ * @brief Visit the objects of `chunk`.
+ *
+ * A minor collection skips chunks it already promoted everything of, a
+ * major one those it visited before: constants and names do not change,
+ * and updateInlineCache() shades the shapes it caches.
+ */
+static void visitChunk(Collector *gc, Chunk *chunk) {
+  if (gc->minor ? chunk->tenured : chunk->markedCycle == gc->heap->cycle) {
+    return;
+  }
+  Value *constants = (Value *)chunk->constants.data;
+  for (size_t i = 0; i < chunk->constants.count; ++i) {
+    visitValue(gc, &constants[i]);
+  }
+  ChunkGlobal *globals = (ChunkGlobal *)chunk->globals.data;
+  for (size_t i = 0; i < chunk->globals.count; ++i) {
+    visitString(gc, &globals[i].name);
+  }
+  /// Shapes are always old; cached ones are kept alive rather than cleared
+  for (size_t i = 0; i < chunk->caches.count; ++i) {
+    InlineCache *cache = chunkCache(chunk, i);
+    visitString(gc, &cache->name);
+    for (size_t way = 0; way < IC_WAYS && !gc->minor; ++way) {
+      visitShape(gc, &cache->entries[way].shape);
+      visitShape(gc, &cache->entries[way].next);
+    }
+  }
+  if (gc->minor) {
+    chunk->tenured = true;
+  } else {
+    chunk->markedCycle = gc->heap->cycle;
+  }
+}
+
+/**
+ * @brief Visit the global slots.
+ *
+ * Names never change, so a minor collection only visits those added since
+ * the last one; the key of a promoted name moves to the copy.
+ */
+static void visitGlobals(Collector *gc, Globals *globals) {
+  ObjString **names = (ObjString **)globals->names.data;
+  size_t first = gc->minor ? globals->tenuredNames : 0;
+  for (size_t slot = first; slot < globals->names.count; ++slot) {
+    ObjString *name = names[slot];
+    visitString(gc, &names[slot]);
+    if (names[slot] != name) {
+      tableReplaceKey(&globals->slots, name, names[slot]);
+    }
+  }
+  if (gc->minor) {
+    globals->tenuredNames = globals->names.count;
+  }
+
+  Value *values = globalValues(globals);
+  for (size_t slot = 0; slot < globals->values.count; ++slot) {
+    visitValue(gc, &values[slot]);
+  }
+}
+
+static void visitRoots(Collector *gc, VM *vm) {
+  for (Value *slot = vm->stack; slot < vm->stackTop; ++slot) {
+    visitValue(gc, slot);
+  }
+  const RegChunk *registerChunk = vm->registerChunk;
+  if (registerChunk != NULL) {
+    for (size_t slot = 0; slot < registerChunk->slotCount; ++slot) {
+      visitValue(gc, &vm->registers[slot]);
+    }
+    Value *constants = (Value *)registerChunk->constants.data;
+    for (size_t i = 0; i < registerChunk->constants.count; ++i) {
+      visitValue(gc, &constants[i]);
+    }
+  }
+
+  visitGlobals(gc, &vm->globals);
+
+  if (vm->chunk != NULL) {
+    visitChunk(gc, vm->chunk);
+  }
+  Chunk **chunks = (Chunk **)vm->chunks.data;
+  for (size_t i = 0; i < vm->chunks.count; ++i) {
+    visitChunk(gc, chunks[i]);
+  }
+}
+
+static void initCollector(Collector *gc, Heap *heap, bool minor) {
+  gc->heap = heap;
+  gc->minor = minor;
+  gc->promoted = 0;
+  gc->work = 0;
+}
+
+static void minorCollection(VM *vm) {
+  Heap *heap = &vm->heap;
+  if (heap->nursery == NULL) {
+    return;
+  }
+  Collector gc;
+  initCollector(&gc, heap, true);
+
+  visitRoots(&gc, vm);
+  Obj **remembered = (Obj **)heap->remembered.data;
+  for (size_t i = 0; i < heap->remembered.count; ++i) {
+    remembered[i]->flags &= (uint8_t)~OBJ_REMEMBERED;
+    traceObject(&gc, remembered[i]);
+  }
+  heap->remembered.count = 0;
+  traceSurvivors(&gc);
+
+  /// Interned strings that were not promoted leave the intern table
+  ObjString **strings = (ObjString **)heap->youngStrings.data;
+  for (size_t i = 0; i < heap->youngStrings.count; ++i) {
+    ObjString *string = strings[i];
+    if ((string->obj.flags & OBJ_FORWARDED) != 0) {
+      tableReplaceKey(&heap->strings, string, (ObjString *)string->obj.next);
+    } else {
+      tableDelete(&heap->strings, string);
+    }
+  }
+  resetNursery(heap);
+
+  recordCollection(&heap->stats, GC_MINOR, gc.promoted);
+}
+
+/**
+ * @brief Start marking: unmark every old object by flipping the mark
+ * sense, then shade the roots.
+ */
+static void startMarking(Collector *gc, VM *vm) {
+  gc->heap->markSense ^= OBJ_MARKED;
+  gc->heap->phase = GC_MARKING;
+  gc->heap->cycle++;
+  gc->heap->freedBytes = 0;
+  visitRoots(gc, vm);
+}
+
+/**
+ * @brief Finish marking once the gray objects run out.
+ *
+ * The barrier only covers stores into objects, so the nursery is promoted
+ * (marking its survivors gray) and the roots are visited again; whatever
+ * that shades is traced within the remaining budget, or by later slices
+ * that come back here. Marking is over when nothing is left gray, and the
+ * old generation is then handed to the sweep.
+ */
+static void finishMarking(Collector *gc, VM *vm) {
+  Heap *heap = gc->heap;
+  minorCollection(vm);
+  visitRoots(gc, vm);
+  traceGray(gc);
+  if (heap->gray.count > 0) {
+    return;
+  }
+  heap->phase = GC_SWEEPING;
+  heap->sweeping = heap->objects;
+  heap->objects = NULL;
+}
+
+/**
+ * @brief Free the unmarked objects of the sweep list, until it is empty or
+ * the budget is spent; the marked ones go back to the old generation.
+ *
+ * A dead string leaves the intern table with its memory. Objects that
+ * became old since the marking ended are not on the list, and nothing
+ * reaches the dead ones anymore, except the intern table (reviveString()).
+ */
+static void sweepSlice(Collector *gc) {
+  Heap *heap = gc->heap;
+  while (heap->sweeping != NULL && gc->work < heap->sliceBudget) {
+    Obj *object = heap->sweeping;
+    heap->sweeping = object->next;
+    gc->work++;
+    if (isMarked(heap, object)) {
+      object->next = heap->objects;
+      heap->objects = object;
+      continue;
+    }
+    if (object->type == OBJ_STRING) {
+      tableDelete(&heap->strings, (ObjString *)object);
+    }
+    heap->freedBytes += objectSize(object);
+    freeObject(heap, object);
+  }
+  if (heap->sweeping != NULL) {
+    return;
+  }
+
+  heap->phase = GC_IDLE;
+  heap->nextMajor = heap->oldBytes * GC_HEAP_GROW_FACTOR;
+  if (heap->nextMajor < HEAP_MIN_OLD_BYTES) {
+    heap->nextMajor = HEAP_MIN_OLD_BYTES;
+  }
+  recordCollection(&heap->stats, GC_MAJOR, heap->freedBytes);
+}
+
+/// @brief Advance the major collection by about Heap.sliceBudget work
+static void majorSlice(VM *vm) {
+  Collector gc;
+  initCollector(&gc, &vm->heap, false);
+  if (vm->heap.phase == GC_IDLE) {
+    startMarking(&gc, vm);
+  }
+  if (vm->heap.phase == GC_MARKING) {
+    traceGray(&gc);
+    if (vm->heap.gray.count == 0) {
+      finishMarking(&gc, vm);
+    }
+  }
+  if (vm->heap.phase == GC_SWEEPING) {
+    sweepSlice(&gc);
+  }
+}
+
+void collectGarbage(VM *vm, bool force) {
+  Heap *heap = &vm->heap;
+  uint64_t start = nowNs();
+  if (force || heap->nurseryFull) {
+    minorCollection(vm);
+    uint64_t end = nowNs();
+    recordGcPause(&heap->stats, GC_MINOR, end - start);
+    start = end;
+  }
+  if (heap->phase != GC_IDLE || force || heap->oldBytes > heap->nextMajor) {
+    majorSlice(vm);
+    recordGcPause(&heap->stats, GC_MAJOR, nowNs() - start);
+  }
+  /// Come back at the next safe point while a major collection runs
+  heap->collectRequested = heap->phase != GC_IDLE;
+}
@@ -0,0 +1,361 @@
+/// sigaction() is POSIX, setitimer() needs the XSI/default extensions
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include <inttypes.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "clox/core/chunk.h"
+#include "clox/core/memory.h"
+#include "clox/utils/debug.h"
+#include "clox/utils/dynarr.h"
+#include "clox/utils/error.h"
+#include "clox/vm/profiler.h"
+
+/// @brief Profiler the SIGPROF handler records into
+static Profiler *volatile activeProfiler = NULL;
+
+/// @brief Sum of the entries of one opcode or one line
+typedef struct ProfileTotal {
+  size_t key; ///< Opcode or line
+  uint64_t count;
+  uint64_t ticks;
+  uint64_t samples;
+} ProfileTotal;
+
+static double wallSeconds(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Charge one sample to the instruction being executed.
+ *
+ * Only reads `current`, `codeCount` and `samples`, which the VM publishes
+ * behind signal fences, and only writes counters the VM never touches.
+ */
+static void sampleHandler(int signal) {
+  (void)signal;
+  Profiler *profiler = activeProfiler;
+  if (profiler == NULL) {
+    return;
+  }
+  const uint8_t *ip =
+      atomic_load_explicit(&profiler->current, memory_order_relaxed);
+  /// NULL (or a stale pointer) wraps around to a huge offset
+  size_t offset = (size_t)((uintptr_t)ip - (uintptr_t)profiler->code);
+  if (offset < profiler->codeCount) {
+    profiler->samples[offset]++;
+  } else {
+    profiler->outsideSamples++;
+  }
+}
+
+static void setSampleTimer(long interval) {
+  struct itimerval timer;
+  timer.it_interval.tv_sec = interval / 1000000;
+  timer.it_interval.tv_usec = interval % 1000000;
+  timer.it_value = timer.it_interval;
+  if (setitimer(ITIMER_PROF, &timer, NULL) != 0) {
+    fatalError(ERR_OS, "Could not set the profiling timer.\n");
+  }
+}
+
+void initProfiler(Profiler *profiler, unsigned mode, long interval) {
+  profiler->mode = mode;
+  profiler->interval = interval > 0 ? interval : PROFILE_DEFAULT_INTERVAL;
+  initDynArray(&profiler->entries, sizeof(ProfileEntry), MEM_PROFILER);
+  profiler->outsideSamples = 0;
+  profiler->seconds = 0.0;
+  profiler->chunk = NULL;
+  profiler->code = NULL;
+  profiler->codeCount = 0;
+  profiler->counts = NULL;
+  profiler->ticks = NULL;
+  profiler->samples = NULL;
+  profiler->previous = 0;
+  profiler->lastClock = 0;
+  atomic_init(&profiler->current, NULL);
+  profiler->startTime = 0.0;
+}
+
+void freeProfiler(Profiler *profiler) {
+  if (activeProfiler == profiler) {
+    stopProfiler(profiler);
+  }
+  freeDynArray(&profiler->entries);
+}
+
+void startProfiler(Profiler *profiler) {
+  profiler->startTime = wallSeconds();
+  if (!(profiler->mode & PROFILE_SAMPLE)) {
+    return;
+  }
+
+  activeProfiler = profiler;
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = sampleHandler;
+  /// Keep the REPL's reads going when a sample interrupts them
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(SIGPROF, &action, NULL) != 0) {
+    fatalError(ERR_OS, "Could not install the profiling signal handler.\n");
+  }
+  setSampleTimer(profiler->interval);
+}
+
+void stopProfiler(Profiler *profiler) {
+  profiler->seconds += wallSeconds() - profiler->startTime;
+  if (activeProfiler != profiler) {
+    return;
+  }
+  setSampleTimer(0);
+  signal(SIGPROF, SIG_IGN);
+  activeProfiler = NULL;
+}
+
+void beginProfileRun(Profiler *profiler, const Chunk *chunk) {
+  size_t count = chunk->code.count;
+  profiler->chunk = chunk;
+  profiler->code = (const uint8_t *)chunk->code.data;
+  profiler->counts =
+      grow_array(NULL, 0, count, sizeof(uint64_t), MEM_PROFILER);
+  profiler->ticks = grow_array(NULL, 0, count, sizeof(uint64_t), MEM_PROFILER);
+  profiler->samples =
+      grow_array(NULL, 0, count, sizeof(uint32_t), MEM_PROFILER);
+  memset(profiler->counts, 0, count * sizeof(uint64_t));
+  memset(profiler->ticks, 0, count * sizeof(uint64_t));
+  memset(profiler->samples, 0, count * sizeof(uint32_t));
+  profiler->previous = 0;
+  profiler->lastClock = readProfileClock();
+
+  /// The arrays must be in place before the handler can see an offset
+  atomic_store_explicit(&profiler->current, NULL, memory_order_relaxed);
+  atomic_signal_fence(memory_order_seq_cst);
+  profiler->codeCount = count;
+}
+
+void endProfileRun(Profiler *profiler) {
+  /// The instruction that returned ran until now
+  if (profiler->codeCount > 0) {
+    profiler->ticks[profiler->previous] +=
+        readProfileClock() - profiler->lastClock;
+  }
+
+  size_t count = profiler->codeCount;
+  atomic_store_explicit(&profiler->current, NULL, memory_order_relaxed);
+  profiler->codeCount = 0;
+  atomic_signal_fence(memory_order_seq_cst);
+
+  const Chunk *chunk = profiler->chunk;
+  const uint8_t *code = profiler->code;
+  LineIterator lines;
+  initLineIterator(&lines, chunk);
+  for (size_t offset = 0; offset < count;
+       offset += instructionLength(code[offset])) {
+    if (profiler->counts[offset] == 0 && profiler->ticks[offset] == 0 &&
+        profiler->samples[offset] == 0) {
+      continue;
+    }
+    ProfileEntry entry = {.line = lineIteratorSeek(&lines, offset),
+                          .opcode = code[offset],
+                          .count = profiler->counts[offset],
+                          .ticks = profiler->ticks[offset],
+                          .samples = profiler->samples[offset]};
+    pushDynArray(&profiler->entries, &entry);
+  }
+
+  profiler->counts =
+      free_array(profiler->counts, count, sizeof(uint64_t), MEM_PROFILER);
+  profiler->ticks =
+      free_array(profiler->ticks, count, sizeof(uint64_t), MEM_PROFILER);
+  profiler->samples =
+      free_array(profiler->samples, count, sizeof(uint32_t), MEM_PROFILER);
+  profiler->chunk = NULL;
+  profiler->code = NULL;
+}
+
+static int compareEntries(const void *a, const void *b) {
+  const ProfileEntry *lhs = a;
+  const ProfileEntry *rhs = b;
+  if (lhs->line != rhs->line) {
+    return lhs->line < rhs->line ? -1 : 1;
+  }
+  return (lhs->opcode > rhs->opcode) - (lhs->opcode < rhs->opcode);
+}
+
+/// @brief Sort the entries by (line, opcode) and merge repeated runs
+static void mergeEntries(Profiler *profiler) {
+  ProfileEntry *entries = profiler->entries.data;
+  size_t count = profiler->entries.count;
+  if (count == 0) {
+    return;
+  }
+  qsort(entries, count, sizeof(ProfileEntry), compareEntries);
+
+  size_t merged = 0;
+  for (size_t i = 1; i < count; ++i) {
+    ProfileEntry *last = &entries[merged];
+    if (entries[i].line == last->line && entries[i].opcode == last->opcode) {
+      last->count += entries[i].count;
+      last->ticks += entries[i].ticks;
+      last->samples += entries[i].samples;
+    } else {
+      entries[++merged] = entries[i];
+    }
+  }
+  profiler->entries.count = merged + 1;
+}
+
+/// @brief What reports sort and fold by: samples if taken, ticks otherwise
+static uint64_t totalWeight(const Profiler *profiler,
+                            const ProfileTotal *total) {
+  return (profiler->mode & PROFILE_SAMPLE) ? total->samples : total->ticks;
+}
+
+static const Profiler *sortingProfiler; ///< Context of compareTotals()
+
+/// @brief Heaviest first; ties (common with few samples) go by ticks
+static int compareTotals(const void *a, const void *b) {
+  const ProfileTotal *lhs = a;
+  const ProfileTotal *rhs = b;
+  uint64_t left = totalWeight(sortingProfiler, lhs);
+  uint64_t right = totalWeight(sortingProfiler, rhs);
+  if (left == right) {
+    left = lhs->ticks;
+    right = rhs->ticks;
+  }
+  return (left < right) - (left > right);
+}
+
+static void addToTotal(ProfileTotal *total, const ProfileEntry *entry) {
+  total->count += entry->count;
+  total->ticks += entry->ticks;
+  total->samples += entry->samples;
+}
+
+static double percent(uint64_t part, uint64_t whole) {
+  return whole == 0 ? 0.0 : 100.0 * (double)part / (double)whole;
+}
+
+static void printTotalHeader(FILE *out, const Profiler *profiler,
+                             const char *key) {
+  fprintf(out, "%-22s", key);
+  if (profiler->mode & PROFILE_COUNT) {
+    fprintf(out, " %12s %6s %14s %8s %6s", "count", "%", PROFILE_CLOCK_UNIT,
+            "per op", "%");
+  }
+  if (profiler->mode & PROFILE_SAMPLE) {
+    fprintf(out, " %9s %6s", "samples", "%");
+  }
+  fprintf(out, "\n");
+}
+
+static void printTotal(FILE *out, const Profiler *profiler,
+                       const ProfileTotal *total, const ProfileTotal *all) {
+  if (profiler->mode & PROFILE_COUNT) {
+    double perOp = total->count == 0
+                       ? 0.0
+                       : (double)total->ticks / (double)total->count;
+    fprintf(out, " %12" PRIu64 " %5.1f%% %14" PRIu64 " %8.1f %5.1f%%",
+            total->count, percent(total->count, all->count), total->ticks,
+            perOp, percent(total->ticks, all->ticks));
+  }
+  if (profiler->mode & PROFILE_SAMPLE) {
+    fprintf(out, " %9" PRIu64 " %5.1f%%", total->samples,
+            percent(total->samples, all->samples));
+  }
+  fprintf(out, "\n");
+}
+
+void printProfile(FILE *out, Profiler *profiler) {
+  mergeEntries(profiler);
+  const ProfileEntry *entries = profiler->entries.data;
+  size_t count = profiler->entries.count;
+
+  ProfileTotal all = {0};
+  ProfileTotal opcodes[UINT8_MAX + 1];
+  memset(opcodes, 0, sizeof(opcodes));
+  for (size_t op = 0; op <= UINT8_MAX; ++op) {
+    opcodes[op].key = op;
+  }
+  /// Entries are sorted by line, so each line is one run of entries
+  ProfileTotal *lines =
+      grow_array(NULL, 0, count, sizeof(ProfileTotal), MEM_PROFILER);
+  size_t lineCount = 0;
+  for (size_t i = 0; i < count; ++i) {
+    if (i == 0 || entries[i].line != entries[i - 1].line) {
+      lines[lineCount++] = (ProfileTotal){.key = entries[i].line};
+    }
+    addToTotal(&lines[lineCount - 1], &entries[i]);
+    addToTotal(&opcodes[entries[i].opcode], &entries[i]);
+    addToTotal(&all, &entries[i]);
+  }
+
+  sortingProfiler = profiler;
+  qsort(opcodes, UINT8_MAX + 1, sizeof(ProfileTotal), compareTotals);
+  qsort(lines, lineCount, sizeof(ProfileTotal), compareTotals);
+
+  fprintf(out, "== profile: %.3f ms", profiler->seconds * 1e3);
+  if (profiler->mode & PROFILE_COUNT) {
+    fprintf(out, ", %" PRIu64 " instructions", all.count);
+  }
+  if (profiler->mode & PROFILE_SAMPLE) {
+    fprintf(out,
+            ", %" PRIu64 " samples every %ld us (%" PRIu64 " outside the VM)",
+            all.samples + profiler->outsideSamples, profiler->interval,
+            profiler->outsideSamples);
+  }
+  fprintf(out, " ==\n");
+
+  printTotalHeader(out, profiler, "opcode");
+  for (size_t op = 0; op <= UINT8_MAX; ++op) {
+    if (opcodes[op].count == 0 && opcodes[op].samples == 0) {
+      continue;
+    }
+    const char *name = opcodeName((uint8_t)opcodes[op].key);
+    fprintf(out, "%-22s", name != NULL ? name : "UNKNOWN");
+    printTotal(out, profiler, &opcodes[op], &all);
+  }
+
+  fprintf(out, "\n");
+  printTotalHeader(out, profiler, "hottest lines");
+  for (size_t i = 0; i < lineCount && i < PROFILE_REPORT_LINES; ++i) {
+    fprintf(out, "line %-17zu", lines[i].key);
+    printTotal(out, profiler, &lines[i], &all);
+  }
+
+  free_array(lines, count, sizeof(ProfileTotal), MEM_PROFILER);
+}
+
+void writeFoldedStacks(FILE *out, Profiler *profiler, const char *script) {
+  mergeEntries(profiler);
+  const ProfileEntry *entries = profiler->entries.data;
+
+  for (size_t i = 0; i < profiler->entries.count; ++i) {
+    ProfileTotal total = {0};
+    addToTotal(&total, &entries[i]);
+    uint64_t weight = totalWeight(profiler, &total);
+    if (weight == 0) {
+      continue;
+    }
+    const char *name = opcodeName(entries[i].opcode);
+    fprintf(out, "%s;%s:%zu;%s %" PRIu64 "\n", script, script,
+            entries[i].line, name != NULL ? name : "UNKNOWN", weight);
+  }
+  if ((profiler->mode & PROFILE_SAMPLE) && profiler->outsideSamples > 0) {
+    fprintf(out, "%s;[outside the VM] %" PRIu64 "\n", script,
+            profiler->outsideSamples);
+  }
+}
@@ -0,0 +1,263 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "clox/core/memory.h"
+#include "clox/core/object.h"
+#include "clox/core/register_chunk.h"
+#include "clox/core/value.h"
+#include "clox/utils/debug.h"
+#include "clox/vm/dispatch.h"
+#include "clox/vm/gc.h"
+#include "clox/vm/vm.h"
+#include "config.h"
+
+/**
+ * @file register_vm.c
+ * @brief Execution loop of the experimental register VM.
+ *
+ * Uses the same dispatch strategy as the stack VM (see dispatch.h), but
+ * each handler decodes its slots from one 64-bit word and works on the
+ * register window in place, with no pushes or pops. The window is a root of
+ * the collector while the code runs, so `+` on strings reaches a safe point
+ * like it does on the stack.
+ */
+
+/// @brief Report a runtime error at instruction `index`
+__attribute__((format(printf, 3, 4))) static void
+registerError(const RegChunk *chunk, size_t index, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  fprintf(stderr, "Runtime error: ");
+  vfprintf(stderr, format, args);
+  fputs("\n", stderr);
+  va_end(args);
+
+  fprintf(stderr, "[line %zu] in script\n", getRegLine(chunk, index));
+}
+
+#ifdef DEBUG_TRACE_EXECUTION
+#define REG_TRACE()                                                            \
+  disassembleRegInstruction(chunk, (size_t)(ip - code), slots)
+#else
+#define REG_TRACE() ((void)0)
+#endif
+
+#ifdef CLOX_THREADED_DISPATCH
+#define REG_LOOP() REG_NEXT();
+#define REG_CASE(opcode) opcode:
+#define REG_DEFAULT() reg_unknown:
+#define REG_NEXT()                                                             \
+  do {                                                                         \
+    REG_TRACE();                                                               \
+    instruction = *ip++;                                                       \
+    goto *dispatchTable[regOp(instruction)];                                   \
+  } while (0)
+#else
+#define REG_LOOP()                                                             \
+  for (;;)                                                                     \
+    switch (REG_TRACE(), instruction = *ip++, regOp(instruction))
+#define REG_CASE(opcode) case opcode:
+#define REG_DEFAULT() default:
+#define REG_NEXT() continue
+#endif
+
+/// @brief Raise `message` unless B and C are numbers
+#define REG_BINARY_OP(valueType, op, message)                                  \
+  do {                                                                         \
+    Value b = slots[regB(instruction)];                                        \
+    Value c = slots[regC(instruction)];                                        \
+    if (!IS_NUMBER(b) || !IS_NUMBER(c)) {                                      \
+      registerError(chunk, (size_t)(ip - code) - 1, message);                  \
+      return INTERPRET_RUNTIME_ERROR;                                          \
+    }                                                                          \
+    slots[regA(instruction)] = valueType(AS_NUMBER(b) op AS_NUMBER(c));        \
+  } while (0)
+
+/// @brief A comparison whose result is negated, for `<=`, `>=` and `!=`
+#define REG_NEGATED_COMPARE(op)                                                \
+  do {                                                                         \
+    Value b = slots[regB(instruction)];                                        \
+    Value c = slots[regC(instruction)];                                        \
+    if (!IS_NUMBER(b) || !IS_NUMBER(c)) {                                      \
+      registerError(chunk, (size_t)(ip - code) - 1, NUMBER_OPERANDS_ERROR);    \
+      return INTERPRET_RUNTIME_ERROR;                                          \
+    }                                                                          \
+    slots[regA(instruction)] = BOOL_VAL(!(AS_NUMBER(b) op AS_NUMBER(c)));      \
+  } while (0)
+
+#ifdef CLOX_THREADED_DISPATCH
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#pragma GCC diagnostic ignored "-Woverride-init"
+#endif
+
+static InterpretResult executeRegisters(VM *vm, const RegChunk *chunk) {
+#ifdef CLOX_THREADED_DISPATCH
+  static void *const dispatchTable[UINT8_MAX + 1] = {
+      [0 ... UINT8_MAX] = &&reg_unknown,
+      [REG_ADD] = &&REG_ADD,
+      [REG_SUBTRACT] = &&REG_SUBTRACT,
+      [REG_MULTIPLY] = &&REG_MULTIPLY,
+      [REG_DIVIDE] = &&REG_DIVIDE,
+      [REG_EQUAL] = &&REG_EQUAL,
+      [REG_GREATER] = &&REG_GREATER,
+      [REG_LESS] = &&REG_LESS,
+      [REG_NOT_EQUAL] = &&REG_NOT_EQUAL,
+      [REG_NOT_GREATER] = &&REG_NOT_GREATER,
+      [REG_NOT_LESS] = &&REG_NOT_LESS,
+      [REG_NOT] = &&REG_NOT,
+      [REG_NEGATE] = &&REG_NEGATE,
+      [REG_GET_GLOBAL] = &&REG_GET_GLOBAL,
+      [REG_SET_GLOBAL] = &&REG_SET_GLOBAL,
+      [REG_DEFINE_GLOBAL] = &&REG_DEFINE_GLOBAL,
+      [REG_PRINT] = &&REG_PRINT,
+      [REG_RETURN] = &&REG_RETURN,
+  };
+#endif
+  const RegInstruction *code = (const RegInstruction *)chunk->code.data;
+  const RegInstruction *ip = code;
+  Value *slots = vm->registers;
+  RegInstruction instruction;
+
+  REG_LOOP() {
+    REG_CASE(REG_ADD) {
+      Value b = slots[regB(instruction)];
+      Value c = slots[regC(instruction)];
+      if (IS_NUMBER(b) && IS_NUMBER(c)) {
+        slots[regA(instruction)] = NUMBER_VAL(AS_NUMBER(b) + AS_NUMBER(c));
+      } else if (IS_STRING(b) && IS_STRING(c)) {
+        slots[regA(instruction)] = OBJ_VAL(
+            concatenateStrings(&vm->heap, AS_STRING(b), AS_STRING(c)));
+        gcSafePoint(vm);
+      } else {
+        registerError(chunk, (size_t)(ip - code) - 1, ADD_OPERANDS_ERROR);
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      REG_NEXT();
+    }
+    REG_CASE(REG_SUBTRACT) {
+      REG_BINARY_OP(NUMBER_VAL, -, NUMBER_OPERANDS_ERROR);
+      REG_NEXT();
+    }
+    REG_CASE(REG_MULTIPLY) {
+      REG_BINARY_OP(NUMBER_VAL, *, NUMBER_OPERANDS_ERROR);
+      REG_NEXT();
+    }
+    REG_CASE(REG_DIVIDE) {
+      REG_BINARY_OP(NUMBER_VAL, /, NUMBER_OPERANDS_ERROR);
+      REG_NEXT();
+    }
+    REG_CASE(REG_EQUAL) {
+      slots[regA(instruction)] = BOOL_VAL(
+          valuesEqual(slots[regB(instruction)], slots[regC(instruction)]));
+      REG_NEXT();
+    }
+    REG_CASE(REG_GREATER) {
+      REG_BINARY_OP(BOOL_VAL, >, NUMBER_OPERANDS_ERROR);
+      REG_NEXT();
+    }
+    REG_CASE(REG_LESS) {
+      REG_BINARY_OP(BOOL_VAL, <, NUMBER_OPERANDS_ERROR);
+      REG_NEXT();
+    }
+    REG_CASE(REG_NOT_EQUAL) {
+      slots[regA(instruction)] = BOOL_VAL(
+          !valuesEqual(slots[regB(instruction)], slots[regC(instruction)]));
+      REG_NEXT();
+    }
+    REG_CASE(REG_NOT_GREATER) {
+      REG_NEGATED_COMPARE(>);
+      REG_NEXT();
+    }
+    REG_CASE(REG_NOT_LESS) {
+      REG_NEGATED_COMPARE(<);
+      REG_NEXT();
+    }
+    REG_CASE(REG_NOT) {
+      slots[regA(instruction)] = BOOL_VAL(isFalsey(slots[regB(instruction)]));
+      REG_NEXT();
+    }
+    REG_CASE(REG_NEGATE) {
+      Value operand = slots[regB(instruction)];
+      if (!IS_NUMBER(operand)) {
+        registerError(chunk, (size_t)(ip - code) - 1,
+                      "Operand must be a number.");
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      slots[regA(instruction)] = NUMBER_VAL(-AS_NUMBER(operand));
+      REG_NEXT();
+    }
+    REG_CASE(REG_GET_GLOBAL) {
+      uint32_t slot = regB(instruction);
+      Value value = globalValues(&vm->globals)[slot];
+      if (IS_UNDEFINED(value)) {
+        registerError(chunk, (size_t)(ip - code) - 1,
+                      "Undefined variable '%s'.",
+                      globalName(&vm->globals, slot)->chars);
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      slots[regA(instruction)] = value;
+      REG_NEXT();
+    }
+    REG_CASE(REG_SET_GLOBAL) {
+      uint32_t slot = regA(instruction);
+      Value *global = &globalValues(&vm->globals)[slot];
+      /// Assignment never creates a global, only `var` does
+      if (IS_UNDEFINED(*global)) {
+        registerError(chunk, (size_t)(ip - code) - 1,
+                      "Undefined variable '%s'.",
+                      globalName(&vm->globals, slot)->chars);
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      *global = slots[regB(instruction)];
+      REG_NEXT();
+    }
+    REG_CASE(REG_DEFINE_GLOBAL) {
+      globalValues(&vm->globals)[regA(instruction)] = slots[regB(instruction)];
+      REG_NEXT();
+    }
+    REG_CASE(REG_PRINT) {
+      printValue(slots[regA(instruction)]);
+      printf("\n");
+      REG_NEXT();
+    }
+    REG_CASE(REG_RETURN) { return INTERPRET_OK; }
+    REG_DEFAULT() {
+      registerError(chunk, (size_t)(ip - code) - 1, "Unknown opcode %d.",
+                    regOp(instruction));
+      return INTERPRET_RUNTIME_ERROR;
+    }
+  }
+}
+
+#ifdef CLOX_THREADED_DISPATCH
+#pragma GCC diagnostic pop
+#endif
+
+InterpretResult interpretRegisterChunk(VM *vm, const RegChunk *chunk) {
+  if (chunk->slotCount > vm->registerCount) {
+    vm->registers =
+        grow_owned_array(&vm->heap.stats, vm->registers, vm->registerCount,
+                         chunk->slotCount, sizeof(Value), MEM_VM_STACK);
+    vm->registerCount = chunk->slotCount;
+  }
+
+  /// Constants live in the first slots; temporaries start as nil, since the
+  /// collector visits the whole window
+  size_t constantCount = chunk->constants.count;
+  if (constantCount > 0) {
+    memcpy(vm->registers, chunk->constants.data,
+           constantCount * sizeof(Value));
+  }
+  for (size_t slot = constantCount; slot < chunk->slotCount; ++slot) {
+    vm->registers[slot] = NIL_VAL;
+  }
+
+  vm->registerChunk = chunk;
+  InterpretResult result = executeRegisters(vm, chunk);
+  vm->registerChunk = NULL;
+  return result;
+}
@@ -1,84 +1,631 @@
+#include <stdarg.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "clox/compiler/compiler.h"
+#include "clox/compiler/register_codegen.h"
 #include "clox/core/chunk.h"
+#include "clox/core/globals.h"
+#include "clox/core/inline_cache.h"
+#include "clox/core/memory.h"
+#include "clox/core/object.h"
 #include "clox/core/value.h"
 #include "clox/utils/debug.h"
-#include "clox/utils/dynarr.h"
 #include "clox/vm/dispatch.h"
+#include "clox/vm/gc.h"
 #include "clox/vm/vm.h"
 #include "config.h"
 
+#ifdef DEBUG_TRACE_EXECUTION
+/// @brief Print the stack and the instruction about to be executed
+static void traceExecution(VM *vm) {
+  printf("Stack:");
+  for (Value *slot = vm->stack; slot < vm->stackTop; ++slot) {
+    printf(" [");
+    printValue(*slot);
+    printf("]");
+  }
+  if (vm->stackTop > vm->stack) {
+    printf(" <- top");
+  }
+  printf("\n");
+
+  size_t offset = (size_t)(vm->ip - (uint8_t *)vm->chunk->code.data);
+  disassembleInstructionAt(vm->chunk, offset, &vm->traceLines);
+}
+#endif
+
+static void resetStack(VM *vm) { vm->stackTop = vm->stack; }
+
+/// @brief Report a runtime error with the line of the current instruction
+__attribute__((format(printf, 2, 3))) static void
+runtimeError(VM *vm, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  fprintf(stderr, "Runtime error: ");
+  vfprintf(stderr, format, args);
+  fputs("\n", stderr);
+  va_end(args);
+
+  /// ip has already moved past the failing instruction
+  size_t offset = (size_t)(vm->ip - (uint8_t *)vm->chunk->code.data) - 1;
+  fprintf(stderr, "[line %zu] in script\n", getLine(vm->chunk, offset));
+  resetStack(vm);
+}
+
+static CloxValue toCloxValue(Value value) {
+  if (IS_BOOL(value)) {
+    return cloxBool(AS_BOOL(value));
+  }
+  if (IS_NUMBER(value)) {
+    return cloxNumber(AS_NUMBER(value));
+  }
+  if (IS_STRING(value)) {
+    return cloxString(AS_CSTRING(value), AS_STRING(value)->length);
+  }
+  if (IS_OBJ(value)) {
+    return cloxObject(AS_OBJ(value));
+  }
+  return cloxNil();
+}
+
+static bool fromCloxValue(VM *vm, CloxValue value, Value *out) {
+  switch ((int)value.type) {
+  case CLOX_NIL:
+    *out = NIL_VAL;
+    return true;
+  case CLOX_BOOL:
+    *out = BOOL_VAL(value.as.boolean);
+    return true;
+  case CLOX_NUMBER:
+    *out = NUMBER_VAL(value.as.number);
+    return true;
+  case CLOX_STRING:
+    if (value.as.string.chars == NULL) {
+      return false;
+    }
+    *out = OBJ_VAL(copyString(&vm->heap, value.as.string.chars,
+                              value.as.string.length));
+    return true;
+  case CLOX_OBJECT:
+    if (value.as.object == NULL) {
+      return false;
+    }
+    *out = OBJ_VAL((Obj *)value.as.object);
+    return true;
+  default:
+    return false;
+  }
+}
+
 /**
- * @brief The main bytecode execution loop
+ * @brief Call `native` with the top `argCount` values, replacing them and
+ * the callee below them with its result.
+ *
+ * @return false after reporting a runtime error.
  */
-static InterpretResult executeBytecode(VM *vm) {
-  for (;;) {
+static bool callNative(VM *vm, const ObjNative *native, uint8_t argCount) {
+  if (native->arity >= 0 && native->arity != argCount) {
+    runtimeError(vm, "Expected %d arguments but got %d.", native->arity,
+                 argCount);
+    return false;
+  }
 
-#ifdef DEBUG_TRACE_EXECUTION
-    printf("Stack:");
-    for (size_t i = 0; i < vm->stack.count; ++i) {
-      Value slot = ((Value *)vm->stack.data)[i];
-      printf(" [%g]", slot);
+  CloxValue args[UINT8_MAX];
+  Value *first = vm->stackTop - argCount;
+  for (uint8_t i = 0; i < argCount; ++i) {
+    args[i] = toCloxValue(first[i]);
+  }
+
+  CloxValue result = cloxNil();
+  Value value;
+  vm->nativeError[0] = '\0';
+  if (!native->function(vm, argCount, args, &result)) {
+    if (vm->nativeError[0] != '\0') {
+      runtimeError(vm, "%s", vm->nativeError);
+    } else {
+      runtimeError(vm, "Native function '%s' failed.", native->name->chars);
+    }
+    return false;
+  }
+  if (!fromCloxValue(vm, result, &value)) {
+    runtimeError(vm, "Native function '%s' returned an invalid value.",
+                 native->name->chars);
+    return false;
+  }
+  vm->stackTop = first;
+  vm->stackTop[-1] = value;
+  return true;
+}
+
+/**
+ * @brief Call the value below the top `argCount` values, leaving the
+ * result in its place.
+ *
+ * Calling a class makes an instance; classes have no initializer yet.
+ */
+static bool callValue(VM *vm, uint8_t argCount) {
+  Value callee = peek(vm, argCount);
+  if (IS_NATIVE(callee)) {
+    return callNative(vm, AS_NATIVE(callee), argCount);
+  }
+  if (IS_CLASS(callee)) {
+    if (argCount != 0) {
+      runtimeError(vm, "Expected 0 arguments but got %d.", argCount);
+      return false;
     }
-    if (vm->stack.count > 0) {
-      printf(" <- top");
+    vm->stackTop[-1] = OBJ_VAL(newInstance(&vm->heap, AS_CLASS(callee)));
+    return true;
+  }
+  runtimeError(vm, "Can only call functions and classes.");
+  return false;
+}
+
+/**
+ * @brief Index of the field `cache` reads in `instance`.
+ *
+ * A hit costs a pointer compare; a miss walks the shape and teaches the
+ * cache the shape.
+ *
+ * @return false if the instance has no such field.
+ */
+static inline bool findField(VM *vm, InlineCache *cache,
+                             const ObjInstance *instance, uint32_t *field) {
+  const ICEntry *entry = lookupInlineCache(cache, instance->shape);
+  if (entry != NULL) {
+    *field = entry->field;
+    return true;
+  }
+  uint32_t index = shapeFieldIndex(instance->shape, cache->name);
+  if (index == SHAPE_NO_FIELD) {
+    return false;
+  }
+  updateInlineCache(&vm->heap, cache, instance->shape, instance->shape,
+                    index);
+  *field = index;
+  return true;
+}
+
+/**
+ * @brief Store `value` in the field `cache` writes, adding the field (and
+ * moving the instance to a new shape) if it is missing.
+ */
+static inline void storeField(VM *vm, InlineCache *cache,
+                              ObjInstance *instance, Value value) {
+  ObjShape *shape = instance->shape;
+  ObjShape *next = shape;
+  uint32_t field;
+  const ICEntry *entry = lookupInlineCache(cache, shape);
+  if (entry != NULL) {
+    next = entry->next;
+    field = entry->field;
+  } else {
+    field = shapeFieldIndex(shape, cache->name);
+    if (field == SHAPE_NO_FIELD) {
+      next = shapeTransition(&vm->heap, shape, cache->name);
+      field = next->fieldCount - 1;
     }
-    printf("\n");
+    updateInlineCache(&vm->heap, cache, shape, next, field);
+  }
+
+  if (next != shape) {
+    setInstanceShape(&vm->heap, instance, next);
+  }
+  instance->fields[field] = value;
+  writeBarrierValue(&vm->heap, &instance->obj, value);
+}
+
+static void undefinedVariable(VM *vm, uint16_t slot) {
+  runtimeError(vm, "Undefined variable '%s'.",
+               globalName(&vm->globals, slot)->chars);
+}
+
+/// @brief Replace the two strings on top of the stack by their concatenation
+static void concatenate(VM *vm) {
+  ObjString *b = AS_STRING(peek(vm, 0));
+  ObjString *a = AS_STRING(peek(vm, 1));
+  ObjString *result = concatenateStrings(&vm->heap, a, b);
+  vm->stackTop--;
+  vm->stackTop[-1] = OBJ_VAL(result);
+}
 
-    size_t offset = (size_t)(vm->ip - (uint8_t *)vm->chunk->code.data);
-    disassembleInstruction(vm->chunk, offset);
+/// Label addresses and the range initializer of the dispatch table are GNU
+/// extensions; they are only used when the compiler supports them.
+#ifdef CLOX_THREADED_DISPATCH
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#pragma GCC diagnostic ignored "-Woverride-init"
 #endif
 
-    uint8_t instruction = readInstruction(vm);
-    switch (instruction) {
-    case OP_CONSTANT: {
+/**
+ * @brief The main bytecode execution loop
+ * @see dispatch.h for the threaded / switch dispatch strategies
+ */
+static InterpretResult executeBytecode(VM *vm) {
+#ifdef CLOX_THREADED_DISPATCH
+  static void *const dispatchTable[UINT8_MAX + 1] = {
+      [0 ... UINT8_MAX] = &&op_unknown,
+      [OP_CONSTANT] = &&OP_CONSTANT,
+      [OP_CONSTANT_LONG] = &&OP_CONSTANT_LONG,
+      [OP_NIL] = &&OP_NIL,
+      [OP_TRUE] = &&OP_TRUE,
+      [OP_FALSE] = &&OP_FALSE,
+      [OP_POP] = &&OP_POP,
+      [OP_EQUAL] = &&OP_EQUAL,
+      [OP_GREATER] = &&OP_GREATER,
+      [OP_LESS] = &&OP_LESS,
+      [OP_ADD] = &&OP_ADD,
+      [OP_SUBTRACT] = &&OP_SUBTRACT,
+      [OP_MULTIPLY] = &&OP_MULTIPLY,
+      [OP_DIVIDE] = &&OP_DIVIDE,
+      [OP_NOT] = &&OP_NOT,
+      [OP_NEGATE] = &&OP_NEGATE,
+      [OP_PRINT] = &&OP_PRINT,
+      [OP_RETURN] = &&OP_RETURN,
+      [OP_DEFINE_GLOBAL] = &&OP_DEFINE_GLOBAL,
+      [OP_GET_GLOBAL] = &&OP_GET_GLOBAL,
+      [OP_SET_GLOBAL] = &&OP_SET_GLOBAL,
+      [OP_CALL] = &&OP_CALL,
+      [OP_CLASS] = &&OP_CLASS,
+      [OP_GET_PROPERTY] = &&OP_GET_PROPERTY,
+      [OP_SET_PROPERTY] = &&OP_SET_PROPERTY,
+      [OP_INVOKE] = &&OP_INVOKE,
+      [OP_ADD_CONSTANT] = &&OP_ADD_CONSTANT,
+      [OP_SUBTRACT_CONSTANT] = &&OP_SUBTRACT_CONSTANT,
+      [OP_MULTIPLY_CONSTANT] = &&OP_MULTIPLY_CONSTANT,
+      [OP_DIVIDE_CONSTANT] = &&OP_DIVIDE_CONSTANT,
+      [OP_CONSTANT_CONSTANT] = &&OP_CONSTANT_CONSTANT,
+  };
+  static void *const profileTable[UINT8_MAX + 1] = {
+      [0 ... UINT8_MAX] = &&op_profile,
+  };
+#endif
+  Profiler *profiler = vm->profiler;
+#ifdef CLOX_THREADED_DISPATCH
+  void *const *dispatch = profiler != NULL ? profileTable : dispatchTable;
+#endif
+  uint8_t instruction;
+
+  VM_LOOP() {
+    VM_CASE(OP_CONSTANT) {
+      VM_RESERVE_STACK(1);
       Value constant = readConstant(vm);
       push(vm, constant);
-      break;
-    }
-    case OP_ADD:
-    case OP_SUBTRACT:
-    case OP_MULTIPLY:
-    case OP_DIVIDE:
-      binaryOp(vm, instruction);
-      break;
-    case OP_NEGATE:
-      push(vm, -pop(vm));
-      break;
-    case OP_RETURN: {
-      /// make sure there's something to pop
-      if (vm->stack.count == 0) {
-        fprintf(stderr, "Runtime error: stack underflow on OP_RETURN\n");
+      VM_NEXT();
+    }
+    VM_CASE(OP_CONSTANT_LONG) {
+      VM_RESERVE_STACK(1);
+      push(vm, readConstantLong(vm));
+      VM_NEXT();
+    }
+    VM_CASE(OP_NIL) {
+      VM_RESERVE_STACK(1);
+      push(vm, NIL_VAL);
+      VM_NEXT();
+    }
+    VM_CASE(OP_TRUE) {
+      VM_RESERVE_STACK(1);
+      push(vm, BOOL_VAL(true));
+      VM_NEXT();
+    }
+    VM_CASE(OP_FALSE) {
+      VM_RESERVE_STACK(1);
+      push(vm, BOOL_VAL(false));
+      VM_NEXT();
+    }
+    VM_CASE(OP_POP) {
+      (void)pop(vm);
+      VM_NEXT();
+    }
+    VM_CASE(OP_EQUAL) {
+      Value b = pop(vm);
+      Value a = pop(vm);
+      push(vm, BOOL_VAL(valuesEqual(a, b)));
+      VM_NEXT();
+    }
+    VM_CASE(OP_GREATER) {
+      VM_BINARY_OP(BOOL_VAL, >);
+      VM_NEXT();
+    }
+    VM_CASE(OP_LESS) {
+      VM_BINARY_OP(BOOL_VAL, <);
+      VM_NEXT();
+    }
+    VM_CASE(OP_ADD) {
+      if (IS_NUMBER(peek(vm, 0)) && IS_NUMBER(peek(vm, 1))) {
+        double b = AS_NUMBER(pop(vm));
+        double a = AS_NUMBER(pop(vm));
+        push(vm, NUMBER_VAL(a + b));
+      } else if (IS_STRING(peek(vm, 0)) && IS_STRING(peek(vm, 1))) {
+        concatenate(vm);
+        gcSafePoint(vm);
+      } else {
+        runtimeError(vm, ADD_OPERANDS_ERROR);
         return INTERPRET_RUNTIME_ERROR;
       }
-
-      pop(vm);
+      VM_NEXT();
+    }
+    VM_CASE(OP_SUBTRACT) {
+      VM_BINARY_OP(NUMBER_VAL, -);
+      VM_NEXT();
+    }
+    VM_CASE(OP_MULTIPLY) {
+      VM_BINARY_OP(NUMBER_VAL, *);
+      VM_NEXT();
+    }
+    VM_CASE(OP_DIVIDE) {
+      VM_BINARY_OP(NUMBER_VAL, /);
+      VM_NEXT();
+    }
+    VM_CASE(OP_NOT) {
+      push(vm, BOOL_VAL(isFalsey(pop(vm))));
+      VM_NEXT();
+    }
+    VM_CASE(OP_NEGATE) {
+      if (!IS_NUMBER(peek(vm, 0))) {
+        runtimeError(vm, "Operand must be a number.");
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      push(vm, NUMBER_VAL(-AS_NUMBER(pop(vm))));
+      VM_NEXT();
+    }
+    VM_CASE(OP_PRINT) {
+      printValue(pop(vm));
+      printf("\n");
+      VM_NEXT();
+    }
+    VM_CASE(OP_RETURN) {
+      /// Exit the top-level script
       return INTERPRET_OK;
     }
+    VM_CASE(OP_DEFINE_GLOBAL) {
+      uint16_t slot = readShort(vm);
+      globalValues(&vm->globals)[slot] = pop(vm);
+      VM_NEXT();
+    }
+    VM_CASE(OP_GET_GLOBAL) {
+      VM_RESERVE_STACK(1);
+      uint16_t slot = readShort(vm);
+      Value value = globalValues(&vm->globals)[slot];
+      if (IS_UNDEFINED(value)) {
+        undefinedVariable(vm, slot);
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      push(vm, value);
+      VM_NEXT();
+    }
+    VM_CASE(OP_SET_GLOBAL) {
+      uint16_t slot = readShort(vm);
+      Value *global = &globalValues(&vm->globals)[slot];
+      /// Assignment never creates a global, only `var` does
+      if (IS_UNDEFINED(*global)) {
+        undefinedVariable(vm, slot);
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      *global = peek(vm, 0);
+      VM_NEXT();
+    }
+    VM_CASE(OP_CALL) {
+      uint8_t argCount = readInstruction(vm);
+      if (!callValue(vm, argCount)) {
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      gcSafePoint(vm);
+      VM_NEXT();
+    }
+    VM_CASE(OP_CLASS) {
+      /// The compiler always loads the name first, a cache file might not
+      if (!IS_STRING(peek(vm, 0))) {
+        runtimeError(vm, "Class name must be a string.");
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      ObjClass *klass = newClass(&vm->heap, AS_STRING(peek(vm, 0)));
+      vm->stackTop[-1] = OBJ_VAL(klass);
+      gcSafePoint(vm);
+      VM_NEXT();
+    }
+    VM_CASE(OP_GET_PROPERTY) {
+      InlineCache *cache = readInlineCache(vm);
+      if (!IS_INSTANCE(peek(vm, 0))) {
+        runtimeError(vm, "Only instances have properties.");
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      ObjInstance *instance = AS_INSTANCE(peek(vm, 0));
+      uint32_t field;
+      if (!findField(vm, cache, instance, &field)) {
+        runtimeError(vm, "Undefined property '%s'.", cache->name->chars);
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      vm->stackTop[-1] = instance->fields[field];
+      VM_NEXT();
+    }
+    VM_CASE(OP_SET_PROPERTY) {
+      InlineCache *cache = readInlineCache(vm);
+      if (!IS_INSTANCE(peek(vm, 1))) {
+        runtimeError(vm, "Only instances have fields.");
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      Value value = pop(vm);
+      storeField(vm, cache, AS_INSTANCE(peek(vm, 0)), value);
+      /// The assignment evaluates to the stored value
+      vm->stackTop[-1] = value;
+      gcSafePoint(vm);
+      VM_NEXT();
+    }
+    VM_CASE(OP_INVOKE) {
+      InlineCache *cache = readInlineCache(vm);
+      uint8_t argCount = readInstruction(vm);
+      Value receiver = peek(vm, argCount);
+      if (!IS_INSTANCE(receiver)) {
+        runtimeError(vm, "Only instances have properties.");
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      ObjInstance *instance = AS_INSTANCE(receiver);
+      uint32_t field;
+      if (!findField(vm, cache, instance, &field)) {
+        runtimeError(vm, "Undefined property '%s'.", cache->name->chars);
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      /// No methods yet: call the field's value in place of the receiver
+      vm->stackTop[-1 - argCount] = instance->fields[field];
+      if (!callValue(vm, argCount)) {
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      gcSafePoint(vm);
+      VM_NEXT();
+    }
+    VM_CASE(OP_ADD_CONSTANT) {
+      VM_CONSTANT_OP(NUMBER_VAL, +, ADD_OPERANDS_ERROR);
+      VM_NEXT();
+    }
+    VM_CASE(OP_SUBTRACT_CONSTANT) {
+      VM_CONSTANT_OP(NUMBER_VAL, -, NUMBER_OPERANDS_ERROR);
+      VM_NEXT();
+    }
+    VM_CASE(OP_MULTIPLY_CONSTANT) {
+      VM_CONSTANT_OP(NUMBER_VAL, *, NUMBER_OPERANDS_ERROR);
+      VM_NEXT();
+    }
+    VM_CASE(OP_DIVIDE_CONSTANT) {
+      VM_CONSTANT_OP(NUMBER_VAL, /, NUMBER_OPERANDS_ERROR);
+      VM_NEXT();
+    }
+    VM_CASE(OP_CONSTANT_CONSTANT) {
+      VM_RESERVE_STACK(2);
+      Value first = readConstant(vm);
+      push(vm, first);
+      push(vm, readConstant(vm));
+      VM_NEXT();
+    }
+    VM_PROFILE_HOOK()
     /// WARN: Is provisional
-    default:
-      fprintf(stderr, "Runtime error: unknown opcode %d\n", instruction);
+    VM_DEFAULT() {
+      runtimeError(vm, "Unknown opcode %d.", instruction);
       return INTERPRET_RUNTIME_ERROR;
     }
   }
 }
 
+#ifdef CLOX_THREADED_DISPATCH
+#pragma GCC diagnostic pop
+#endif
+
 void initVM(VM *vm) {
-  initDynArray(&vm->stack, sizeof(Value));
+  /// First: the stack is accounted to the heap's statistics
+  initHeap(&vm->heap);
+  vm->stack = grow_owned_array(&vm->heap.stats, NULL, 0, STACK_MAX,
+                               sizeof(Value), MEM_VM_STACK);
+  resetStack(vm);
   vm->chunk = NULL;
   vm->ip = NULL;
+  vm->backend = VM_BACKEND_STACK;
+  vm->registers = NULL;
+  vm->registerCount = 0;
+  vm->registerChunk = NULL;
+  vm->profiler = NULL;
+  initGlobals(&vm->globals);
+  initDynArray(&vm->chunks, sizeof(Chunk *), MEM_GC);
+  vm->icStats = false;
+  vm->registerStats = false;
+  vm->userData = NULL;
+  vm->nativeError[0] = '\0';
+}
+
+void freeVM(VM *vm) {
+  vm->stack = free_owned_array(&vm->heap.stats, vm->stack, STACK_MAX,
+                               sizeof(Value), MEM_VM_STACK);
+  vm->stackTop = NULL;
+  vm->registers = free_owned_array(&vm->heap.stats, vm->registers,
+                                   vm->registerCount, sizeof(Value),
+                                   MEM_VM_STACK);
+  vm->registerCount = 0;
+  freeGlobals(&vm->globals);
+  freeDynArray(&vm->chunks);
+  freeHeap(&vm->heap);
 }
 
-void freeVM(VM *vm) { freeDynArray(&vm->stack); }
+void registerChunk(VM *vm, Chunk *chunk) { pushDynArray(&vm->chunks, &chunk); }
 
-InterpretResult interpret(VM *vm, const char *source) {
-  /// vm->chunk = chunk;
+void unregisterChunk(VM *vm, Chunk *chunk) {
+  Chunk **chunks = (Chunk **)vm->chunks.data;
+  for (size_t i = 0; i < vm->chunks.count; ++i) {
+    if (chunks[i] == chunk) {
+      chunks[i] = chunks[--vm->chunks.count];
+      return;
+    }
+  }
+}
+
+bool defineNative(VM *vm, const char *name, int arity,
+                  CloxNativeFn function) {
+  ObjString *key = copyString(&vm->heap, name, strlen(name));
+  size_t slot = resolveGlobal(&vm->globals, key);
+  if (slot == GLOBALS_MAX) {
+    return false;
+  }
+  ObjNative *native = newNative(&vm->heap, key, function, arity);
+  globalValues(&vm->globals)[slot] = OBJ_VAL(native);
+  return true;
+}
+
+InterpretResult interpretChunk(VM *vm, Chunk *chunk) {
+  if (vm->backend == VM_BACKEND_REGISTER) {
+    /// Its constants stay roots while the translation runs
+    vm->chunk = chunk;
+    RegChunk registerChunk;
+    initRegChunk(&registerChunk);
+    bool translated = generateRegisterCode(chunk, &registerChunk);
+    if (vm->registerStats) {
+      printRegisterStats(stderr, translated ? &registerChunk : NULL);
+    }
+    InterpretResult result = INTERPRET_OK;
+    if (translated) {
+      result = interpretRegisterChunk(vm, &registerChunk);
+    }
+    freeRegChunk(&registerChunk);
+    if (translated) {
+      return result;
+    }
+    /// Too many slots for 18-bit operands, calls or objects: run it on
+    /// the stack instead
+  }
+
+  vm->chunk = chunk;
   /// Point to the beginning
-  /// vm->ip = (uint8_t *)chunk->code.data;
-  /// return executeBytecode(vm);
-  // compile(vm, source);
-  return INTERPRET_OK;
+  vm->ip = (uint8_t *)chunk->code.data;
+#ifdef DEBUG_TRACE_EXECUTION
+  initLineIterator(&vm->traceLines, chunk);
+#endif
+  InterpretResult result;
+  if (vm->profiler == NULL) {
+    result = executeBytecode(vm);
+  } else {
+    beginProfileRun(vm->profiler, chunk);
+    result = executeBytecode(vm);
+    endProfileRun(vm->profiler);
+  }
+  if (vm->icStats) {
+    printInlineCaches(stderr, chunk);
+  }
+  return result;
+}
+
+InterpretResult interpret(VM *vm, const char *source) {
+  Chunk chunk;
+  initChunk(&chunk);
+
+  if (!compile(source, &chunk, &vm->heap, &vm->globals)) {
+    freeChunk(&chunk);
+    return INTERPRET_COMPILE_ERROR;
+  }
+
+  InterpretResult result = interpretChunk(vm, &chunk);
+
+  freeChunk(&chunk);
+  vm->chunk = NULL;
+  vm->ip = NULL;
+  return result;
 }
@@ -0,0 +1,188 @@
+#!/usr/bin/env python3
+"""Run one Lox test script with clox and check what it does.
+
+A test is a .lox file whose comments state the expected behaviour:
+
+    print 1 + 2; // expect: 3
+    print nil + 1;
+    // expect stderr: [line 2] in script
+    // expect exit: 70
+
+The `expect:` lines are the whole standard output, in order. The
+`expect stderr:` lines must appear on standard error in that order, among
+other lines (such as the closing "Fatal:" message). `expect exit:` is the
+exit status, 0 by default. `expect backend: register` (or `stack`) states
+that, under `--register-vm`, every chunk of the script is translated to
+register code (or falls back to the stack VM), as `--register-stats`
+reports it.
+
+The script is copied to a temporary directory first, so that the bytecode
+cache clox writes next to it never lands in the source tree. `--mode`
+picks how it is run:
+
+- `plain`: once.
+- `cached`: twice, the second run loading the .loxc the first one wrote.
+- `corrupt`: first with a stale .loxc, compiled from another source, then
+  again after each of a few corruptions of the .loxc (truncated, a flipped
+  byte, garbage), which clox must detect and replace by recompiling.
+- `register`: once with `--register-vm`, which must behave like the stack
+  VM on every script, whether it translates the chunk or falls back, and
+  must pick the backend the script expects.
+
+Every run must meet the expectations.
+
+Usage: run_test.py [--mode MODE] CLOX TEST.lox
+"""
+
+import argparse
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+from typing import List, NamedTuple, Optional
+
+EXPECT = re.compile(r"// expect( stderr| exit| backend)?: ?(.*)$")
+
+# What --register-stats prints for each chunk run, by backend
+BACKEND_REPORTS = {"register": "register vm: translated",
+                   "stack": "register vm: not translated"}
+
+
+class Expectation(NamedTuple):
+    stdout: List[str]
+    stderr: List[str]
+    exit_code: int
+    backend: Optional[str]
+
+
+def parse(path: str) -> Expectation:
+    stdout: List[str] = []
+    stderr: List[str] = []
+    exit_code = 0
+    backend = None
+    with open(path, encoding="utf-8") as source:
+        for line in source:
+            match = EXPECT.search(line.rstrip("\n"))
+            if match is None:
+                continue
+            kind, text = match.groups()
+            if kind is None:
+                stdout.append(text)
+            elif kind == " stderr":
+                stderr.append(text)
+            elif kind == " backend":
+                if text not in BACKEND_REPORTS:
+                    raise ValueError(f"{path}: unknown backend {text!r}")
+                backend = text
+            else:
+                exit_code = int(text)
+    return Expectation(stdout, stderr, exit_code, backend)
+
+
+def contains_in_order(lines: List[str], expected: List[str]) -> bool:
+    remaining = iter(lines)
+    return all(any(line == wanted for line in remaining)
+               for wanted in expected)
+
+
+def check(clox: str, script: str, expected: Expectation,
+          register: bool = False) -> List[str]:
+    options = ["--register-vm", "--register-stats"] if register else []
+    result = subprocess.run([clox, *options, script], capture_output=True,
+                            text=True, timeout=600)
+    stdout = result.stdout.splitlines()
+    stderr = result.stderr.splitlines()
+    failures = []
+    if stdout != expected.stdout:
+        failures.append("stdout:\n  expected " + repr(expected.stdout) +
+                        "\n  got      " + repr(stdout))
+    if not contains_in_order(stderr, expected.stderr):
+        failures.append("stderr:\n  expected " + repr(expected.stderr) +
+                        "\n  got      " + repr(stderr))
+    if result.returncode != expected.exit_code:
+        failures.append(f"exit status: expected {expected.exit_code}, "
+                        f"got {result.returncode}")
+    if register and expected.backend is not None:
+        reports = [line for line in stderr
+                   if line.startswith("register vm: ")]
+        wanted = BACKEND_REPORTS[expected.backend]
+        if not reports or any(not line.startswith(wanted)
+                              for line in reports):
+            failures.append(f"backend: expected every chunk to report "
+                            f"{wanted!r}, got {reports!r}")
+    return failures
+
+
+def truncate(data: bytes) -> bytes:
+    return data[:len(data) // 2]
+
+
+def flip_byte(data: bytes) -> bytes:
+    if not data:
+        return b"\xff"
+    middle = len(data) // 2
+    return data[:middle] + bytes([data[middle] ^ 0xff]) + data[middle + 1:]
+
+
+def garbage(data: bytes) -> bytes:
+    return bytes(range(256)) * 4
+
+
+CORRUPTIONS = [("truncated", truncate), ("flipped byte", flip_byte),
+               ("garbage", garbage)]
+
+
+def run_mode(clox: str, script: str, mode: str,
+             expected: Expectation) -> List[str]:
+    if mode == "register":
+        return check(clox, script, expected, register=True)
+    failures = check(clox, script, expected)
+    if mode == "cached":
+        failures += ["cached run: " + failure
+                     for failure in check(clox, script, expected)]
+    elif mode == "corrupt":
+        with open(script, encoding="utf-8") as file:
+            source = file.read()
+        with open(script, "w", encoding="utf-8") as file:
+            file.write('print "stale";\n')
+        subprocess.run([clox, script], capture_output=True, timeout=600)
+        with open(script, "w", encoding="utf-8") as file:
+            file.write(source)
+        failures += ["stale cache: " + failure
+                    for failure in check(clox, script, expected)]
+
+        cache = os.path.splitext(script)[0] + ".loxc"
+        for name, corrupt in CORRUPTIONS:
+            data = b""
+            if os.path.exists(cache):
+                with open(cache, "rb") as file:
+                    data = file.read()
+            with open(cache, "wb") as file:
+                file.write(corrupt(data))
+            failures += [f"{name} cache: " + failure
+                         for failure in check(clox, script, expected)]
+    return failures
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--mode", default="plain",
+                        choices=["plain", "cached", "corrupt", "register"])
+    parser.add_argument("clox")
+    parser.add_argument("test")
+    args = parser.parse_args()
+    clox = os.path.abspath(args.clox)
+    expected = parse(args.test)
+    with tempfile.TemporaryDirectory() as directory:
+        script = os.path.join(directory, os.path.basename(args.test))
+        shutil.copyfile(args.test, script)
+        failures = run_mode(clox, script, args.mode, expected)
+    for failure in failures:
+        print(f"{args.test} ({args.mode}): {failure}")
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,77 @@
+"""Compare two sets of benchmark results written through CLOX_BENCH_JSON.
+
+Run the benchmarks on both builds, then diff the JSON files (or the build
+directories holding them):
+
+    meson test -C build-old --benchmark
+    meson test -C build-new --benchmark
+    python3 tools/bench_compare.py build-old build-new
+
+A benchmark counts as changed when its median moved by more than the
+threshold and by more than twice the larger relative standard deviation of
+the two runs. The exit status is 1 if anything regressed.
+"""
+
+import argparse
+import json
+import sys
+from pathlib import Path
+from typing import Dict, Tuple
+
+Results = Dict[Tuple[str, str], dict]
+
+
+def load(path: Path) -> Results:
+    """Map (suite, benchmark name) to its record."""
+    files = sorted(path.glob("bench-*.json")) if path.is_dir() else [path]
+    results: Results = {}
+    for file in files:
+        suite = file.stem.removeprefix("bench-")
+        with file.open() as data:
+            for record in json.load(data)["benchmarks"]:
+                results[(suite, record["name"])] = record
+    return results
+
+
+def spread(record: dict) -> float:
+    return record["stddev_s"] / record["mean_s"] if record["mean_s"] else 0.0
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("old", type=Path, help="baseline file or build dir")
+    parser.add_argument("new", type=Path, help="candidate file or build dir")
+    parser.add_argument("--threshold", type=float, default=3.0,
+                        help="smallest change reported, in percent")
+    args = parser.parse_args()
+
+    old = load(args.old)
+    new = load(args.new)
+    if not old or not new:
+        print("No benchmark results found.", file=sys.stderr)
+        return 2
+
+    regressions = 0
+    print(f"{'benchmark':<56} {'old ms':>10} {'new ms':>10} {'change':>8}")
+    for key in sorted(old.keys() & new.keys()):
+        before = old[key]["median_s"]
+        after = new[key]["median_s"]
+        change = after / before - 1.0
+        noise = 2.0 * max(spread(old[key]), spread(new[key]))
+        verdict = ""
+        if abs(change) * 100.0 > args.threshold and abs(change) > noise:
+            verdict = "slower" if change > 0 else "faster"
+            regressions += change > 0
+
+        name = f"{key[0]}: {key[1]}"
+        print(f"{name:<56} {before * 1e3:10.3f} {after * 1e3:10.3f} "
+              f"{change * 100.0:+7.1f}% {verdict}")
+
+    for key in sorted(old.keys() ^ new.keys()):
+        side = "old" if key in old else "new"
+        print(f"{key[0]}: {key[1]} (only in {side})")
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,106 @@
+"""Rank opcode sequences in DEBUG_TRACE_EXECUTION output.
+
+Superinstruction candidates are the pairs (and triples) that execute most
+often. Build a tracing interpreter without fusion so the raw pairs show up,
+then pipe one or more runs through this script:
+
+    meson setup build-trace -Ddebug_trace_execution=true \\
+        -Dsuperinstructions=false
+    meson compile -C build-trace
+    ./build-trace/clox bench.lox | python3 tools/mine_traces.py
+
+Traces of a fusing build work too; they show what is left to fuse next.
+"""
+
+import argparse
+import re
+import sys
+from collections import Counter
+from pathlib import Path
+from typing import Iterable, Iterator, List, TextIO
+
+# "0012 0003 OP_CONSTANT         2 '12'" as printed by disassembleInstruction
+INSTRUCTION = re.compile(r"^\d{4,} +\d+ +(OP_[A-Z_]+)")
+
+# Pairs the compiler already fuses (see include/clox/compiler/peephole.h)
+FUSED = {
+    ("OP_CONSTANT", "OP_ADD"): "OP_ADD_CONSTANT",
+    ("OP_CONSTANT", "OP_SUBTRACT"): "OP_SUBTRACT_CONSTANT",
+    ("OP_CONSTANT", "OP_MULTIPLY"): "OP_MULTIPLY_CONSTANT",
+    ("OP_CONSTANT", "OP_DIVIDE"): "OP_DIVIDE_CONSTANT",
+    ("OP_CONSTANT", "OP_CONSTANT"): "OP_CONSTANT_CONSTANT",
+}
+
+
+def opcodes(stream: TextIO) -> Iterator[str]:
+    """Executed opcodes, in order; program output and stack lines are skipped."""
+    for line in stream:
+        match = INSTRUCTION.match(line)
+        if match:
+            yield match.group(1)
+
+
+def count_sequences(ops: Iterable[str], length: int) -> Counter:
+    """Count every run of `length` consecutive executed opcodes.
+
+    OP_RETURN ends a script, so sequences never span two runs.
+    """
+    counts: Counter = Counter()
+    window: List[str] = []
+    for op in ops:
+        window.append(op)
+        if len(window) > length:
+            window.pop(0)
+        if len(window) == length:
+            counts[tuple(window)] += 1
+        if op == "OP_RETURN":
+            window.clear()
+    return counts
+
+
+def report(counts: Counter, total: int, top: int, title: str) -> None:
+    print(title)
+    for sequence, count in counts.most_common(top):
+        share = 100.0 * count / total if total else 0.0
+        note = FUSED.get(sequence, "")
+        note = f"  (fused: {note})" if note else ""
+        print(f"  {count:>10}  {share:5.1f}%  {' '.join(sequence)}{note}")
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("traces", nargs="*", type=Path,
+                        help="trace files (default: stdin)")
+    parser.add_argument("--top", type=int, default=15,
+                        help="sequences to list per length (default: 15)")
+    parser.add_argument("--triples", action="store_true",
+                        help="also rank sequences of three opcodes")
+    args = parser.parse_args()
+
+    ops: List[str] = []
+    if args.traces:
+        for path in args.traces:
+            with path.open(encoding="utf-8", errors="replace") as trace:
+                ops.extend(opcodes(trace))
+    else:
+        ops.extend(opcodes(sys.stdin))
+
+    if not ops:
+        print("No trace lines found; was clox built with "
+              "-Ddebug_trace_execution=true?", file=sys.stderr)
+        return 1
+
+    singles = Counter(ops)
+    print(f"{len(ops)} instructions executed")
+    report(Counter({(op,): n for op, n in singles.items()}), len(ops),
+           args.top, "Opcodes:")
+    pairs = count_sequences(ops, 2)
+    report(pairs, sum(pairs.values()), args.top, "Pairs:")
+    if args.triples:
+        triples = count_sequences(ops, 3)
+        report(triples, sum(triples.values()), args.top, "Triples:")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())